@@ -2,9 +2,72 @@
 #include "scenarios/SWE_TsunamiScenario.hh"
 #include "scenarios/SWE_CheckpointScenario.hh"
 #include "tools/help.hh"
+#include "tools/OutputScheduler.hh"
+#include "tools/Decomposition.hh"
+#include "blocks/SWE_WavePropagationBlock.hh"
+#include "blocks/SWE_DimensionalSplitting.hpp"
+#include "blocks/SWE_SparseBlockGrid.hh"
+#include "blocks/SWE_AdaptiveBlockGrid.hh"
+#include "blocks/SWE_NestedBlockGrid.hh"
+#include "writer/DeltaWriter.hh"
+#include "writer/DeltaReader.hh"
 
 using namespace tools;
 
+/**
+ * Deep water in the left half of the unit square, shallow water in the right half
+ * and a small hump of water in the shallow half.
+ */
+class SWE_StepScenario : public SWE_Scenario {
+public:
+	SWE_StepScenario() : SWE_Scenario(64, 16) { }
+
+	float getBathymetry(float x, float y) { return (x < .5f) ? -100.f : -2.f; }
+	float getWaterHeight(float x, float y) { return -getBathymetry(x, y) + ((x > .7f && x < .8f) ? 1.f : 0.f); }
+};
+
+/**
+ * Sloping bottom in the unit square with a round hump of water on the deep side.
+ */
+class SWE_SlopeScenario : public SWE_Scenario {
+public:
+	SWE_SlopeScenario() : SWE_Scenario(32, 32) { }
+
+	float getBathymetry(float x, float y) { return -10.f + 5.f*x; }
+	float getWaterHeight(float x, float y) {
+		return -getBathymetry(x, y) + (((x-.25f)*(x-.25f) + (y-.5f)*(y-.5f) < .01f) ? 1.f : 0.f);
+	}
+};
+
+/**
+ * Exposes the lake at rest check of the blocks.
+ */
+class LakeAtRestCheck : public SWE_Block {
+public:
+	using SWE_Block::isLakeAtRest;
+};
+
+/**
+ * Removes the waves from a block: flat surface at zero over the bathymetry, no momentum.
+ */
+void setLakeAtRest(SWE_Block &block) {
+	for(int i = 0; i < block.getNx(); i++) for(int j = 0; j < block.getNy(); j++)
+		block.setUnknowns(i, j, -block.getBathymetry()[i+1][j+1], 0.f, 0.f);
+}
+
+/**
+ * @return mass of all leaves of an adaptive grid
+ */
+template <class Grid> double leafMass(const Grid &i_grid) {
+	double mass = 0.;
+	for(int l = 0; l < i_grid.getNumberOfLeaves(); l++) {
+		SWE_Block &block = *i_grid.getLeaf(l);
+		for(int i = 1; i <= block.getNx(); i++) for(int j = 1; j <= block.getNy(); j++)
+			mass += block.getWaterHeight()[i][j] * block.getDx() * block.getDy();
+	}
+	return mass;
+}
+
 class DimenSplitTest : public CxxTest::TestSuite
 {
 private:
@@ -315,4 +378,504 @@ void test_scenarios_SWE_CheckpointScenario() {
 	TS_ASSERT_EQUALS(scenario.getBoundaryPos(BND_TOP), 2.f);
 	TS_ASSERT_EQUALS(scenario.getBoundaryPos(BND_BOTTOM), -2.f);
 }
+
+void test_tools_OutputScheduler() {
+	OutputScheduler scheduler(0.f, 10.f, 4.f);
+
+	// Time steps are clipped to the next output time
+	TS_ASSERT_DELTA(scheduler.clipTimestep(0.f, 3.f), 3.f, eps);
+	TS_ASSERT_DELTA(scheduler.clipTimestep(3.f, 3.f), 1.f, eps);
+	TS_ASSERT(!scheduler.isOutputDue(3.f));
+	TS_ASSERT(scheduler.isOutputDue(4.f));
+	TS_ASSERT_DELTA(scheduler.getNextOutputTime(), 8.f, eps);
+
+	// The last (shorter) interval ends at the end of the simulation
+	TS_ASSERT(scheduler.isOutputDue(8.f));
+	TS_ASSERT_DELTA(scheduler.clipTimestep(8.f, 3.f), 2.f, eps);
+	TS_ASSERT(!scheduler.isFinished(8.f));
+	TS_ASSERT(scheduler.isFinished(10.f));
+	TS_ASSERT(scheduler.isOutputDue(10.f));
+}
+
+void test_tools_OutputScheduler_eventTrigger() {
+	OutputScheduler scheduler(0.f, 10.f, 4.f, 1.f, .5f);
+
+	// 4x3 cells with one ghost layer
+	Float2D h(6, 5), b(6, 5);
+	for(int i = 0; i < 6; i++) for(int j = 0; j < 5; j++) {
+		h[i][j] = 1.f;
+		b[i][j] = -1.f;
+	}
+	scheduler.beginOutput();
+	scheduler.endOutput(h, b);
+
+	// changes of the ghost layers do not trigger an output
+	h[0][2] += 2.f;
+	h[5][4] += 2.f;
+	TS_ASSERT_DELTA(scheduler.computeSurfaceChange(h, b), 0.f, eps);
+	TS_ASSERT(!scheduler.isOutputDue(1.f, scheduler.computeSurfaceChange(h, b)));
+
+	// changes of the inner cells do
+	h[4][3] += 1.f;
+	TS_ASSERT_DELTA(scheduler.computeSurfaceChange(h, b), 1.f, eps);
+	TS_ASSERT(scheduler.isOutputDue(2.f, scheduler.computeSurfaceChange(h, b)));
+}
+
+void test_tools_Decomposition() {
+	// uniform: the last block gets the remainder
+	Decomposition decomposition(10, 7, 3, 2);
+	TS_ASSERT_EQUALS(decomposition.getOffsetX(2), 6);
+	TS_ASSERT_EQUALS(decomposition.getSizeX(2), 4);
+	TS_ASSERT_EQUALS(decomposition.getSizeY(1), 4);
+
+	// 6 wet columns (cost 1) followed by 4 dry columns (cost .5)
+	std::vector<double> columnCosts(10, 1.), rowCosts(7, 1.);
+	for(int i = 6; i < 10; i++) columnCosts[i] = .5;
+
+	decomposition.balance(columnCosts, rowCosts);
+	TS_ASSERT_EQUALS(decomposition.getOffsetX(1), 3);
+	TS_ASSERT_EQUALS(decomposition.getOffsetX(2), 5);
+	TS_ASSERT_EQUALS(decomposition.getSizeX(2), 5);
+
+	// the minimum size is respected
+	std::vector<double> costs(10, 0.);
+	costs[0] = 1.;
+	TS_ASSERT_EQUALS(Decomposition::balancedCuts(costs, 3, 2)[1], 2);
+	TS_ASSERT_EQUALS(Decomposition::balancedCuts(costs, 3, 2)[2], 4);
+
+	// the first block column was twice as slow as the others
+	std::vector<double> blockTimes(6, 1.);
+	blockTimes[0] = blockTimes[1] = 2.;
+	decomposition.rebalance(columnCosts, rowCosts, blockTimes);
+	TS_ASSERT(decomposition.getSizeX(0) < 3);
+	TS_ASSERT_DELTA(Decomposition::imbalance(blockTimes), 1.5, eps);
+
+	// tiles start at the first cell of each block, the last tile of a block gets the remainder
+	std::vector<int> blockCuts = Decomposition::uniformCuts(10, 2);
+	std::vector<int> tileCuts = Decomposition::tileCuts(blockCuts, 3);
+	TS_ASSERT_EQUALS(tileCuts.size(), 5u);
+	TS_ASSERT_EQUALS(tileCuts[2], 5);
+	TS_ASSERT_EQUALS(tileCuts[3], 8);
+	TS_ASSERT_EQUALS(Decomposition::tileCuts(blockCuts, 0).size(), 3u);
+
+	// a square grid gets square blocks, a wide grid block columns only
+	TS_ASSERT_EQUALS(Decomposition::processGridRows(4, 100, 100), 2);
+	TS_ASSERT_EQUALS(Decomposition::processGridRows(4, 400, 100), 1);
+
+	// two processes per node share a block column of the 4x2 blocks (100x50 cells each)
+	TS_ASSERT_EQUALS(Decomposition::nodeBlockPosition(4, 2, 400, 100, 2, 1, 1), 3);
+	TS_ASSERT_EQUALS(Decomposition::nodeBlockPosition(4, 2, 400, 100, 2, 2, 0), 4);
+	TS_ASSERT_EQUALS(Decomposition::nodeBlockPosition(3, 3, 300, 300, 2, 0, 0), -1);
+}
+
+void test_blocks_SWE_Block_computeWaveSpeedBounds() {
+	SWE_StepScenario scenario;
+	SWE_WavePropagationBlock block(64, 16, 1.f/64, 1.f/16);
+	block.initScenario(0.f, 0.f, scenario);
+
+	// a fast, shallow (h < dryTol) run-up in the shallow half
+	for(int i = 40; i < 42; i++) for(int j = 0; j < 16; j++) {
+		block.setBathymetry(i, j, -.09f);
+		block.setUnknowns(i, j, .09f, .09f * 40.f, 0.f);
+	}
+
+	block.computeMaxTimestep();
+	const float cellTimestep = block.getMaxTimestep();
+
+	float maxVelocity, maxCelerity;
+	block.computeWaveSpeedBounds(maxVelocity, maxCelerity);
+	TS_ASSERT_DELTA(maxVelocity, 40.f, eps);
+	TS_ASSERT_DELTA(maxCelerity, std::sqrt(SWE_Block::g * 100.f), eps);
+	const float boundedTimestep = SWE_Block::cflNumber / 64 / (maxVelocity + maxCelerity);
+
+	block.setGhostLayer();
+	block.computeNumericalFluxes();
+
+	// the cell-based time step ignores the shallow cells, the bound does not
+	TS_ASSERT(cellTimestep > block.getMaxTimestep());
+	TS_ASSERT(boundedTimestep <= block.getMaxTimestep());
+}
+
+void test_blocks_SWE_Block_isLakeAtRest() {
+	// still water over a varying bottom, incl. steps between the cells of an edge
+	const int n = 8;
+	float hLeft[n], hRight[n], huLeft[n], huRight[n], bLeft[n], bRight[n];
+	for(int k = 0; k < n; k++) {
+		bLeft[k] = -100.f + 11.f*k;
+		bRight[k] = -2.f - 3.f*k;
+		hLeft[k] = -bLeft[k];
+		hRight[k] = -bRight[k];
+		huLeft[k] = huRight[k] = 0.f;
+	}
+
+	float maxWaveSpeed;
+	TS_ASSERT(LakeAtRestCheck::isLakeAtRest(hLeft, hRight, huLeft, huRight, bLeft, bRight, n, maxWaveSpeed));
+
+	// the f-wave solver computes zero net updates and the same largest wave speed
+	solver::FWave<float> fWave;
+	float maxEdgeSpeed = 0.f;
+	for(int k = 0; k < n; k++) {
+		float hUpdateLeft, hUpdateRight, huUpdateLeft, huUpdateRight, edgeSpeed;
+		fWave.computeNetUpdates(hLeft[k], hRight[k], huLeft[k], huRight[k], bLeft[k], bRight[k],
+		                        hUpdateLeft, hUpdateRight, huUpdateLeft, huUpdateRight, edgeSpeed);
+		TS_ASSERT_DELTA(hUpdateLeft, 0.f, eps);
+		TS_ASSERT_DELTA(hUpdateRight, 0.f, eps);
+		TS_ASSERT_DELTA(huUpdateLeft, 0.f, eps);
+		TS_ASSERT_DELTA(huUpdateRight, 0.f, eps);
+		maxEdgeSpeed = std::max(maxEdgeSpeed, edgeSpeed);
+	}
+	TS_ASSERT_DELTA(maxWaveSpeed, maxEdgeSpeed, 1e-5f * maxEdgeSpeed);
+
+	// a single perturbed (or dry) cell falls through to the solver
+	hLeft[3] += .01f;
+	TS_ASSERT(!LakeAtRestCheck::isLakeAtRest(hLeft, hRight, huLeft, huRight, bLeft, bRight, n, maxWaveSpeed));
+	hLeft[3] -= .01f;
+	huRight[n-1] = .01f;
+	TS_ASSERT(!LakeAtRestCheck::isLakeAtRest(hLeft, hRight, huLeft, huRight, bLeft, bRight, n, maxWaveSpeed));
+	huRight[n-1] = 0.f;
+	bRight[0] = hRight[0] = 0.f;
+	TS_ASSERT(!LakeAtRestCheck::isLakeAtRest(hLeft, hRight, huLeft, huRight, bLeft, bRight, n, maxWaveSpeed));
+}
+
+void test_blocks_lakeAtRestFastPath() {
+	SWE_SlopeScenario scenario;
+	SWE_WavePropagationBlock wavePropagation(32, 32, 1.f/32, 1.f/32);
+	SWE_DimensionalSplitting dimensionalSplitting(32, 32, 1.f/32, 1.f/32);
+	wavePropagation.initScenario(0.f, 0.f, scenario);
+	dimensionalSplitting.initScenario(0.f, 0.f, scenario);
+	setLakeAtRest(wavePropagation);
+	setLakeAtRest(dimensionalSplitting);
+
+	// the fastest waves are in the deepest column (the edges between its cells): speed sqrt(g*h)
+	const float depth = wavePropagation.getWaterHeight()[1][1];
+	const float timestep = SWE_Block::cflNumber / 32 / std::sqrt(SWE_Block::g * depth);
+
+	for(int step = 0; step < 5; step++) {
+		wavePropagation.setGhostLayer();
+		wavePropagation.computeNumericalFluxes();
+		TS_ASSERT_DELTA(wavePropagation.getMaxTimestep(), timestep, 1e-5f * timestep);
+		wavePropagation.updateUnknowns(wavePropagation.getMaxTimestep());
+
+		dimensionalSplitting.setGhostLayer();
+		dimensionalSplitting.computeNumericalFluxes();
+		TS_ASSERT_DELTA(dimensionalSplitting.getMaxTimestep(), timestep, 1e-5f * timestep);
+	}
+
+	// zero net updates: the lake stays exactly at rest
+	for(int i = 1; i <= 32; i++) for(int j = 1; j <= 32; j++) {
+		TS_ASSERT_EQUALS(wavePropagation.getWaterHeight()[i][j], -wavePropagation.getBathymetry()[i][j]);
+		TS_ASSERT_EQUALS(wavePropagation.getDischarge_hu()[i][j], 0.f);
+		TS_ASSERT_EQUALS(wavePropagation.getDischarge_hv()[i][j], 0.f);
+		TS_ASSERT_EQUALS(dimensionalSplitting.getWaterHeight()[i][j], -dimensionalSplitting.getBathymetry()[i][j]);
+		TS_ASSERT_EQUALS(dimensionalSplitting.getDischarge_hu()[i][j], 0.f);
+		TS_ASSERT_EQUALS(dimensionalSplitting.getDischarge_hv()[i][j], 0.f);
+	}
+
+	// a single perturbed cell is computed by the solver: the wave reaches its neighbors
+	wavePropagation.setUnknowns(15, 15, wavePropagation.getWaterHeight()[16][16] + .1f, 0.f, 0.f);
+	dimensionalSplitting.setUnknowns(15, 15, dimensionalSplitting.getWaterHeight()[16][16] + .1f, 0.f, 0.f);
+
+	wavePropagation.setGhostLayer();
+	wavePropagation.computeNumericalFluxes();
+	wavePropagation.updateUnknowns(wavePropagation.getMaxTimestep());
+	dimensionalSplitting.setGhostLayer();
+	dimensionalSplitting.computeNumericalFluxes();
+
+	TS_ASSERT(wavePropagation.getWaterHeight()[15][16] > -wavePropagation.getBathymetry()[15][16]);
+	TS_ASSERT(wavePropagation.getWaterHeight()[16][17] > -wavePropagation.getBathymetry()[16][17]);
+	TS_ASSERT(dimensionalSplitting.getWaterHeight()[15][16] > -dimensionalSplitting.getBathymetry()[15][16]);
+	TS_ASSERT(dimensionalSplitting.getWaterHeight()[16][17] > -dimensionalSplitting.getBathymetry()[16][17]);
+}
+
+void test_blocks_SWE_SparseBlockGrid_localTimestepping() {
+	SWE_StepScenario scenario;
+	SWE_SparseBlockGrid<SWE_WavePropagationBlock> grid(64, 16, 1.f/64, 1.f/16, 0.f, 0.f, scenario, 16);
+	grid.setLocalTimestepping(2);
+
+	double mass = 0.;
+	for(int i = 0; i < 4; i++) for(int j = 1; j <= 16; j++) for(int k = 1; k <= 16; k++)
+		mass += grid.getTile(i, 0)->getWaterHeight()[j][k];
+
+	for(int step = 0; step < 10; step++) {
+		const float dt = grid.computeLocalTimesteps();
+		int largestClass = 0;
+		for(int i = 0; i < 4; i++)
+			largestClass = std::max(largestClass, grid.getTimestepClass(i, 0));
+
+		// the time step of each tile satisfies the CFL condition of its fluxes,
+		// including the edges to the neighbors (dt * maxWaveSpeed / dx <= cflNumber)
+		grid.setGhostLayer();
+		grid.computeNumericalFluxes();
+		for(int i = 0; i < 4; i++)
+			TS_ASSERT(dt / (1 << (largestClass - grid.getTimestepClass(i, 0))) <= grid.getTile(i, 0)->getMaxTimestep() * 1.0001f);
+
+		grid.simulateLocalTimesteps(dt);
+	}
+
+	// the deep tiles and the shallow tile next to them (waves of the deep water at the interface)
+	// use the smallest time step
+	TS_ASSERT_EQUALS(grid.getTimestepClass(0, 0), 0);
+	TS_ASSERT_EQUALS(grid.getTimestepClass(1, 0), 0);
+	TS_ASSERT_EQUALS(grid.getTimestepClass(2, 0), 0);
+	TS_ASSERT_EQUALS(grid.getTimestepClass(3, 0), 1);
+
+	// the flux correction at the class interfaces conserves the mass
+	double newMass = 0.;
+	for(int i = 0; i < 4; i++) for(int j = 1; j <= 16; j++) for(int k = 1; k <= 16; k++)
+		newMass += grid.getTile(i, 0)->getWaterHeight()[j][k];
+	TS_ASSERT_DELTA(newMass, mass, 1e-5 * mass);
+}
+
+void test_blocks_SWE_SparseBlockGrid_updateUnknownsAndComputeNumericalFluxes() {
+	SWE_SlopeScenario scenario;
+	SWE_SparseBlockGrid<SWE_WavePropagationBlock> tasked(32, 32, 1.f/32, 1.f/32, 0.f, 0.f, scenario, 8);
+	SWE_SparseBlockGrid<SWE_WavePropagationBlock> sequential(32, 32, 1.f/32, 1.f/32, 0.f, 0.f, scenario, 8);
+
+	tasked.setGhostLayer();
+	tasked.computeNumericalFluxes();
+	sequential.setGhostLayer();
+	sequential.computeNumericalFluxes();
+
+	// the tasks (OpenMP) compute each tile after it and its neighbors are updated: same result as the tile loops
+	for(int step = 0; step < 20; step++) {
+		const float dt = sequential.getMaxTimestep();
+		TS_ASSERT_EQUALS(tasked.getMaxTimestep(), dt);
+
+		tasked.updateUnknownsAndComputeNumericalFluxes(dt);
+		sequential.updateUnknowns(dt);
+		sequential.setGhostLayer();
+		sequential.computeNumericalFluxes();
+	}
+	TS_ASSERT_EQUALS(tasked.getMaxTimestep(), sequential.getMaxTimestep());
+
+	for(int i = 0; i < 4; i++) for(int j = 0; j < 4; j++)
+		for(int k = 1; k <= 8; k++) for(int l = 1; l <= 8; l++) {
+			TS_ASSERT_EQUALS(tasked.getTile(i, j)->getWaterHeight()[k][l], sequential.getTile(i, j)->getWaterHeight()[k][l]);
+			TS_ASSERT_EQUALS(tasked.getTile(i, j)->getDischarge_hu()[k][l], sequential.getTile(i, j)->getDischarge_hu()[k][l]);
+			TS_ASSERT_EQUALS(tasked.getTile(i, j)->getDischarge_hv()[k][l], sequential.getTile(i, j)->getDischarge_hv()[k][l]);
+		}
+}
+
+void test_blocks_SWE_SparseBlockGrid_activeRegion() {
+	SWE_StepScenario scenario;
+	SWE_SparseBlockGrid<SWE_WavePropagationBlock> grid(64, 16, 1.f/64, 1.f/16, 0.f, 0.f, scenario, 8);
+	SWE_SparseBlockGrid<SWE_WavePropagationBlock> reference(64, 16, 1.f/64, 1.f/16, 0.f, 0.f, scenario, 8);
+	grid.setActiveRegionTracking(0.f);
+
+	// the hump disturbs the tiles 5 and 6, the tiles 4 and 7 are computed as their neighbors
+	for(int i = 0; i < 8; i++)
+		TS_ASSERT_EQUALS(grid.isComputed(i, 0), i >= 4);
+
+	// the left wave of the hump disturbs tile 4, which activates tile 3, while tile 2 is still at rest
+	int step = 0;
+	for(; step < 100 && !grid.isComputed(3, 0); step++) {
+		grid.setGhostLayer();
+		grid.computeNumericalFluxes();
+		reference.setGhostLayer();
+		reference.computeNumericalFluxes();
+		TS_ASSERT(!grid.isComputed(2, 0));
+
+		const float dt = reference.getMaxTimestep();
+		grid.updateUnknowns(dt);
+		reference.updateUnknowns(dt);
+	}
+	TS_ASSERT(step > 1 && step < 100);
+
+	// the skipped tiles have zero net updates: the solution is the same as without tracking
+	for(int i = 0; i < 8; i++) for(int j = 1; j <= 8; j++) for(int k = 1; k <= 8; k++) {
+		TS_ASSERT_EQUALS(grid.getTile(i, 0)->getWaterHeight()[j][k], reference.getTile(i, 0)->getWaterHeight()[j][k]);
+		TS_ASSERT_EQUALS(grid.getTile(i, 0)->getDischarge_hu()[j][k], reference.getTile(i, 0)->getDischarge_hu()[j][k]);
+	}
+}
+
+void test_blocks_SWE_AdaptiveBlockGrid_regridMass() {
+	SWE_SlopeScenario scenario;
+	SWE_AdaptiveBlockGrid<SWE_WavePropagationBlock> grid(32, 32, 1.f/32, 1.f/32, 0.f, 0.f, scenario, 8, 2, .05f);
+	const double mass = leafMass(grid);
+
+	// the waves of the hump refine new leaves and leave coarsened ones behind
+	bool refined = false, coarsened = false;
+	for(int step = 0; step < 60; step++) {
+		grid.simulateTimestep(grid.computeMaxTimestep());
+
+		const int leaves = grid.getNumberOfLeaves();
+		grid.regrid();
+		refined = refined || grid.getNumberOfLeaves() > leaves;
+		coarsened = coarsened || grid.getNumberOfLeaves() < leaves;
+	}
+	TS_ASSERT(refined);
+	TS_ASSERT(coarsened);
+
+	// prolongation, restriction and refluxing conserve the mass
+	TS_ASSERT_DELTA(leafMass(grid), mass, 1e-6 * mass);
+}
+
+void test_blocks_SWE_AdaptiveBlockGrid_lakeAtRest() {
+	SWE_SlopeScenario scenario;
+	SWE_AdaptiveBlockGrid<SWE_WavePropagationBlock> grid(32, 32, 1.f/32, 1.f/32, 0.f, 0.f, scenario, 8, 2, .05f);
+	TS_ASSERT_EQUALS(grid.getNumberOfLevels(), 3);
+
+	// remove the hump from the refined grid: the surface is flat over the sloping bottom of all levels
+	for(int l = 0; l < grid.getNumberOfLeaves(); l++) {
+		SWE_Block &block = *grid.getLeaf(l);
+		for(int i = 0; i < block.getNx(); i++) for(int j = 0; j < block.getNy(); j++)
+			block.setUnknowns(i, j, -block.getBathymetry()[i+1][j+1], 0.f, 0.f);
+	}
+
+	for(int step = 0; step < 10; step++)
+		grid.simulateTimestep(grid.computeMaxTimestep());
+
+	for(int l = 0; l < grid.getNumberOfLeaves(); l++) {
+		SWE_Block &block = *grid.getLeaf(l);
+		for(int i = 1; i <= block.getNx(); i++) for(int j = 1; j <= block.getNy(); j++) {
+			TS_ASSERT_DELTA(block.getWaterHeight()[i][j] + block.getBathymetry()[i][j], 0.f, eps);
+			TS_ASSERT_DELTA(block.getDischarge_hu()[i][j], 0.f, eps);
+			TS_ASSERT_DELTA(block.getDischarge_hv()[i][j], 0.f, eps);
+		}
+	}
+}
+
+void test_blocks_SWE_AdaptiveBlockGrid_reflux() {
+	SWE_SlopeScenario scenario;
+	SWE_AdaptiveBlockGrid<SWE_WavePropagationBlock> grid(32, 32, 1.f/32, 1.f/32, 0.f, 0.f, scenario, 8, 2, .05f);
+	const double mass = leafMass(grid);
+
+	// without regrids, the waves leave the refined region around the hump through the interfaces of the levels
+	for(int step = 0; step < 30; step++)
+		grid.simulateTimestep(grid.computeMaxTimestep());
+	TS_ASSERT_EQUALS(grid.getNumberOfLevels(), 3);
+
+	// the coarse cells next to the interfaces are corrected with the fluxes of the sub-cycles
+	TS_ASSERT_DELTA(leafMass(grid), mass, 1e-6 * mass);
+}
+
+void test_blocks_SWE_NestedBlockGrid_mass() {
+	SWE_SlopeScenario scenario;
+	SWE_NestedBlockGrid<SWE_WavePropagationBlock> grid(32, 32, 1.f/32, 1.f/32, 0.f, 0.f, scenario);
+	TS_ASSERT_EQUALS(grid.addNest(.375f, .625f, .375f, .625f, 2), 1);
+
+	// the covered cells of the outer block hold the averages of the nest
+	SWE_Block &outer = *grid.getNest(0);
+	double mass = 0.;
+	for(int i = 1; i <= 32; i++) for(int j = 1; j <= 32; j++)
+		mass += outer.getWaterHeight()[i][j];
+
+	// the waves of the hump cross the nest
+	for(int step = 0; step < 40; step++)
+		grid.simulateTimestep(grid.computeMaxTimestep());
+
+	// the fluxes through the boundary of the nest are not corrected: the mass drifts
+	// by a few 1e-5, but does not grow with the number of time steps
+	double newMass = 0.;
+	for(int i = 1; i <= 32; i++) for(int j = 1; j <= 32; j++)
+		newMass += outer.getWaterHeight()[i][j];
+	TS_ASSERT_DELTA(newMass, mass, 1e-4 * mass);
+}
+
+void test_blocks_SWE_NestedBlockGrid_lakeAtRest() {
+	SWE_SlopeScenario scenario;
+	SWE_NestedBlockGrid<SWE_WavePropagationBlock> grid(32, 32, 1.f/32, 1.f/32, 0.f, 0.f, scenario);
+	TS_ASSERT_EQUALS(grid.addNest(.375f, .625f, .375f, .625f, 2), 1);
+
+	// remove the hump: the surface is flat over the sloping bottom of both blocks
+	for(int n = 0; n < grid.getNumberOfNests(); n++) {
+		SWE_Block &block = *grid.getNest(n);
+		for(int i = 0; i < block.getNx(); i++) for(int j = 0; j < block.getNy(); j++)
+			block.setUnknowns(i, j, -block.getBathymetry()[i+1][j+1], 0.f, 0.f);
+	}
+
+	for(int step = 0; step < 10; step++)
+		grid.simulateTimestep(grid.computeMaxTimestep());
+
+	for(int n = 0; n < grid.getNumberOfNests(); n++) {
+		SWE_Block &block = *grid.getNest(n);
+		for(int i = 1; i <= block.getNx(); i++) for(int j = 1; j <= block.getNy(); j++) {
+			TS_ASSERT_DELTA(block.getWaterHeight()[i][j] + block.getBathymetry()[i][j], 0.f, eps);
+			TS_ASSERT_DELTA(block.getDischarge_hu()[i][j], 0.f, eps);
+			TS_ASSERT_DELTA(block.getDischarge_hv()[i][j], 0.f, eps);
+		}
+	}
+}
+
+void test_writer_DeltaWriter_roundTrip() {
+	SWE_SlopeScenario scenario;
+	SWE_WavePropagationBlock block(32, 32, 1.f/32, 1.f/32);
+	block.initScenario(0.f, 0.f, scenario);
+	const float tolerance = 1e-3f;
+
+	// the inner cells of h, hu and hv of all written frames
+	std::vector< std::vector<float> > frames;
+	std::vector<float> times;
+	{
+		io::BoundarySize boundarySize = {{1, 1, 1, 1}};
+		io::DeltaWriter writer("deltaRoundTrip", block.getBathymetry(), boundarySize, 32, 32, 1.f/32, 1.f/32,
+		                       0.f, 0.f, 3, tolerance, 8);
+
+		float time = 0.f;
+		for(int frame = 0; frame < 7; frame++) {
+			writer.writeTimeStep(block.getWaterHeight(), block.getDischarge_hu(), block.getDischarge_hv(), time);
+			frames.push_back(std::vector<float>());
+			times.push_back(time);
+			for(int i = 1; i <= 32; i++) for(int j = 1; j <= 32; j++) {
+				frames.back().push_back(block.getWaterHeight()[i][j]);
+				frames.back().push_back(block.getDischarge_hu()[i][j]);
+				frames.back().push_back(block.getDischarge_hv()[i][j]);
+			}
+
+			block.setGhostLayer();
+			block.computeNumericalFluxes();
+			time += block.getMaxTimestep();
+			block.updateUnknowns(block.getMaxTimestep());
+		}
+	}
+
+	io::DeltaReader reader("deltaRoundTrip.delta");
+	TS_ASSERT(reader.isValid());
+	TS_ASSERT_EQUALS(reader.getNumberOfFrames(), frames.size());
+
+	Float2D h(32, 32), hu(32, 32), hv(32, 32), b(32, 32);
+	for(size_t frame = 0; frame < reader.getNumberOfFrames(); frame++) {
+		TS_ASSERT_EQUALS(reader.isKeyframe(frame), frame % 3 == 0);
+		TS_ASSERT_EQUALS(reader.getTime(frame), times[frame]);
+		reader.readFrame(frame, h, hu, hv, b);
+
+		// keyframes are exact, the cells of the other frames are within the tolerance
+		const float maxError = reader.isKeyframe(frame) ? 0.f : tolerance;
+		for(int i = 0; i < 32; i++) for(int j = 0; j < 32; j++) {
+			const float* cell = &frames[frame][3*(32*i + j)];
+			TS_ASSERT_DELTA(h[i][j], cell[0], maxError);
+			TS_ASSERT_DELTA(hu[i][j], cell[1], maxError);
+			TS_ASSERT_DELTA(hv[i][j], cell[2], maxError);
+			TS_ASSERT_EQUALS(b[i][j], block.getBathymetry()[i+1][j+1]);
+		}
+	}
+
+	std::remove("deltaRoundTrip.delta");
+}
+
+void test_tools_Float2D_compress() {
+	// 5x3 cells with one ghost layer, values 10*x + y
+	Float2D input(7, 5), h(7, 5), output(3, 2);
+	for(int i = 0; i < 7; i++) for(int j = 0; j < 5; j++) {
+		input[i][j] = 10 * (i-1) + (j-1);
+		h[i][j] = (i == 1) ? 0 : 1;
+	}
+
+	TS_ASSERT_EQUALS(Float2D::compressedSize(5, 2), 3);
+
+	Float2D::compress(input, output, 2, 1, 1, 1, 1, Float2D::COMPRESS_MEAN);
+	TS_ASSERT_DELTA(output[0][0], 5.5f, eps);
+	TS_ASSERT_DELTA(output[2][1], 42.f, eps);
+
+	Float2D::compress(input, output, 2, 1, 1, 1, 1, Float2D::COMPRESS_MAX);
+	TS_ASSERT_DELTA(output[1][0], 31.f, eps);
+
+	Float2D::compress(input, output, 2, 1, 1, 1, 1, Float2D::COMPRESS_MIN);
+	TS_ASSERT_DELTA(output[1][1], 22.f, eps);
+
+	// the first column is dry
+	Float2D::compress(input, output, 2, 1, 1, 1, 1, Float2D::COMPRESS_WET_MEAN, &h);
+	TS_ASSERT_DELTA(output[0][0], 10.5f, eps);
+	TS_ASSERT_DELTA(output[0][1], 12.f, eps);
+}
 };
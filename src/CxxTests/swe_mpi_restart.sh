@@ -0,0 +1,79 @@
+#!/bin/sh
+
+# @file
+# This file is part of SWE.
+#
+# @section LICENSE
+#
+# SWE is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# SWE is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+#
+#
+# @section DESCRIPTION
+#
+# Restart test of the MPI version: interrupts a run on 2 processes at half of the
+# simulated time, restarts it and compares the final checkpoint with the one of an
+# uninterrupted run (time, number of time steps and all cells have to be bit-identical).
+#
+# The restart on the same number of processes uses the default halo. The restart on
+# a different number of processes uses a deep halo: the inner and outer fluxes of the
+# default halo are accumulated in an order which depends on the decomposition.
+#
+# Usage: swe_mpi_restart.sh <swe_mpi binary> [mpirun command]
+#
+
+SWE_MPI=${1:?"Usage: $0 <swe_mpi binary> [mpirun command]"}
+MPIRUN=${2:-mpirun}
+
+# 100x100 cells, the radial dam break ends at 30 s
+OPTIONS="-x 100 -y 100 --output-interval 5"
+# h, hu and hv of all cells at the end of the checkpoint (the header contains the decomposition)
+CELL_BYTES=120000
+
+WORKDIR=`mktemp -d`
+trap 'rm -rf "$WORKDIR"' EXIT
+cd "$WORKDIR" && mkdir results || exit 1
+
+# fail <message>
+fail() {
+  echo "FAILED: $1 (see $WORKDIR)"
+  trap - EXIT
+  exit 1
+}
+
+# run <name> <processes> <options>
+run() {
+  NAME=$1
+  PROCESSES=$2
+  shift 2
+  $MPIRUN -np $PROCESSES "$SWE_MPI" $OPTIONS -o $NAME --checkpoint-file $NAME.chk "$@" > $NAME.log 2>&1 ||
+    fail "$NAME on $PROCESSES processes"
+}
+
+# restart test: <halo width> <processes of the restart>
+for CONFIGURATION in "1 2" "2 4"; do
+  set -- $CONFIGURATION
+  TEST=halo$1_restart$2
+
+  run ${TEST}_full 2 --halo-width $1
+  run ${TEST}_half 2 --halo-width $1 --end-time 15
+  run $TEST $2 --halo-width $1 --restart ${TEST}_half.chk
+
+  # magic, grid size, number of time steps and time; all cells
+  tail -c $CELL_BYTES ${TEST}_full.chk > ${TEST}_full.cells
+  tail -c $CELL_BYTES $TEST.chk > $TEST.cells
+  if ! cmp -s -n 20 ${TEST}_full.chk $TEST.chk || ! cmp -s ${TEST}_full.cells $TEST.cells; then
+    fail "restart on $2 processes (halo width $1) differs from the uninterrupted run"
+  fi
+  echo "OK: restart on $2 processes (halo width $1)"
+done
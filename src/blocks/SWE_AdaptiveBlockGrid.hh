@@ -0,0 +1,902 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Block-structured adaptive mesh refinement: a tree of SWE_Blocks with sub-cycling in time.
+ */
+
+#ifndef SWE_ADAPTIVEBLOCKGRID_HH_
+#define SWE_ADAPTIVEBLOCKGRID_HH_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "blocks/SWE_Block.hh"
+#include "scenarios/SWE_Scenario.hh"
+#include "tools/Decomposition.hh"
+
+/**
+ * Block-structured adaptive mesh refinement of a rectangular domain with
+ * nx x ny cells on the coarsest level.
+ *
+ * The domain is tiled into root blocks of (at most) blockSize x blockSize
+ * cells (level 0). Refining a block replaces it by four blocks with the same
+ * number of cells and half the cell size (next level), up to the maximum
+ * level. Only the leaves of this tree have blocks, neighboring leaves differ
+ * by at most one level.
+ *
+ * Refinement: a leaf is flagged if the water surface of two neighboring wet
+ * cells (incl. the ghost layer) differs by more than the threshold, or at a
+ * wet/dry interface with moving water. The neighbors of flagged leaves are
+ * flagged as well, such that the waves stay in the refined region until the
+ * next regrid. Four sibling leaves are coarsened if all differences are below
+ * half the threshold.
+ *
+ * Levels: the bathymetry of a cell is the average of the scenario at the
+ * finest level, i.e. a coarse cell has the average bathymetry of its fine
+ * cells. Fine cells get the water surface of the coarse cell, or its water
+ * height if the surface is below the bathymetry of a fine cell, and its
+ * velocity (prolongation). Coarse cells get the average of the fine cells
+ * (restriction). Both conserve mass and momentum, the prolongation of the
+ * surface keeps a lake at rest.
+ *
+ * Time stepping: each time step of a level is followed by two time steps of
+ * the next level with half the time step width (sub-cycling). The ghost cells
+ * next to a coarser leaf are prolongated from its values before and after its
+ * time step (linear in time), the ghost cells next to finer leaves are
+ * restricted from them. Afterwards the coarse cells next to finer leaves are
+ * corrected with the fluxes of the fine time steps (refluxing), which
+ * conserves the mass. The momentum is not corrected: with the bathymetry
+ * source term in the net updates, the momentum fluxes of both levels differ
+ * also for a lake at rest.
+ *
+ * With OpenMP, the leaves of a level are processed in parallel.
+ *
+ * @tparam Block the block type of the leaves (requires a constructor (nx, ny, dx, dy)
+ *  and SWE_Block::getBoundaryFluxes()).
+ */
+template <class Block>
+class SWE_AdaptiveBlockGrid {
+  private:
+    /**
+     * Node of the refinement tree. A leaf has a block, a refined node has four
+     * children (column-major) with the same number of cells.
+     */
+    struct Node {
+      //! refinement level, 0 for the root blocks
+      int level;
+
+      //! first cell in x- and y-direction, at the resolution of the level
+      int offsetX, offsetY;
+
+      //! number of cells
+      int nx, ny;
+
+      //! parent node, 0 for the root blocks
+      Node* parent;
+
+      //! children (column-major), 0 for leaves
+      Node* children[4];
+
+      //! the block of a leaf, 0 for refined nodes
+      Block* block;
+
+      //! level of the neighbors at each edge, -1 at the domain boundary
+      int neighborLevels[4];
+
+      //! proxies of the ghost layers at edges to other levels
+      SWE_Block1D* ghostLayers[4];
+
+      //! copy layers (h, hu, hv) at the beginning of the time step, at edges to finer leaves
+      std::vector<float> oldLayers[4];
+
+      //! time step width times flux of h through the edges to other levels
+      std::vector<float> fluxes[4];
+
+      //! flagged for refinement (or in the buffer of a flagged leaf)
+      bool flagged;
+
+      //! all differences are below half the threshold
+      bool coarsenable;
+
+      //! refined in the current regrid
+      bool refine;
+
+      Node(int i_level, int i_offsetX, int i_offsetY, int i_nx, int i_ny, Node* i_parent):
+        level(i_level),
+        offsetX(i_offsetX), offsetY(i_offsetY),
+        nx(i_nx), ny(i_ny),
+        parent(i_parent),
+        block(0),
+        flagged(false), coarsenable(false), refine(false) {
+        for (int l_edge = 0; l_edge < 4; l_edge++) {
+          children[l_edge] = 0;
+          neighborLevels[l_edge] = -1;
+          ghostLayers[l_edge] = 0;
+        }
+      }
+
+      ~Node() {
+        for (int l_edge = 0; l_edge < 4; l_edge++) {
+          delete children[l_edge];
+          delete ghostLayers[l_edge];
+        }
+        delete block;
+      }
+
+      //! @return number of cells along an edge
+      int length(int i_edge) const {
+        return (i_edge == BND_LEFT || i_edge == BND_RIGHT) ? ny : nx;
+      }
+    };
+
+    //! number of cells of level 0
+    int nx, ny;
+
+    //! cell size of level 0
+    float dx, dy;
+
+    //! lower left corner of the domain
+    float originX, originY;
+
+    //! maximum refinement level
+    int maxLevel;
+
+    //! maximum difference of the water surface of neighboring cells without refinement
+    float refineThreshold;
+
+    //! safety factor of the time step (the time step is fixed for all sub-cycles)
+    float timestepFactor;
+
+    //! cells with less water are dry (see SWE_Block::computeMaxTimestep())
+    float dryTol;
+
+    //! the scenario, provides the bathymetry of new blocks
+    SWE_Scenario &scenario;
+
+    //! first cell of each root column (row), followed by the number of cells
+    std::vector<int> cutsX, cutsY;
+
+    //! the root blocks (column-major)
+    std::vector<Node*> roots;
+
+    //! the leaves of each level
+    std::vector< std::vector<Node*> > levels;
+
+    //! all leaves, ordered by level
+    std::vector<Node*> leaves;
+
+    //! proxies of the copy layers used by edges between leaves of the same level
+    std::vector<SWE_Block1D*> copyLayers;
+
+    //! time step width of level 0
+    float maxTimestep;
+
+    // no copies, the grid owns the blocks
+    SWE_AdaptiveBlockGrid(const SWE_AdaptiveBlockGrid&);
+    SWE_AdaptiveBlockGrid& operator=(const SWE_AdaptiveBlockGrid&);
+
+    /**
+     * @return the leaf which contains a cell of the given level, the refined node at this
+     *  level if the cell is refined, 0 outside of the domain
+     */
+    Node* findNode(int i_level, int i_x, int i_y) const {
+      if (i_x < 0 || i_y < 0 || (i_x >> i_level) >= nx || (i_y >> i_level) >= ny)
+        return 0;
+
+      const int i = std::upper_bound(cutsX.begin(), cutsX.end(), i_x >> i_level) - cutsX.begin() - 1;
+      const int j = std::upper_bound(cutsY.begin(), cutsY.end(), i_y >> i_level) - cutsY.begin() - 1;
+      Node* l_node = roots[i*(cutsY.size()-1) + j];
+
+      while (l_node->block == 0 && l_node->level < i_level) {
+        // child 0 covers the first nx (ny) cells of the next level
+        const int l_shift = i_level - l_node->level - 1;
+        const int l_childX = (i_x >> l_shift) >= 2*l_node->offsetX + l_node->nx;
+        const int l_childY = (i_y >> l_shift) >= 2*l_node->offsetY + l_node->ny;
+        l_node = l_node->children[2*l_childX + l_childY];
+      }
+
+      return l_node;
+    }
+
+    /**
+     * Appends the leaves next to an edge of a leaf: one of the same or the coarser
+     * level, or two of the finer level. None at the domain boundary.
+     */
+    void getNeighbors(const Node &i_node, int i_edge, std::vector<Node*> &o_neighbors) const {
+      const bool l_vertical = (i_edge == BND_LEFT || i_edge == BND_RIGHT);
+
+      // cells of the finer level next to the edge
+      const int l_x = (i_edge == BND_LEFT) ? 2*i_node.offsetX - 1
+                    : (i_edge == BND_RIGHT) ? 2*(i_node.offsetX + i_node.nx) : 2*i_node.offsetX;
+      const int l_y = (i_edge == BND_BOTTOM) ? 2*i_node.offsetY - 1
+                    : (i_edge == BND_TOP) ? 2*(i_node.offsetY + i_node.ny) : 2*i_node.offsetY;
+
+      for (int k = 0; k < 2*i_node.length(i_edge); k++) {
+        Node* l_neighbor = findNode( i_node.level+1, l_x + (l_vertical ? 0 : k), l_y + (l_vertical ? k : 0) );
+        if (l_neighbor != 0 && std::find(o_neighbors.begin(), o_neighbors.end(), l_neighbor) == o_neighbors.end())
+          o_neighbors.push_back(l_neighbor);
+      }
+    }
+
+    /**
+     * Allocates the block of a leaf.
+     * The bathymetry of all cells (incl. the ghost layer) is the average of the scenario at
+     * the finest level, the unknowns too if requested.
+     */
+    void createBlock(Node &io_node, bool i_initUnknowns) {
+      const float l_dx = dx / (1 << io_node.level);
+      const float l_dy = dy / (1 << io_node.level);
+
+      io_node.block = new Block(io_node.nx, io_node.ny, l_dx, l_dy);
+      io_node.block->initScenario( originX + io_node.offsetX*l_dx, originY + io_node.offsetY*l_dy, scenario, true );
+
+      // samples per cell and direction
+      const int l_samples = 1 << (maxLevel - io_node.level);
+      if (l_samples == 1)
+        return;
+
+      const float l_scale = 1.f / (l_samples*l_samples);
+      for (int i = -1; i <= io_node.nx; i++)
+        for (int j = -1; j <= io_node.ny; j++) {
+          const bool l_inner = i >= 0 && i < io_node.nx && j >= 0 && j < io_node.ny;
+          float l_b = 0.f, l_h = 0.f, l_hu = 0.f, l_hv = 0.f;
+
+          for (int k = 0; k < l_samples; k++)
+            for (int l = 0; l < l_samples; l++) {
+              const float x = originX + (io_node.offsetX + i + (k+.5f)/l_samples) * l_dx;
+              const float y = originY + (io_node.offsetY + j + (l+.5f)/l_samples) * l_dy;
+
+              l_b += scenario.getBathymetry(x, y);
+              if (i_initUnknowns && l_inner) {
+                const float l_height = scenario.getWaterHeight(x, y);
+                l_h += l_height;
+                l_hu += scenario.getVeloc_u(x, y) * l_height;
+                l_hv += scenario.getVeloc_v(x, y) * l_height;
+              }
+            }
+
+          io_node.block->setBathymetry(i, j, l_b * l_scale);
+          if (i_initUnknowns && l_inner)
+            io_node.block->setUnknowns(i, j, l_h * l_scale, l_hu * l_scale, l_hv * l_scale);
+        }
+    }
+
+    /**
+     * Replaces the block of a leaf by four children.
+     *
+     * @param i_fromScenario initialize the children with the scenario instead of the leaf.
+     */
+    void refine(Node &io_node, bool i_fromScenario) {
+      for (int l_child = 0; l_child < 4; l_child++) {
+        Node* l_node = new Node( io_node.level+1,
+                                 2*io_node.offsetX + (l_child/2)*io_node.nx,
+                                 2*io_node.offsetY + (l_child%2)*io_node.ny,
+                                 io_node.nx, io_node.ny, &io_node );
+        createBlock(*l_node, i_fromScenario);
+        io_node.children[l_child] = l_node;
+      }
+
+      if (!i_fromScenario) {
+        const Float2D &l_h = io_node.block->getWaterHeight();
+        const Float2D &l_hu = io_node.block->getDischarge_hu();
+        const Float2D &l_hv = io_node.block->getDischarge_hv();
+        const Float2D &l_b = io_node.block->getBathymetry();
+
+        for (int i = 0; i < io_node.nx; i++)
+          for (int j = 0; j < io_node.ny; j++) {
+            // the four fine cells of the coarse cell: child and cell in the child
+            Block* l_blocks[4];
+            int l_x[4], l_y[4];
+            float l_fineB[4];
+            bool l_aboveBathymetry = true;
+
+            for (int l_cell = 0; l_cell < 4; l_cell++) {
+              const int l_fineX = 2*i + l_cell/2, l_fineY = 2*j + l_cell%2;
+              const int l_childX = l_fineX >= io_node.nx, l_childY = l_fineY >= io_node.ny;
+
+              l_blocks[l_cell] = io_node.children[2*l_childX + l_childY]->block;
+              l_x[l_cell] = l_fineX - l_childX*io_node.nx;
+              l_y[l_cell] = l_fineY - l_childY*io_node.ny;
+              l_fineB[l_cell] = l_blocks[l_cell]->getBathymetry()[l_x[l_cell]+1][l_y[l_cell]+1];
+              l_aboveBathymetry = l_aboveBathymetry && l_h[i+1][j+1] + l_b[i+1][j+1] >= l_fineB[l_cell];
+            }
+
+            for (int l_cell = 0; l_cell < 4; l_cell++) {
+              const float l_fineH = l_aboveBathymetry ? l_h[i+1][j+1] + l_b[i+1][j+1] - l_fineB[l_cell] : l_h[i+1][j+1];
+              const float l_velocityScale = (l_h[i+1][j+1] > 0.f) ? l_fineH / l_h[i+1][j+1] : 0.f;
+
+              l_blocks[l_cell]->setUnknowns( l_x[l_cell], l_y[l_cell], l_fineH,
+                                             l_hu[i+1][j+1] * l_velocityScale, l_hv[i+1][j+1] * l_velocityScale );
+            }
+          }
+      }
+
+      delete io_node.block;
+      io_node.block = 0;
+    }
+
+    /**
+     * Replaces the four children of a node by a block with the averages of their cells.
+     */
+    void coarsen(Node &io_node) {
+      createBlock(io_node, false);
+
+      std::vector<float> l_sums(3 * io_node.nx * io_node.ny, 0.f);
+      for (int l_child = 0; l_child < 4; l_child++) {
+        Block &l_block = *io_node.children[l_child]->block;
+        const Float2D &l_h = l_block.getWaterHeight();
+        const Float2D &l_hu = l_block.getDischarge_hu();
+        const Float2D &l_hv = l_block.getDischarge_hv();
+
+        for (int i = 0; i < io_node.nx; i++)
+          for (int j = 0; j < io_node.ny; j++) {
+            const int l_cell = 3 * ( ((l_child/2)*io_node.nx + i)/2 * io_node.ny + ((l_child%2)*io_node.ny + j)/2 );
+            l_sums[l_cell] += l_h[i+1][j+1];
+            l_sums[l_cell+1] += l_hu[i+1][j+1];
+            l_sums[l_cell+2] += l_hv[i+1][j+1];
+          }
+
+        delete io_node.children[l_child];
+        io_node.children[l_child] = 0;
+      }
+
+      for (int i = 0; i < io_node.nx; i++)
+        for (int j = 0; j < io_node.ny; j++) {
+          const int l_cell = 3 * (i*io_node.ny + j);
+          io_node.block->setUnknowns(i, j, .25f*l_sums[l_cell], .25f*l_sums[l_cell+1], .25f*l_sums[l_cell+2]);
+        }
+    }
+
+    /**
+     * @return difference of the water surface of two cells if both are wet, infinity if only
+     *  one is wet and its water moves, 0 otherwise
+     */
+    float surfaceDifference( const Float2D &i_h, const Float2D &i_hu, const Float2D &i_hv, const Float2D &i_b,
+                             int i_x0, int i_y0, int i_x1, int i_y1 ) const {
+      const bool l_wet0 = i_h[i_x0][i_y0] > dryTol, l_wet1 = i_h[i_x1][i_y1] > dryTol;
+
+      if (l_wet0 && l_wet1)
+        return std::abs( i_h[i_x0][i_y0] + i_b[i_x0][i_y0] - i_h[i_x1][i_y1] - i_b[i_x1][i_y1] );
+
+      if (l_wet0 != l_wet1) {
+        const int i = l_wet0 ? i_x0 : i_x1, j = l_wet0 ? i_y0 : i_y1;
+        if (i_hu[i][j] != 0.f || i_hv[i][j] != 0.f)
+          return std::numeric_limits<float>::max();
+      }
+
+      return 0.f;
+    }
+
+    /**
+     * @return maximum difference of neighboring cells of a leaf, incl. the ghost layer
+     *  (see surfaceDifference())
+     */
+    float computeRefinementIndicator(Node &i_node) const {
+      const Float2D &l_h = i_node.block->getWaterHeight();
+      const Float2D &l_hu = i_node.block->getDischarge_hu();
+      const Float2D &l_hv = i_node.block->getDischarge_hv();
+      const Float2D &l_b = i_node.block->getBathymetry();
+
+      float l_indicator = 0.f;
+      for (int i = 0; i <= i_node.nx; i++)
+        for (int j = 1; j <= i_node.ny; j++)
+          l_indicator = std::max( l_indicator, surfaceDifference(l_h, l_hu, l_hv, l_b, i, j, i+1, j) );
+
+      for (int i = 1; i <= i_node.nx; i++)
+        for (int j = 0; j <= i_node.ny; j++)
+          l_indicator = std::max( l_indicator, surfaceDifference(l_h, l_hu, l_hv, l_b, i, j, i, j+1) );
+
+      return l_indicator;
+    }
+
+    /**
+     * Sets the ghost layers of a leaf at the edges to other levels.
+     *
+     * @param i_alpha time of the coarser leaves, between the beginning (0) and the end (1) of their time step.
+     */
+    void setGhostLayers(Node &io_node, float i_alpha) {
+      const Float2D &l_b = io_node.block->getBathymetry();
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        if (io_node.neighborLevels[l_edge] < 0 || io_node.neighborLevels[l_edge] == io_node.level)
+          continue;
+
+        const bool l_vertical = (l_edge == BND_LEFT || l_edge == BND_RIGHT);
+        SWE_Block1D &l_ghostLayer = *io_node.ghostLayers[l_edge];
+
+        for (int k = 0; k < io_node.length(l_edge); k++) {
+          // ghost cell in the block and at the level
+          const int i = (l_edge == BND_LEFT) ? 0 : (l_edge == BND_RIGHT) ? io_node.nx+1 : k+1;
+          const int j = (l_edge == BND_BOTTOM) ? 0 : (l_edge == BND_TOP) ? io_node.ny+1 : k+1;
+          const int l_x = io_node.offsetX + i - 1, l_y = io_node.offsetY + j - 1;
+
+          if (io_node.neighborLevels[l_edge] < io_node.level) {
+            // prolongation of the coarse cell, interpolated in time
+            const Node &l_coarse = *findNode(io_node.level-1, l_x >> 1, l_y >> 1);
+            const int l_coarseX = (l_x >> 1) - l_coarse.offsetX + 1, l_coarseY = (l_y >> 1) - l_coarse.offsetY + 1;
+
+            float l_h = l_coarse.block->getWaterHeight()[l_coarseX][l_coarseY];
+            float l_hu = l_coarse.block->getDischarge_hu()[l_coarseX][l_coarseY];
+            float l_hv = l_coarse.block->getDischarge_hv()[l_coarseX][l_coarseY];
+            if (i_alpha < 1.f) {
+              // the copy layer of the coarse leaf at the opposite edge
+              const float* l_old = &l_coarse.oldLayers[l_edge ^ 1][3 * (l_vertical ? l_coarseY-1 : l_coarseX-1)];
+              l_h = l_old[0] + i_alpha * (l_h - l_old[0]);
+              l_hu = l_old[1] + i_alpha * (l_hu - l_old[1]);
+              l_hv = l_old[2] + i_alpha * (l_hv - l_old[2]);
+            }
+
+            const float l_surface = l_h + l_coarse.block->getBathymetry()[l_coarseX][l_coarseY];
+            const float l_fineH = (l_h > 0.f) ? std::max(l_surface - l_b[i][j], 0.f) : 0.f;
+            const float l_velocityScale = (l_h > 0.f) ? l_fineH / l_h : 0.f;
+
+            l_ghostLayer.h[k+1] = l_fineH;
+            l_ghostLayer.hu[k+1] = l_hu * l_velocityScale;
+            l_ghostLayer.hv[k+1] = l_hv * l_velocityScale;
+          } else {
+            // restriction of the four fine cells
+            float l_h = 0.f, l_hu = 0.f, l_hv = 0.f;
+            for (int l_cell = 0; l_cell < 4; l_cell++) {
+              const int l_fineX = 2*l_x + l_cell/2, l_fineY = 2*l_y + l_cell%2;
+              const Node &l_fine = *findNode(io_node.level+1, l_fineX, l_fineY);
+
+              l_h += l_fine.block->getWaterHeight()[l_fineX - l_fine.offsetX + 1][l_fineY - l_fine.offsetY + 1];
+              l_hu += l_fine.block->getDischarge_hu()[l_fineX - l_fine.offsetX + 1][l_fineY - l_fine.offsetY + 1];
+              l_hv += l_fine.block->getDischarge_hv()[l_fineX - l_fine.offsetX + 1][l_fineY - l_fine.offsetY + 1];
+            }
+
+            l_ghostLayer.h[k+1] = .25f*l_h;
+            l_ghostLayer.hu[k+1] = .25f*l_hu;
+            l_ghostLayer.hv[k+1] = .25f*l_hv;
+          }
+        }
+      }
+    }
+
+    /**
+     * Adds the fluxes of h through the edges to other levels (after the computation of
+     * the numerical fluxes).
+     *
+     * @param i_dt time step width.
+     * @param i_firstSubcycle first time step of the leaf within the time step of the coarser level.
+     */
+    void addFluxes(Node &io_node, float i_dt, bool i_firstSubcycle) {
+      // the flux of h is the same on both sides of the edge, the momentum fluxes are not used
+      std::vector<float> l_hFluxes, l_momentumFluxes;
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        const int l_neighborLevel = io_node.neighborLevels[l_edge];
+        if (l_neighborLevel < 0 || l_neighborLevel == io_node.level)
+          continue;
+
+        // the coarse leaf sums up a single time step, the fine leaf all of its sub-cycles
+        std::vector<float> &l_fluxes = io_node.fluxes[l_edge];
+        if (l_neighborLevel > io_node.level || i_firstSubcycle)
+          std::fill(l_fluxes.begin(), l_fluxes.end(), 0.f);
+
+        l_hFluxes.resize(io_node.length(l_edge));
+        l_momentumFluxes.resize(io_node.length(l_edge));
+        io_node.block->getBoundaryFluxes( BoundaryEdge(l_edge), l_neighborLevel < io_node.level,
+                                          &l_hFluxes[0], &l_momentumFluxes[0] );
+
+        for (int k = 0; k < io_node.length(l_edge); k++)
+          l_fluxes[k] += i_dt * l_hFluxes[k];
+      }
+    }
+
+    /**
+     * Stores the copy layers at the edges to finer leaves, before the unknowns are updated.
+     */
+    void storeOldLayers(Node &io_node) {
+      const Float2D &l_h = io_node.block->getWaterHeight();
+      const Float2D &l_hu = io_node.block->getDischarge_hu();
+      const Float2D &l_hv = io_node.block->getDischarge_hv();
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        if (io_node.neighborLevels[l_edge] <= io_node.level)
+          continue;
+
+        for (int k = 0; k < io_node.length(l_edge); k++) {
+          const int i = (l_edge == BND_LEFT) ? 1 : (l_edge == BND_RIGHT) ? io_node.nx : k+1;
+          const int j = (l_edge == BND_BOTTOM) ? 1 : (l_edge == BND_TOP) ? io_node.ny : k+1;
+
+          io_node.oldLayers[l_edge][3*k] = l_h[i][j];
+          io_node.oldLayers[l_edge][3*k+1] = l_hu[i][j];
+          io_node.oldLayers[l_edge][3*k+2] = l_hv[i][j];
+        }
+      }
+    }
+
+    /**
+     * Corrects the cells of a leaf next to finer leaves: replaces the flux of its time step by
+     * the fluxes of the sub-cycles of the finer leaves.
+     */
+    void reflux(Node &io_node) {
+      const Float2D &l_h = io_node.block->getWaterHeight();
+      const Float2D &l_hu = io_node.block->getDischarge_hu();
+      const Float2D &l_hv = io_node.block->getDischarge_hv();
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        if (io_node.neighborLevels[l_edge] <= io_node.level)
+          continue;
+
+        const bool l_vertical = (l_edge == BND_LEFT || l_edge == BND_RIGHT);
+        const float l_cellSize = l_vertical ? io_node.block->getDx() : io_node.block->getDy();
+        // the fluxes point in positive x- (y-)direction, i.e. out of the cells at the right (top) edge
+        const float l_sign = (l_edge == BND_RIGHT || l_edge == BND_TOP) ? 1.f : -1.f;
+
+        // first column (row) of the finer level next to the edge
+        const int l_fineCells = (l_edge == BND_LEFT) ? 2*io_node.offsetX - 1
+                              : (l_edge == BND_RIGHT) ? 2*(io_node.offsetX + io_node.nx)
+                              : (l_edge == BND_BOTTOM) ? 2*io_node.offsetY - 1 : 2*(io_node.offsetY + io_node.ny);
+
+        for (int k = 0; k < io_node.length(l_edge); k++) {
+          // fluxes of the two fine edges
+          float l_fineH = 0.f;
+          for (int l_fine = 0; l_fine < 2; l_fine++) {
+            const int l_position = 2*((l_vertical ? io_node.offsetY : io_node.offsetX) + k) + l_fine;
+            const Node &l_node = *findNode( io_node.level+1, l_vertical ? l_fineCells : l_position,
+                                                             l_vertical ? l_position : l_fineCells );
+            const int l_index = l_position - (l_vertical ? l_node.offsetY : l_node.offsetX);
+
+            l_fineH += l_node.fluxes[l_edge ^ 1][l_index];
+          }
+
+          const int i = (l_edge == BND_LEFT) ? 1 : (l_edge == BND_RIGHT) ? io_node.nx : k+1;
+          const int j = (l_edge == BND_BOTTOM) ? 1 : (l_edge == BND_TOP) ? io_node.ny : k+1;
+
+          const float l_newH = l_h[i][j] + l_sign * (io_node.fluxes[l_edge][k] - .5f*l_fineH) / l_cellSize;
+          if (l_newH < 0.f)
+            io_node.block->setUnknowns(i-1, j-1, 0.f, 0.f, 0.f);
+          else
+            io_node.block->setUnknowns(i-1, j-1, l_newH, l_hu[i][j], l_hv[i][j]);
+        }
+      }
+    }
+
+    /**
+     * Executes a time step of a level, followed by the time steps of the finer levels.
+     *
+     * @param i_alpha time of the coarser level at the beginning of the time step (0 or 1/2).
+     */
+    void advance(int i_level, float i_dt, float i_alpha) {
+      const int l_numberOfLeaves = levels[i_level].size();
+      Node** l_leaves = l_numberOfLeaves > 0 ? &levels[i_level][0] : 0;
+
+      #pragma omp parallel for schedule(dynamic) if(l_numberOfLeaves > 1)
+      for (int l_leaf = 0; l_leaf < l_numberOfLeaves; l_leaf++) {
+        setGhostLayers(*l_leaves[l_leaf], i_alpha);
+        l_leaves[l_leaf]->block->setGhostLayer();
+      }
+
+      #pragma omp parallel for schedule(dynamic) if(l_numberOfLeaves > 1)
+      for (int l_leaf = 0; l_leaf < l_numberOfLeaves; l_leaf++) {
+        Node &l_node = *l_leaves[l_leaf];
+
+        l_node.block->computeNumericalFluxes();
+        addFluxes(l_node, i_dt, i_alpha == 0.f);
+        storeOldLayers(l_node);
+        l_node.block->updateUnknowns(i_dt);
+      }
+
+      if (i_level+1 < (int) levels.size()) {
+        advance(i_level+1, .5f*i_dt, 0.f);
+        advance(i_level+1, .5f*i_dt, .5f);
+
+        #pragma omp parallel for schedule(dynamic) if(l_numberOfLeaves > 1)
+        for (int l_leaf = 0; l_leaf < l_numberOfLeaves; l_leaf++)
+          reflux(*l_leaves[l_leaf]);
+      }
+    }
+
+    //! adds the leaves of a subtree to their levels
+    void collectLeaves(Node &i_node) {
+      if (i_node.block != 0) {
+        if ((int) levels.size() <= i_node.level)
+          levels.resize(i_node.level+1);
+        levels[i_node.level].push_back(&i_node);
+        return;
+      }
+
+      for (int l_child = 0; l_child < 4; l_child++)
+        collectLeaves(*i_node.children[l_child]);
+    }
+
+    /**
+     * Collects the leaves and connects their edges: CONNECT to a leaf of the same level,
+     * PASSIVE to a leaf of another level (see setGhostLayers()), the scenario's boundary
+     * condition at the domain boundary.
+     */
+    void connect() {
+      for (size_t l_layer = 0; l_layer < copyLayers.size(); l_layer++)
+        delete copyLayers[l_layer];
+      copyLayers.clear();
+
+      levels.clear();
+      for (size_t l_root = 0; l_root < roots.size(); l_root++)
+        collectLeaves(*roots[l_root]);
+
+      leaves.clear();
+      for (size_t l_level = 0; l_level < levels.size(); l_level++)
+        leaves.insert(leaves.end(), levels[l_level].begin(), levels[l_level].end());
+
+      std::vector<Node*> l_neighbors;
+      for (size_t l_leaf = 0; l_leaf < leaves.size(); l_leaf++) {
+        Node &l_node = *leaves[l_leaf];
+
+        for (int l_edge = 0; l_edge < 4; l_edge++) {
+          delete l_node.ghostLayers[l_edge];
+          l_node.ghostLayers[l_edge] = 0;
+
+          l_neighbors.clear();
+          getNeighbors(l_node, l_edge, l_neighbors);
+
+          if (l_neighbors.empty()) {
+            l_node.neighborLevels[l_edge] = -1;
+            l_node.block->setBoundaryType(BoundaryEdge(l_edge), scenario.getBoundaryType(BoundaryEdge(l_edge)));
+          } else if (l_neighbors[0]->level == l_node.level) {
+            l_node.neighborLevels[l_edge] = l_node.level;
+            copyLayers.push_back( l_neighbors[0]->block->registerCopyLayer(BoundaryEdge(l_edge ^ 1)) );
+            l_node.block->setBoundaryType(BoundaryEdge(l_edge), CONNECT, copyLayers.back());
+          } else {
+            l_node.neighborLevels[l_edge] = l_neighbors[0]->level;
+            l_node.ghostLayers[l_edge] = l_node.block->grabGhostLayer(BoundaryEdge(l_edge));
+          }
+
+          const bool l_otherLevel = l_node.neighborLevels[l_edge] >= 0 && l_node.neighborLevels[l_edge] != l_node.level;
+          l_node.fluxes[l_edge].assign(l_otherLevel ? l_node.length(l_edge) : 0, 0.f);
+          l_node.oldLayers[l_edge].resize(l_node.neighborLevels[l_edge] > l_node.level ? 3*l_node.length(l_edge) : 0);
+        }
+      }
+    }
+
+    /**
+     * Flags the leaves, refines and coarsens them and connects the new leaves.
+     *
+     * @param i_initial refine the initial grid: the new leaves are initialized with the
+     *  scenario, no leaves are coarsened.
+     */
+    void adapt(bool i_initial) {
+      const int l_numberOfLeaves = leaves.size();
+      Node** l_leaves = &leaves[0];
+
+      // ghost layers of the current time for the refinement criterion
+      #pragma omp parallel for schedule(dynamic) if(l_numberOfLeaves > 1)
+      for (int l_leaf = 0; l_leaf < l_numberOfLeaves; l_leaf++) {
+        setGhostLayers(*l_leaves[l_leaf], 1.f);
+        l_leaves[l_leaf]->block->setGhostLayer();
+      }
+
+      #pragma omp parallel for schedule(dynamic) if(l_numberOfLeaves > 1)
+      for (int l_leaf = 0; l_leaf < l_numberOfLeaves; l_leaf++) {
+        const float l_indicator = computeRefinementIndicator(*l_leaves[l_leaf]);
+        l_leaves[l_leaf]->flagged = l_indicator > refineThreshold;
+        l_leaves[l_leaf]->coarsenable = l_indicator <= .5f*refineThreshold;
+        l_leaves[l_leaf]->refine = false;
+      }
+
+      // buffer around the flagged leaves
+      std::vector<Node*> l_buffer;
+      for (int l_leaf = 0; l_leaf < l_numberOfLeaves; l_leaf++)
+        if (l_leaves[l_leaf]->flagged)
+          for (int l_edge = 0; l_edge < 4; l_edge++)
+            getNeighbors(*l_leaves[l_leaf], l_edge, l_buffer);
+
+      for (size_t l_leaf = 0; l_leaf < l_buffer.size(); l_leaf++)
+        l_buffer[l_leaf]->flagged = true;
+
+      // refine the flagged leaves and their coarser neighbors (2:1 balance)
+      std::vector<Node*> l_refine;
+      for (int l_leaf = 0; l_leaf < l_numberOfLeaves; l_leaf++)
+        if (l_leaves[l_leaf]->flagged && l_leaves[l_leaf]->level < maxLevel) {
+          l_leaves[l_leaf]->refine = true;
+          l_refine.push_back(l_leaves[l_leaf]);
+        }
+
+      std::vector<Node*> l_neighbors;
+      for (size_t l_leaf = 0; l_leaf < l_refine.size(); l_leaf++)
+        for (int l_edge = 0; l_edge < 4; l_edge++) {
+          l_neighbors.clear();
+          getNeighbors(*l_refine[l_leaf], l_edge, l_neighbors);
+
+          for (size_t l_neighbor = 0; l_neighbor < l_neighbors.size(); l_neighbor++)
+            if (l_neighbors[l_neighbor]->level < l_refine[l_leaf]->level && !l_neighbors[l_neighbor]->refine) {
+              l_neighbors[l_neighbor]->refine = true;
+              l_refine.push_back(l_neighbors[l_neighbor]);
+            }
+        }
+
+      const int l_numberOfRefinements = l_refine.size();
+      #pragma omp parallel for schedule(dynamic)
+      for (int l_leaf = 0; l_leaf < l_numberOfRefinements; l_leaf++)
+        refine(*l_refine[l_leaf], i_initial);
+
+      // coarsen four unflagged siblings if their neighbors are at most one level finer afterwards
+      std::vector<Node*> l_parents;
+      for (int l_leaf = 0; l_leaf < l_numberOfLeaves && !i_initial; l_leaf++) {
+        Node* l_parent = l_leaves[l_leaf]->parent;
+        if (l_parent == 0 || l_parent->children[0] != l_leaves[l_leaf])
+          continue;
+
+        bool l_coarsen = true;
+        for (int l_child = 0; l_child < 4 && l_coarsen; l_child++) {
+          const Node &l_node = *l_parent->children[l_child];
+          l_coarsen = l_node.block != 0 && l_node.coarsenable && !l_node.flagged;
+
+          for (int l_edge = 0; l_edge < 4 && l_coarsen; l_edge++) {
+            l_neighbors.clear();
+            getNeighbors(l_node, l_edge, l_neighbors);
+            for (size_t l_neighbor = 0; l_neighbor < l_neighbors.size(); l_neighbor++)
+              l_coarsen = l_coarsen && l_neighbors[l_neighbor]->level <= l_node.level;
+          }
+        }
+
+        if (l_coarsen)
+          l_parents.push_back(l_parent);
+      }
+
+      const int l_numberOfCoarsenings = l_parents.size();
+      #pragma omp parallel for schedule(dynamic)
+      for (int l_node = 0; l_node < l_numberOfCoarsenings; l_node++)
+        coarsen(*l_parents[l_node]);
+
+      connect();
+    }
+
+  public:
+    /**
+     * Allocates the root blocks and refines them for the initial condition of the scenario.
+     *
+     * @param i_nx number of cells of level 0 in x-direction.
+     * @param i_ny number of cells of level 0 in y-direction.
+     * @param i_dx cell size of level 0 in x-direction.
+     * @param i_dy cell size of level 0 in y-direction.
+     * @param i_originX x-coordinate of the lower left corner.
+     * @param i_originY y-coordinate of the lower left corner.
+     * @param i_scenario the scenario.
+     * @param i_blockSize number of cells of a block in each direction.
+     * @param i_maxLevel maximum refinement level (0: no refinement).
+     * @param i_refineThreshold maximum difference of the water surface of neighboring cells without refinement.
+     * @param i_timestepFactor safety factor of the time step.
+     */
+    SWE_AdaptiveBlockGrid( int i_nx, int i_ny,
+                           float i_dx, float i_dy,
+                           float i_originX, float i_originY,
+                           SWE_Scenario &i_scenario,
+                           int i_blockSize,
+                           int i_maxLevel,
+                           float i_refineThreshold,
+                           float i_timestepFactor = .75f ):
+      nx(i_nx), ny(i_ny),
+      dx(i_dx), dy(i_dy),
+      originX(i_originX), originY(i_originY),
+      maxLevel(i_maxLevel),
+      refineThreshold(i_refineThreshold),
+      timestepFactor(i_timestepFactor),
+      dryTol(.1f),
+      scenario(i_scenario),
+      maxTimestep(std::numeric_limits<float>::max()) {
+      assert(i_blockSize >= 2);
+
+      cutsX = tools::Decomposition::tileCuts(tools::Decomposition::uniformCuts(nx, 1), i_blockSize);
+      cutsY = tools::Decomposition::tileCuts(tools::Decomposition::uniformCuts(ny, 1), i_blockSize);
+
+      for (size_t i = 0; i+1 < cutsX.size(); i++)
+        for (size_t j = 0; j+1 < cutsY.size(); j++)
+          roots.push_back( new Node(0, cutsX[i], cutsY[j], cutsX[i+1]-cutsX[i], cutsY[j+1]-cutsY[j], 0) );
+
+      const int l_numberOfRoots = roots.size();
+      #pragma omp parallel for schedule(dynamic)
+      for (int l_root = 0; l_root < l_numberOfRoots; l_root++)
+        createBlock(*roots[l_root], true);
+
+      connect();
+
+      for (int l_level = 0; l_level < maxLevel; l_level++)
+        adapt(true);
+    }
+
+    ~SWE_AdaptiveBlockGrid() {
+      for (size_t l_layer = 0; l_layer < copyLayers.size(); l_layer++)
+        delete copyLayers[l_layer];
+      for (size_t l_root = 0; l_root < roots.size(); l_root++)
+        delete roots[l_root];
+    }
+
+    /**
+     * Computes the time step width of level 0: the cell-based time step of all leaves
+     * (see SWE_Block::computeMaxTimestep()) scaled to level 0, with the safety factor.
+     *
+     * @return the time step width (see getMaxTimestep())
+     */
+    float computeMaxTimestep() {
+      const int l_numberOfLeaves = leaves.size();
+      Node** l_leaves = &leaves[0];
+
+      #pragma omp parallel for schedule(dynamic) if(l_numberOfLeaves > 1)
+      for (int l_leaf = 0; l_leaf < l_numberOfLeaves; l_leaf++)
+        l_leaves[l_leaf]->block->computeMaxTimestep();
+
+      maxTimestep = std::numeric_limits<float>::max();
+      for (int l_leaf = 0; l_leaf < l_numberOfLeaves; l_leaf++)
+        maxTimestep = std::min( maxTimestep, l_leaves[l_leaf]->block->getMaxTimestep() * (1 << l_leaves[l_leaf]->level) );
+      maxTimestep *= timestepFactor;
+
+      return maxTimestep;
+    }
+
+    /**
+     * @return time step width of level 0 (after computeMaxTimestep())
+     */
+    float getMaxTimestep() const {
+      return maxTimestep;
+    }
+
+    /**
+     * Executes a time step of level 0 with all sub-cycles of the finer levels.
+     *
+     * @param i_dt time step width of level 0 (at most getMaxTimestep()).
+     */
+    void simulateTimestep(float i_dt) {
+      advance(0, i_dt, 0.f);
+    }
+
+    /**
+     * Refines and coarsens the leaves according to the current water surface.
+     */
+    void regrid() {
+      adapt(false);
+    }
+
+    //! @return number of leaves
+    int getNumberOfLeaves() const { return leaves.size(); }
+
+    //! @return the block of a leaf (ordered by level)
+    Block* getLeaf(int i_leaf) const { return leaves[i_leaf]->block; }
+
+    //! @return refinement level of a leaf
+    int getLeafLevel(int i_leaf) const { return leaves[i_leaf]->level; }
+
+    //! @return first cell of a leaf in x-direction, at the resolution of its level
+    int getLeafOffsetX(int i_leaf) const { return leaves[i_leaf]->offsetX; }
+    //! @return first cell of a leaf in y-direction, at the resolution of its level
+    int getLeafOffsetY(int i_leaf) const { return leaves[i_leaf]->offsetY; }
+
+    //! @return number of levels with leaves
+    int getNumberOfLevels() const { return levels.size(); }
+
+    /**
+     * @return number of cells in the leaves of a level
+     */
+    long getNumberOfCells(int i_level) const {
+      long l_cells = 0;
+      for (size_t l_leaf = 0; l_leaf < levels[i_level].size(); l_leaf++)
+        l_cells += (long) levels[i_level][l_leaf]->nx * levels[i_level][l_leaf]->ny;
+
+      return l_cells;
+    }
+};
+
+#endif // SWE_ADAPTIVEBLOCKGRID_HH_
@@ -36,6 +36,9 @@
 
 // gravitational acceleration
 const float SWE_Block::g = 9.81f;
+const float SWE_Block::dryTol = 0.1f;
+const float SWE_Block::cflNumber = 0.4f;
+const float SWE_Block::restDryTol = 0.01f;
 
 /**
  * Constructor: allocate variables for simulation
@@ -277,6 +280,22 @@ void SWE_Block::setBathymetry(float (*_b)(float, float)) {
   b[i_x + 1][i_y + 1] = i_b;
  }
 
+ /**
+  Sets the water height and the momentum at one single cell
+
+  Assumption: User has no knowledge of ghost layer (see setBathymetry(int, int, float)).
+  @param i_x x-coordinate of the cell
+  @param i_y y-coordinate of the cell
+  @param i_h new water height
+  @param i_hu new momentum in x-direction
+  @param i_hv new momentum in y-direction
+  */
+ void SWE_Block::setUnknowns(int i_x, int i_y, float i_h, float i_hu, float i_hv) {
+  h[i_x + 1][i_y + 1] = i_h;
+  hu[i_x + 1][i_y + 1] = i_hu;
+  hv[i_x + 1][i_y + 1] = i_hv;
+ }
+
 /**
  * return reference to water height unknown h
  */
@@ -327,6 +346,55 @@ SWE_Block::simulateTimestep (float dt)
 	updateUnknowns (dt);
 }
 
+/**
+ * Computes the numerical fluxes on a sub-range of the edges.
+ *
+ * Vertical edges are selected by their x-index i (edge i lies between the
+ * cells i-1 and i), horizontal edges by their y-index j; each selected edge
+ * is computed along the whole extent of the block. Hence
+ *  * (1, nx+2, 1, ny+2) are all edges,
+ *  * (2, nx+1, 2, ny+1) are the edges which do not access the ghost layers.
+ *
+ * Blocks which support sub-ranges accumulate the fluxes and #maxTimestep
+ * of all calls until the next call of updateUnknowns().
+ * The default implementation supports the full range only.
+ *
+ * @param i_xStart first vertical edge.
+ * @param i_xEnd vertical edge after the last one.
+ * @param i_yStart first horizontal edge.
+ * @param i_yEnd horizontal edge after the last one.
+ */
+void
+SWE_Block::computeNumericalFluxes (int i_xStart, int i_xEnd, int i_yStart, int i_yEnd)
+{
+	assert(i_xStart == 1 && i_xEnd == nx+2 && i_yStart == 1 && i_yEnd == ny+2);
+	computeNumericalFluxes ();
+}
+
+/**
+ * Returns the numerical fluxes through the edges at a boundary of the block,
+ * e.g. to correct the fluxes between blocks of different resolutions or time
+ * steps. Has to be called after computeNumericalFluxes() and before
+ * updateUnknowns().
+ *
+ * The fluxes point in positive x- (y-)direction. As the net updates include
+ * the bathymetry source terms, the momentum flux depends on the side of the
+ * edge where it is evaluated: with the state of the ghost cell or of the
+ * inner cell. Only the momentum normal to the edge has a flux.
+ * The default implementation is not supported.
+ *
+ * @param i_edge boundary of the block.
+ * @param i_ghostSide evaluate the fluxes on the side of the ghost cells (instead of the inner cells).
+ * @param o_hFlux flux of the water height for each edge (ny or nx values).
+ * @param o_momentumFlux flux of the normal momentum for each edge.
+ */
+void
+SWE_Block::getBoundaryFluxes (BoundaryEdge i_edge, bool i_ghostSide,
+                              float* o_hFlux, float* o_momentumFlux)
+{
+	assert(false);
+}
+
 /**
  * simulate implements the main simulation loop between two checkpoints;
  * Note: this implementation can only be used, if you only use a single SWE_Block
@@ -459,6 +527,30 @@ SWE_Block1D* SWE_Block::grabGhostLayer(BoundaryEdge edge){
   return NULL;
 }
 
+/**
+ * return the row or column layer at the given distance from a boundary,
+ * e.g. to exchange more than one layer with a neighbour (deep halos):
+ * distance 0 is the ghost layer, distance 1 the copy layer, etc.
+ * In contrast to grabGhostLayer, the boundary conditions are not changed.
+ * @param	edge	specified edge
+ * @param	distance	number of layers between the ghost layer and the requested layer
+ * @return	a SWE_Block1D object that contains row variables h, hu, and hv
+ */
+SWE_Block1D* SWE_Block::getLayer(BoundaryEdge edge, int distance){
+
+  switch (edge) {
+    case BND_LEFT:
+      return new SWE_Block1D( h.getColProxy(distance), hu.getColProxy(distance), hv.getColProxy(distance) );
+    case BND_RIGHT:
+      return new SWE_Block1D( h.getColProxy(nx+1-distance), hu.getColProxy(nx+1-distance), hv.getColProxy(nx+1-distance) );
+    case BND_BOTTOM:
+      return new SWE_Block1D( h.getRowProxy(distance), hu.getRowProxy(distance), hv.getRowProxy(distance));
+    case BND_TOP:
+      return new SWE_Block1D( h.getRowProxy(ny+1-distance), hu.getRowProxy(ny+1-distance), hv.getRowProxy(ny+1-distance));
+  };
+  return NULL;
+}
+
 
 /**
  * set the values of all ghost cells depending on the specifed 
@@ -568,6 +660,34 @@ void SWE_Block::computeMaxTimestep( const float i_dryTol,
   maxTimestep *= i_cflNumber;
 }
 
+/**
+ * Compute the largest particle velocity max(|u|,|v|) and the largest celerity
+ * sqrt(g*h) of all wet (h > 0) cells of the block.
+ *
+ * The Roe velocity of an edge is a weighted mean of the velocities of the two cells
+ * and the Roe celerity sqrt(g*(h_l+h_r)/2) does not exceed the celerity of the deeper
+ * cell. The sum of both bounds (maximized over all blocks) is therefore an upper bound
+ * of the wave speeds of all edges, including wet/dry and deep/shallow edges.
+ * In contrast, computeMaxTimestep() ignores cells with h <= i_dryTol.
+ *
+ * @param o_maxVelocity largest particle velocity.
+ * @param o_maxCelerity largest celerity.
+ */
+void SWE_Block::computeWaveSpeedBounds( float &o_maxVelocity, float &o_maxCelerity ) {
+  o_maxVelocity = 0.f;
+  o_maxCelerity = 0.f;
+
+  for(int i=1; i <= nx; i++) {
+    for(int j=1; j <= ny; j++) {
+      if( h[i][j] > 0.f ) {
+        o_maxVelocity = std::max( o_maxVelocity,
+                                  std::max( std::abs( hu[i][j] ), std::abs( hv[i][j] ) ) / h[i][j] );
+        o_maxCelerity = std::max( o_maxCelerity, std::sqrt( g * h[i][j] ) );
+      }
+    }
+  }
+}
+
 
 //==================================================================
 // protected member functions for simulation
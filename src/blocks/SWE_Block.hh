@@ -35,6 +35,8 @@
 #include "scenarios/SWE_SeismologyScenario.hh"
 #endif
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 
@@ -132,7 +134,9 @@ class SWE_Block {
     /// set the whole bathymetry matrix
     void setBathymetry(float *_b);
     /// set one single cell's bathymetry value
-    void setBathymetry(int i_x, int i_y, float i_b);
+    virtual void setBathymetry(int i_x, int i_y, float i_b);
+    /// set one single cell's water height and momentum (e.g. read from a checkpoint)
+    void setUnknowns(int i_x, int i_y, float i_h, float i_hu, float i_hv);
 
 #ifdef WRITENETCDF
     float updateBathymetry(float i_time, SWE_SeismologyScenario *i_scenario);
@@ -158,6 +162,8 @@ class SWE_Block {
     virtual SWE_Block1D* registerCopyLayer(BoundaryEdge edge);
     /// "grab" the ghost layer in order to set these values externally
     virtual SWE_Block1D* grabGhostLayer(BoundaryEdge edge);
+    /// return a pointer to proxy class to access a layer at some distance from a boundary
+    SWE_Block1D* getLayer(BoundaryEdge edge, int distance);
     
     /// set values in ghost layers
     void setGhostLayer();
@@ -169,7 +175,10 @@ class SWE_Block {
     float getMaxTimestep() { return maxTimestep; };
   
     // compute the largest allowed time step for the current grid block
-    void computeMaxTimestep( const float i_dryTol = 0.1, const float i_cflNumber = 0.4 );
+    void computeMaxTimestep( const float i_dryTol = dryTol, const float i_cflNumber = cflNumber );
+
+    // compute upper bounds of the velocities and celerities of all wet cells
+    void computeWaveSpeedBounds( float &o_maxVelocity, float &o_maxCelerity );
 
     /// execute a single time step (with fixed time step size) of the simulation
     virtual void simulateTimestep(float dt);
@@ -185,6 +194,14 @@ class SWE_Block {
      * in the respective derived classes.
      */
     virtual void computeNumericalFluxes() = 0;
+
+    /// compute the numerical fluxes for a sub-range of the edges
+    virtual void computeNumericalFluxes( int i_xStart, int i_xEnd,
+                                         int i_yStart, int i_yEnd );
+
+    /// return the numerical fluxes through the edges at a boundary (after computeNumericalFluxes)
+    virtual void getBoundaryFluxes( BoundaryEdge i_edge, bool i_ghostSide,
+                                    float* o_hFlux, float* o_momentumFlux );
     
     /// compute the new values of the unknowns h, hu, and hv in all grid cells
     /**
@@ -214,6 +231,12 @@ class SWE_Block {
   // Konstanten:
     /// static variable that holds the gravity constant (g = 9.81 m/s^2):
     static const float g;
+    /// default dry tolerance of the time step computation (dry cells do not affect the time step)
+    static const float dryTol;
+    /// default CFL number of the time step computation
+    static const float cflNumber;
+    /// dry tolerance of the f-wave solvers: thinner water layers do not move (see isLakeAtRest())
+    static const float restDryTol;
 	
   protected:
     // Constructor und Destructor
@@ -224,6 +247,39 @@ class SWE_Block {
     // Sets the bathymetry on outflow and wall boundaries
     void setBoundaryBathymetry();
 
+    /**
+     * Checks a run of edges for the lake at rest: both cells wet, no momentum and the
+     * same water surface. The f-wave solvers compute zero net updates for these edges,
+     * their wave speeds are +-sqrt(g * (h_l+h_r)/2). The loop has no branches, i.e.
+     * it is vectorized by the compiler.
+     *
+     * @param i_hLeft water heights left of (below) the edges.
+     * @param i_hRight water heights right of (above) the edges.
+     * @param i_huLeft normal momentum left of (below) the edges.
+     * @param i_huRight normal momentum right of (above) the edges.
+     * @param i_bLeft bathymetry left of (below) the edges.
+     * @param i_bRight bathymetry right of (above) the edges.
+     * @param i_n number of edges.
+     * @param o_maxWaveSpeed maximum wave speed of the edges (if at rest).
+     * @return true if all edges are at rest.
+     */
+    static bool isLakeAtRest( const float* i_hLeft, const float* i_hRight,
+                              const float* i_huLeft, const float* i_huRight,
+                              const float* i_bLeft, const float* i_bRight,
+                              int i_n, float &o_maxWaveSpeed ) {
+      int l_moving = 0;
+      float l_maxDepth = 0.f;
+      for (int k = 0; k < i_n; k++) {
+        l_moving |= (i_hLeft[k] <= restDryTol) | (i_hRight[k] <= restDryTol)
+                  | (i_huLeft[k] != 0.f) | (i_huRight[k] != 0.f)
+                  | (i_hLeft[k] + i_bLeft[k] != i_hRight[k] + i_bRight[k]);
+        l_maxDepth = std::max(l_maxDepth, i_hLeft[k] + i_hRight[k]);
+      }
+
+      o_maxWaveSpeed = std::sqrt(g * .5f * l_maxDepth);
+      return l_moving == 0;
+    }
+
     // synchronization Methods
     virtual void synchAfterWrite();
     virtual void synchWaterHeightAfterWrite();
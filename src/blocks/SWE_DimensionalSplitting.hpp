@@ -34,6 +34,7 @@
 #include "solvers/FWave.hpp"
 #include "tools/help.hh"
 #include <iostream>
+#include <limits>
 #include <omp.h>
 
 #ifndef NDEBUG
@@ -65,6 +66,9 @@ private :
 	//! Net updates for momentum above
 	Float2D hvNetUpdatesAbove;
 
+	//! Upper bound for the time step computed in computeNumericalFluxes
+	float timestepLimit;
+
 	/**
 	* Sets all entries of an array to zero
 	* @param array: the array itself
@@ -98,7 +102,8 @@ public :
 		hNetUpdatesBelow (l_nx, l_ny + 1),
 		hNetUpdatesAbove (l_nx, l_ny + 1),
 		hvNetUpdatesBelow (l_nx, l_ny + 1),
-		hvNetUpdatesAbove (l_nx, l_ny + 1)
+		hvNetUpdatesAbove (l_nx, l_ny + 1),
+		timestepLimit (std::numeric_limits<float>::max())
 {
 	assert(l_nx > 0);
 	assert(l_ny > 0);
@@ -106,6 +111,17 @@ public :
 	assert(l_dy > 0);
 }
 	
+	/**
+	* Limits the time step used by the next calls of computeNumericalFluxes,
+	* e.g. to hit an output time exactly.
+	*
+	* @param i_limit upper bound for the time step
+	*/
+	void setTimestepLimit(float i_limit)
+	{
+		timestepLimit = i_limit;
+	}
+
 	/**
 	* computing the net updates AND applying them already
 	*/
@@ -130,7 +146,11 @@ public :
 			for(unsigned int x = 0; x < nx+1; x++) 
 			{			
 				float maxEdgeSpeed;
-				solver_t.computeNetUpdates(h[x][y+1], h[x+1][y+1], hu[x][y+1], hu[x+1][y+1], b[x][y+1], b[x+1][y+1],
+				// lake at rest: zero net updates without calling the solver
+				if(isLakeAtRest(&h[x][y+1], &h[x+1][y+1], &hu[x][y+1], &hu[x+1][y+1], &b[x][y+1], &b[x+1][y+1], 1, maxEdgeSpeed))
+					hNetUpdatesLeft[x][y] = hNetUpdatesRight[x][y] = huNetUpdatesLeft[x][y] = huNetUpdatesRight[x][y] = 0.f;
+				else
+					solver_t.computeNetUpdates(h[x][y+1], h[x+1][y+1], hu[x][y+1], hu[x+1][y+1], b[x][y+1], b[x+1][y+1],
 								hNetUpdatesLeft[x][y], hNetUpdatesRight[x][y],
 								huNetUpdatesLeft[x][y], huNetUpdatesRight[x][y],
 								maxEdgeSpeed
@@ -161,6 +181,7 @@ public :
 		
 		// approximate timestep by slow down maxTimestep 
 		maxTimestep = 0.4 * dx / maxTimestep;
+		maxTimestep = std::min(maxTimestep, timestepLimit);
 #ifndef NDEBUG
 		cout << "MaxTimestep: " << maxTimestep << endl;
 #endif
@@ -191,7 +212,11 @@ public :
 			for(unsigned int x = 0; x < nx; x++) 
 			{
 				float maxEdgeSpeed;
-				solver_t.computeNetUpdates(h[x+1][y],h[x+1][y+1], hv[x+1][y], hv[x+1][y+1], b[x+1][y], b[x+1][y+1],
+				// lake at rest: zero net updates without calling the solver
+				if(isLakeAtRest(&h[x+1][y], &h[x+1][y+1], &hv[x+1][y], &hv[x+1][y+1], &b[x+1][y], &b[x+1][y+1], 1, maxEdgeSpeed))
+					hNetUpdatesBelow[x][y] = hNetUpdatesAbove[x][y] = hvNetUpdatesBelow[x][y] = hvNetUpdatesAbove[x][y] = 0.f;
+				else
+					solver_t.computeNetUpdates(h[x+1][y],h[x+1][y+1], hv[x+1][y], hv[x+1][y+1], b[x+1][y], b[x+1][y+1],
 								hNetUpdatesBelow[x][y], hNetUpdatesAbove[x][y],
 								hvNetUpdatesBelow[x][y], hvNetUpdatesAbove[x][y],
 								maxEdgeSpeed
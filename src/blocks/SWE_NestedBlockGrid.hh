@@ -0,0 +1,387 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Static nested grids with two-way coupling.
+ */
+
+#ifndef SWE_NESTEDBLOCKGRID_HH_
+#define SWE_NESTEDBLOCKGRID_HH_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "blocks/SWE_Block.hh"
+#include "scenarios/SWE_Scenario.hh"
+
+/**
+ * A block for the whole domain with nested blocks of finer resolution (e.g. a
+ * harbour grid in an ocean grid), which can contain nested blocks themselves.
+ *
+ * A nest covers a rectangle of cells of its parent with at least one cell
+ * distance to the boundary of the parent, each parent cell is divided into
+ * ratio x ratio cells. Nests of the same parent must not overlap.
+ *
+ * Coupling: the parent is advanced first. Its cells next to a nest at the
+ * beginning and at the end of its time step are interpolated linearly in time
+ * and prolongated into the ghost layers of the nest: the water surface of the
+ * parent cell (or dry, if it is below the bathymetry of the nest cell) with
+ * its velocity. The nest sub-cycles with the time step width of its own CFL
+ * condition (from its numerical fluxes, incl. the edges to the ghost layers)
+ * until it reaches the time of the parent. Afterwards the covered cells of the
+ * parent get the averages of the nest cells.
+ *
+ * The bathymetry of the covered parent cells is the average of the nest, such
+ * that a lake at rest stays at rest. The fluxes through the boundary of a nest
+ * are not corrected, i.e. the mass is conserved up to the differences of the
+ * fluxes of parent and nest at the boundary.
+ *
+ * @tparam Block the block type (requires a constructor (nx, ny, dx, dy)).
+ */
+template <class Block>
+class SWE_NestedBlockGrid {
+  private:
+    /**
+     * A block with its position in the parent.
+     */
+    struct Nest {
+      //! the block
+      Block* block;
+
+      //! index of the parent, -1 for the block of the whole domain
+      int parent;
+
+      //! first covered cell of the parent in x- and y-direction
+      int offsetX, offsetY;
+
+      //! number of covered cells of the parent
+      int nx, ny;
+
+      //! number of cells per parent cell in each direction
+      int ratio;
+
+      //! first cell in x- and y-direction at the resolution of the nest (relative to the domain)
+      int cellOffsetX, cellOffsetY;
+
+      //! proxies of the ghost layers (set from the parent)
+      SWE_Block1D* ghostLayers[4];
+
+      //! parent cells next to each edge (h, hu, hv) at the beginning of the time step of the parent
+      std::vector<float> parentLayers[4];
+
+      //! indices of the nests in this block
+      std::vector<int> children;
+    };
+
+    //! the block of the whole domain (index 0) and the nests (parents before their children)
+    std::vector<Nest> nests;
+
+    //! the scenario, provides the initial values of new nests
+    SWE_Scenario &scenario;
+
+    // no copies, the grid owns the blocks
+    SWE_NestedBlockGrid(const SWE_NestedBlockGrid&);
+    SWE_NestedBlockGrid& operator=(const SWE_NestedBlockGrid&);
+
+    /**
+     * Sets the covered cells of the parent to the averages of the nest cells.
+     *
+     * @param i_bathymetry average the bathymetry as well (new nests).
+     */
+    void restrictNest(int i_nest, bool i_bathymetry) {
+      const Nest &l_nest = nests[i_nest];
+      Block &l_parent = *nests[l_nest.parent].block;
+
+      const Float2D &l_h = l_nest.block->getWaterHeight();
+      const Float2D &l_hu = l_nest.block->getDischarge_hu();
+      const Float2D &l_hv = l_nest.block->getDischarge_hv();
+      const Float2D &l_b = l_nest.block->getBathymetry();
+      const float l_scale = 1.f / (l_nest.ratio * l_nest.ratio);
+
+      #pragma omp parallel for
+      for (int i = 0; i < l_nest.nx; i++)
+        for (int j = 0; j < l_nest.ny; j++) {
+          float l_sumH = 0.f, l_sumHu = 0.f, l_sumHv = 0.f, l_sumB = 0.f;
+          for (int k = i*l_nest.ratio + 1; k <= (i+1)*l_nest.ratio; k++)
+            for (int l = j*l_nest.ratio + 1; l <= (j+1)*l_nest.ratio; l++) {
+              l_sumH += l_h[k][l];
+              l_sumHu += l_hu[k][l];
+              l_sumHv += l_hv[k][l];
+              l_sumB += l_b[k][l];
+            }
+
+          if (i_bathymetry)
+            l_parent.setBathymetry(l_nest.offsetX + i, l_nest.offsetY + j, l_sumB * l_scale);
+          l_parent.setUnknowns( l_nest.offsetX + i, l_nest.offsetY + j,
+                                l_sumH * l_scale, l_sumHu * l_scale, l_sumHv * l_scale );
+        }
+    }
+
+    /**
+     * Stores the parent cells next to the edges of a nest.
+     */
+    void storeParentLayers(Nest &io_nest) {
+      Block &l_parent = *nests[io_nest.parent].block;
+      const Float2D &l_h = l_parent.getWaterHeight();
+      const Float2D &l_hu = l_parent.getDischarge_hu();
+      const Float2D &l_hv = l_parent.getDischarge_hv();
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        const bool l_vertical = (l_edge == BND_LEFT || l_edge == BND_RIGHT);
+
+        for (int k = 0; k < (l_vertical ? io_nest.ny : io_nest.nx); k++) {
+          // the parent cell (incl. ghost layer)
+          const int i = (l_edge == BND_LEFT) ? io_nest.offsetX : (l_edge == BND_RIGHT) ? io_nest.offsetX + io_nest.nx + 1
+                      : io_nest.offsetX + k + 1;
+          const int j = (l_edge == BND_BOTTOM) ? io_nest.offsetY : (l_edge == BND_TOP) ? io_nest.offsetY + io_nest.ny + 1
+                      : io_nest.offsetY + k + 1;
+
+          io_nest.parentLayers[l_edge][3*k] = l_h[i][j];
+          io_nest.parentLayers[l_edge][3*k+1] = l_hu[i][j];
+          io_nest.parentLayers[l_edge][3*k+2] = l_hv[i][j];
+        }
+      }
+    }
+
+    /**
+     * Sets the ghost layers of a nest from the parent.
+     *
+     * @param i_alpha time within the time step of the parent, between its beginning (0) and its end (1).
+     */
+    void setGhostLayers(Nest &io_nest, float i_alpha) {
+      Block &l_parent = *nests[io_nest.parent].block;
+      const Float2D &l_h = l_parent.getWaterHeight();
+      const Float2D &l_hu = l_parent.getDischarge_hu();
+      const Float2D &l_hv = l_parent.getDischarge_hv();
+      const Float2D &l_parentB = l_parent.getBathymetry();
+      const Float2D &l_b = io_nest.block->getBathymetry();
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        const bool l_vertical = (l_edge == BND_LEFT || l_edge == BND_RIGHT);
+        SWE_Block1D &l_ghostLayer = *io_nest.ghostLayers[l_edge];
+
+        for (int k = 0; k < (l_vertical ? io_nest.ny : io_nest.nx) * io_nest.ratio; k++) {
+          // ghost cell of the nest and parent cell (incl. ghost layers)
+          const int l_parentCell = k / io_nest.ratio;
+          const int i = (l_edge == BND_LEFT) ? 0 : (l_edge == BND_RIGHT) ? io_nest.nx*io_nest.ratio + 1 : k+1;
+          const int j = (l_edge == BND_BOTTOM) ? 0 : (l_edge == BND_TOP) ? io_nest.ny*io_nest.ratio + 1 : k+1;
+          const int l_i = (l_edge == BND_LEFT) ? io_nest.offsetX : (l_edge == BND_RIGHT) ? io_nest.offsetX + io_nest.nx + 1
+                        : io_nest.offsetX + l_parentCell + 1;
+          const int l_j = (l_edge == BND_BOTTOM) ? io_nest.offsetY : (l_edge == BND_TOP) ? io_nest.offsetY + io_nest.ny + 1
+                        : io_nest.offsetY + l_parentCell + 1;
+
+          const float* l_old = &io_nest.parentLayers[l_edge][3*l_parentCell];
+          const float l_height = l_old[0] + i_alpha * (l_h[l_i][l_j] - l_old[0]);
+          const float l_surface = l_height + l_parentB[l_i][l_j];
+          const float l_nestH = (l_height > 0.f) ? std::max(l_surface - l_b[i][j], 0.f) : 0.f;
+          const float l_velocityScale = (l_height > 0.f) ? l_nestH / l_height : 0.f;
+
+          l_ghostLayer.h[k+1] = l_nestH;
+          l_ghostLayer.hu[k+1] = (l_old[1] + i_alpha * (l_hu[l_i][l_j] - l_old[1])) * l_velocityScale;
+          l_ghostLayer.hv[k+1] = (l_old[2] + i_alpha * (l_hv[l_i][l_j] - l_old[2])) * l_velocityScale;
+        }
+      }
+    }
+
+    /**
+     * Executes a time step of a block, followed by the sub-cycles of its nests.
+     * The ghost layers and the numerical fluxes of the block have to be computed.
+     */
+    void advance(int i_nest, float i_dt) {
+      Nest &l_nest = nests[i_nest];
+
+      for (size_t l_child = 0; l_child < l_nest.children.size(); l_child++)
+        storeParentLayers(nests[l_nest.children[l_child]]);
+
+      l_nest.block->updateUnknowns(i_dt);
+
+      for (size_t l_child = 0; l_child < l_nest.children.size(); l_child++) {
+        const int l_index = l_nest.children[l_child];
+        Block &l_block = *nests[l_index].block;
+
+        // sub-cycles with the time step width of the nest, the last one reaches the time of the parent
+        float l_time = 0.f;
+        for (bool l_last = false; !l_last; ) {
+          setGhostLayers(nests[l_index], l_time / i_dt);
+          l_block.setGhostLayer();
+          l_block.computeNumericalFluxes();
+
+          const float l_remaining = i_dt - l_time;
+          const int l_steps = std::max( 1, (int) std::ceil(l_remaining / l_block.getMaxTimestep()) );
+          const float l_dt = l_remaining / l_steps;
+          l_last = (l_steps == 1);
+
+          advance(l_index, l_dt);
+          l_time += l_dt;
+        }
+
+        restrictNest(l_index, false);
+      }
+    }
+
+  public:
+    /**
+     * Allocates the block of the whole domain and initializes it with the scenario.
+     *
+     * @param i_nx number of cells in x-direction.
+     * @param i_ny number of cells in y-direction.
+     * @param i_dx cell size in x-direction.
+     * @param i_dy cell size in y-direction.
+     * @param i_originX x-coordinate of the lower left corner.
+     * @param i_originY y-coordinate of the lower left corner.
+     * @param i_scenario the scenario.
+     */
+    SWE_NestedBlockGrid( int i_nx, int i_ny,
+                         float i_dx, float i_dy,
+                         float i_originX, float i_originY,
+                         SWE_Scenario &i_scenario ):
+      nests(1),
+      scenario(i_scenario) {
+      Nest &l_root = nests[0];
+      l_root.block = new Block(i_nx, i_ny, i_dx, i_dy);
+      l_root.block->initScenario(i_originX, i_originY, scenario);
+      l_root.parent = -1;
+      l_root.offsetX = l_root.offsetY = 0;
+      l_root.nx = i_nx; l_root.ny = i_ny;
+      l_root.ratio = 1;
+      l_root.cellOffsetX = l_root.cellOffsetY = 0;
+      for (int l_edge = 0; l_edge < 4; l_edge++)
+        l_root.ghostLayers[l_edge] = 0;
+    }
+
+    ~SWE_NestedBlockGrid() {
+      for (size_t l_nest = 0; l_nest < nests.size(); l_nest++) {
+        for (int l_edge = 0; l_edge < 4; l_edge++)
+          delete nests[l_nest].ghostLayers[l_edge];
+        delete nests[l_nest].block;
+      }
+    }
+
+    /**
+     * Adds a nest before the first time step. The parent is the finest block which contains
+     * the rectangle, the rectangle is rounded to the cells of the parent.
+     * The nest is initialized with the scenario, the covered cells of the parent (and of its
+     * ancestors) get the averages of the nest.
+     *
+     * @param i_xMin left edge of the nest.
+     * @param i_xMax right edge of the nest.
+     * @param i_yMin bottom edge of the nest.
+     * @param i_yMax top edge of the nest.
+     * @param i_ratio number of cells per parent cell in each direction.
+     * @return index of the nest, -1 if the nest is not inside a block (with a distance of at least
+     *  one cell to its boundary), overlaps another nest or the ratio is less than 2.
+     */
+    int addNest(float i_xMin, float i_xMax, float i_yMin, float i_yMax, int i_ratio) {
+      if (i_ratio < 2)
+        return -1;
+
+      // nests are added after their parents, the last block which contains the rectangle is the finest one
+      int l_parent = -1;
+      for (size_t l_nest = 0; l_nest < nests.size(); l_nest++) {
+        Block &l_block = *nests[l_nest].block;
+        if ( i_xMin >= l_block.getOffx() && i_xMax <= l_block.getOffx() + l_block.getNx()*l_block.getDx() &&
+             i_yMin >= l_block.getOffy() && i_yMax <= l_block.getOffy() + l_block.getNy()*l_block.getDy() )
+          l_parent = l_nest;
+      }
+      if (l_parent < 0)
+        return -1;
+
+      Block &l_parentBlock = *nests[l_parent].block;
+      Nest l_nest;
+      l_nest.parent = l_parent;
+      l_nest.ratio = i_ratio;
+      l_nest.offsetX = (int) std::floor( (i_xMin - l_parentBlock.getOffx()) / l_parentBlock.getDx() + .5f );
+      l_nest.offsetY = (int) std::floor( (i_yMin - l_parentBlock.getOffy()) / l_parentBlock.getDy() + .5f );
+      l_nest.nx = (int) std::floor( (i_xMax - l_parentBlock.getOffx()) / l_parentBlock.getDx() + .5f ) - l_nest.offsetX;
+      l_nest.ny = (int) std::floor( (i_yMax - l_parentBlock.getOffy()) / l_parentBlock.getDy() + .5f ) - l_nest.offsetY;
+
+      if ( l_nest.nx < 1 || l_nest.ny < 1 || l_nest.offsetX < 1 || l_nest.offsetY < 1 ||
+           l_nest.offsetX + l_nest.nx >= l_parentBlock.getNx() || l_nest.offsetY + l_nest.ny >= l_parentBlock.getNy() )
+        return -1;
+
+      const std::vector<int> &l_siblings = nests[l_parent].children;
+      for (size_t l_sibling = 0; l_sibling < l_siblings.size(); l_sibling++) {
+        const Nest &l_other = nests[l_siblings[l_sibling]];
+        if ( l_nest.offsetX < l_other.offsetX + l_other.nx && l_other.offsetX < l_nest.offsetX + l_nest.nx &&
+             l_nest.offsetY < l_other.offsetY + l_other.ny && l_other.offsetY < l_nest.offsetY + l_nest.ny )
+          return -1;
+      }
+
+      l_nest.cellOffsetX = (nests[l_parent].cellOffsetX + l_nest.offsetX) * i_ratio;
+      l_nest.cellOffsetY = (nests[l_parent].cellOffsetY + l_nest.offsetY) * i_ratio;
+
+      const float l_dx = l_parentBlock.getDx() / i_ratio, l_dy = l_parentBlock.getDy() / i_ratio;
+      l_nest.block = new Block(l_nest.nx * i_ratio, l_nest.ny * i_ratio, l_dx, l_dy);
+      l_nest.block->initScenario( l_parentBlock.getOffx() + l_nest.offsetX * l_parentBlock.getDx(),
+                                  l_parentBlock.getOffy() + l_nest.offsetY * l_parentBlock.getDy(),
+                                  scenario, true );
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        l_nest.ghostLayers[l_edge] = l_nest.block->grabGhostLayer(BoundaryEdge(l_edge));
+        l_nest.parentLayers[l_edge].resize( 3 * ((l_edge == BND_LEFT || l_edge == BND_RIGHT) ? l_nest.ny : l_nest.nx) );
+      }
+
+      const int l_index = nests.size();
+      nests.push_back(l_nest);
+      nests[l_parent].children.push_back(l_index);
+
+      for (int l_child = l_index; nests[l_child].parent >= 0; l_child = nests[l_child].parent)
+        restrictNest(l_child, true);
+
+      return l_index;
+    }
+
+    /**
+     * Computes the numerical fluxes of the block of the whole domain and its time step
+     * width (the nests sub-cycle with their own time step width).
+     *
+     * @return the time step width.
+     */
+    float computeMaxTimestep() {
+      nests[0].block->setGhostLayer();
+      nests[0].block->computeNumericalFluxes();
+      return nests[0].block->getMaxTimestep();
+    }
+
+    /**
+     * Executes a time step of the block of the whole domain with the sub-cycles of all nests.
+     *
+     * @param i_dt time step width (at most computeMaxTimestep(), which has to be called before).
+     */
+    void simulateTimestep(float i_dt) {
+      advance(0, i_dt);
+    }
+
+    //! @return number of blocks, incl. the block of the whole domain (index 0)
+    int getNumberOfNests() const { return nests.size(); }
+
+    //! @return a block
+    Block* getNest(int i_nest) const { return nests[i_nest].block; }
+
+    //! @return first cell of a block in x-direction at its resolution
+    int getNestOffsetX(int i_nest) const { return nests[i_nest].cellOffsetX; }
+    //! @return first cell of a block in y-direction at its resolution
+    int getNestOffsetY(int i_nest) const { return nests[i_nest].cellOffsetY; }
+};
+
+#endif // SWE_NESTEDBLOCKGRID_HH_
@@ -0,0 +1,869 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Block-sparse grid: a rectangular domain tiled into SWE_Blocks, without the tiles on dry land.
+ */
+
+#ifndef SWE_SPARSEBLOCKGRID_HH_
+#define SWE_SPARSEBLOCKGRID_HH_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "blocks/SWE_Block.hh"
+#include "scenarios/SWE_Scenario.hh"
+#include "tools/Decomposition.hh"
+
+/**
+ * A rectangular grid of nx x ny cells, tiled into blocks of (at most)
+ * tileSize x tileSize cells.
+ *
+ * Tiles whose bathymetry is above the land elevation in all cells (and which
+ * are dry initially) are never allocated or computed. The edges between two
+ * allocated tiles are connected (CONNECT), the edges next to a land tile are
+ * reflecting (WALL). The outer edges of the grid get the boundary conditions
+ * of the scenario, which can be changed with setBoundaryType() or for single
+ * tiles, e.g. to exchange them with MPI neighbors.
+ *
+ * The tiles are indexed column-major, like the cells of a Float2D.
+ *
+ * With OpenMP, the tiles are processed in parallel (dynamic schedule). The
+ * loops of the blocks run in parallel only if there is a single tile.
+ *
+ * Local time stepping (see setLocalTimestepping()): each tile advances with
+ * 2^c times the smallest time step of all tiles, where the class c is the
+ * largest one allowed by the CFL condition of the tile (and at most one larger
+ * than the classes of its neighbors). The ghost cells next to a tile of a
+ * larger class are interpolated in time between the values before and after
+ * its time step. The tile of the larger class is corrected with the fluxes of
+ * the time steps of its neighbor afterwards, which conserves the mass.
+ *
+ * Active region tracking (see setActiveRegionTracking()): a tile is at rest if
+ * all of its cells are at rest, i.e. without momentum and either dry or with
+ * the water surface at the sea level. The fluxes of a tile are computed and
+ * its cells are updated only if the tile or one of its neighbors is not at
+ * rest. The well-balanced solvers compute zero net updates for the other tiles,
+ * and a disturbance travels at most one cell (i.e. into the neighbor) per time
+ * step, so skipping them does not change the solution. The active region grows
+ * by one tile per step. Dry land and the ocean which the wave has not reached
+ * yet are skipped.
+ *
+ * @tparam Block the block type of the tiles (requires a constructor (nx, ny, dx, dy)).
+ */
+template <class Block>
+class SWE_SparseBlockGrid {
+  private:
+    //! number of cells of the grid
+    int nx, ny;
+
+    //! cell size
+    float dx, dy;
+
+    //! lower left corner of the grid
+    float offsetX, offsetY;
+
+    //! first cell of each tile column (row), followed by the number of cells
+    std::vector<int> cutsX, cutsY;
+
+    //! the tiles, 0 for land tiles
+    std::vector<Block*> tiles;
+
+    //! proxies of the copy layers used by the connected edges
+    std::vector<SWE_Block1D*> copyLayers;
+
+    //! minimum of the maximum time steps of all tiles
+    float maxTimestep;
+
+    //! one element per tile, the addresses identify the tiles in the task dependencies
+    std::vector<char> taskDependencies;
+
+    //! largest time step class of local time stepping, 0: all tiles use the same time step
+    int maxTimestepClass;
+
+    //! time step class of each tile (local time stepping)
+    std::vector<int> timestepClasses;
+
+    //! largest time step class of all tiles (local time stepping)
+    int largestTimestepClass;
+
+    //! copy layers (h, hu, hv) at the beginning of the time step, for each edge of each tile (local time stepping)
+    std::vector< std::vector<float> > oldLayers;
+
+    //! time step width times flux (h, normal momentum) through each edge of each tile (local time stepping)
+    std::vector< std::vector<float> > fluxes;
+
+    //! skip the tiles at rest? (active region tracking)
+    bool trackActiveRegion;
+
+    //! water surface of the ocean at rest (active region tracking)
+    float seaLevel;
+
+    //! 1 for each tile which is not at rest (active region tracking)
+    std::vector<char> disturbedTiles;
+
+    //! 1 for each tile which is computed, i.e. it or a neighbor is not at rest
+    std::vector<char> activeTiles;
+
+    //! 1 for each tile with ghost layers set outside the grid (e.g. MPI), always computed
+    std::vector<char> exchangedTiles;
+
+    // no copies, the grid owns the tiles
+    SWE_SparseBlockGrid(const SWE_SparseBlockGrid&);
+    SWE_SparseBlockGrid& operator=(const SWE_SparseBlockGrid&);
+
+    /**
+     * @return true if the bathymetry of all cells of the tile is above the elevation
+     *  and all cells are dry
+     */
+    bool isLand(SWE_Scenario &i_scenario, int i, int j, float i_landElevation) const {
+      for (int l_x = cutsX[i]; l_x < cutsX[i+1]; l_x++)
+        for (int l_y = cutsY[j]; l_y < cutsY[j+1]; l_y++) {
+          const float x = offsetX + (l_x+.5f)*dx;
+          const float y = offsetY + (l_y+.5f)*dy;
+
+          if (i_scenario.getBathymetry(x, y) <= i_landElevation || i_scenario.getWaterHeight(x, y) > 0.f)
+            return false;
+        }
+
+      return true;
+    }
+
+    /**
+     * Connects an edge of a tile to its neighbor in the grid:
+     * CONNECT if the neighbor exists, WALL if it is land, the scenario's type at the
+     * outer edges of the grid.
+     */
+    void connect(int i, int j, BoundaryEdge i_edge, SWE_Scenario &i_scenario) {
+      const int l_neighborX = i + (i_edge == BND_RIGHT) - (i_edge == BND_LEFT);
+      const int l_neighborY = j + (i_edge == BND_TOP) - (i_edge == BND_BOTTOM);
+
+      if (l_neighborX < 0 || l_neighborX >= getTilesX() || l_neighborY < 0 || l_neighborY >= getTilesY()) {
+        getTile(i, j)->setBoundaryType(i_edge, i_scenario.getBoundaryType(i_edge));
+        return;
+      }
+
+      Block* l_neighbor = getTile(l_neighborX, l_neighborY);
+      if (l_neighbor == 0) {
+        getTile(i, j)->setBoundaryType(i_edge, WALL);
+        return;
+      }
+
+      // BND_LEFT <-> BND_RIGHT, BND_BOTTOM <-> BND_TOP
+      copyLayers.push_back( l_neighbor->registerCopyLayer(BoundaryEdge(i_edge ^ 1)) );
+      getTile(i, j)->setBoundaryType(i_edge, CONNECT, copyLayers.back());
+    }
+
+    /**
+     * @return index of the neighbor of a tile, the tile itself if there is no allocated neighbor
+     */
+    int neighborIndex(int i_tile, BoundaryEdge i_edge) const {
+      const int i = i_tile / getTilesY(), j = i_tile % getTilesY();
+      if (isOuterEdge(i, j, i_edge))
+        return i_tile;
+
+      const int l_neighbor = i_tile + (i_edge == BND_RIGHT ? getTilesY() : 0) - (i_edge == BND_LEFT ? getTilesY() : 0)
+                                    + (i_edge == BND_TOP) - (i_edge == BND_BOTTOM);
+      return (tiles[l_neighbor] != 0) ? l_neighbor : i_tile;
+    }
+
+    /**
+     * @return index of the neighbor of a tile with another time step class, -1 if the
+     *  neighbor has the same class or there is no allocated neighbor
+     */
+    int otherClassNeighbor(int i_tile, int i_edge) const {
+      const int l_neighbor = neighborIndex(i_tile, BoundaryEdge(i_edge));
+      return (timestepClasses[l_neighbor] != timestepClasses[i_tile]) ? l_neighbor : -1;
+    }
+
+    //! @return number of cells of a tile along an edge
+    int edgeLength(int i_tile, int i_edge) const {
+      return (i_edge == BND_LEFT || i_edge == BND_RIGHT) ? getTileNy(i_tile % getTilesY())
+                                                          : getTileNx(i_tile / getTilesY());
+    }
+
+    /**
+     * Interpolates the ghost cells next to tiles of a larger class in time, between the
+     * values before (stored copy layers) and after (copied ghost layers) their time step.
+     *
+     * @param i_step current step of the smallest time step.
+     */
+    void interpolateGhostLayers(int i_tile, int i_step) {
+      Block &l_block = *tiles[i_tile];
+      const Float2D &l_h = l_block.getWaterHeight();
+      const Float2D &l_hu = l_block.getDischarge_hu();
+      const Float2D &l_hv = l_block.getDischarge_hv();
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        const int l_neighbor = otherClassNeighbor(i_tile, l_edge);
+        if (l_neighbor < 0 || timestepClasses[l_neighbor] < timestepClasses[i_tile])
+          continue;
+
+        // at the beginning of the time step of the neighbor, the copied values are current
+        const int l_period = 1 << timestepClasses[l_neighbor];
+        if (i_step % l_period == 0)
+          continue;
+
+        const float l_alpha = float(i_step % l_period) / l_period;
+        const std::vector<float> &l_old = oldLayers[4*l_neighbor + (l_edge ^ 1)];
+
+        for (int k = 0; k < edgeLength(i_tile, l_edge); k++) {
+          const int i = (l_edge == BND_LEFT) ? 0 : (l_edge == BND_RIGHT) ? l_block.getNx()+1 : k+1;
+          const int j = (l_edge == BND_BOTTOM) ? 0 : (l_edge == BND_TOP) ? l_block.getNy()+1 : k+1;
+
+          l_block.setUnknowns( i-1, j-1, l_old[3*k] + l_alpha * (l_h[i][j] - l_old[3*k]),
+                                         l_old[3*k+1] + l_alpha * (l_hu[i][j] - l_old[3*k+1]),
+                                         l_old[3*k+2] + l_alpha * (l_hv[i][j] - l_old[3*k+2]) );
+        }
+      }
+    }
+
+    /**
+     * Adds the fluxes through the edges to tiles of other classes (after the computation
+     * of the numerical fluxes), evaluated on the side of the larger class.
+     *
+     * @param i_step current step of the smallest time step.
+     * @param i_dt time step width of the tile.
+     */
+    void addFluxes(int i_tile, int i_step, float i_dt) {
+      std::vector<float> l_hFluxes, l_momentumFluxes;
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        const int l_neighbor = otherClassNeighbor(i_tile, l_edge);
+        if (l_neighbor < 0)
+          continue;
+
+        // the larger class sums up a single time step, the smaller class all of its time steps within
+        const bool l_largerNeighbor = timestepClasses[l_neighbor] > timestepClasses[i_tile];
+        std::vector<float> &l_fluxes = fluxes[4*i_tile + l_edge];
+        if (!l_largerNeighbor || i_step % (1 << timestepClasses[l_neighbor]) == 0)
+          std::fill(l_fluxes.begin(), l_fluxes.end(), 0.f);
+
+        const int l_length = edgeLength(i_tile, l_edge);
+        l_hFluxes.resize(l_length);
+        l_momentumFluxes.resize(l_length);
+        tiles[i_tile]->getBoundaryFluxes(BoundaryEdge(l_edge), l_largerNeighbor, &l_hFluxes[0], &l_momentumFluxes[0]);
+
+        for (int k = 0; k < l_length; k++) {
+          l_fluxes[2*k] += i_dt * l_hFluxes[k];
+          l_fluxes[2*k+1] += i_dt * l_momentumFluxes[k];
+        }
+      }
+    }
+
+    /**
+     * Stores the copy layers at the edges to tiles of smaller classes, before the unknowns are updated.
+     */
+    void storeOldLayers(int i_tile) {
+      Block &l_block = *tiles[i_tile];
+      const Float2D &l_h = l_block.getWaterHeight();
+      const Float2D &l_hu = l_block.getDischarge_hu();
+      const Float2D &l_hv = l_block.getDischarge_hv();
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        const int l_neighbor = otherClassNeighbor(i_tile, l_edge);
+        if (l_neighbor < 0 || timestepClasses[l_neighbor] > timestepClasses[i_tile])
+          continue;
+
+        std::vector<float> &l_old = oldLayers[4*i_tile + l_edge];
+        for (int k = 0; k < edgeLength(i_tile, l_edge); k++) {
+          const int i = (l_edge == BND_LEFT) ? 1 : (l_edge == BND_RIGHT) ? l_block.getNx() : k+1;
+          const int j = (l_edge == BND_BOTTOM) ? 1 : (l_edge == BND_TOP) ? l_block.getNy() : k+1;
+
+          l_old[3*k] = l_h[i][j];
+          l_old[3*k+1] = l_hu[i][j];
+          l_old[3*k+2] = l_hv[i][j];
+        }
+      }
+    }
+
+    /**
+     * Corrects the cells of a tile next to tiles of smaller classes after its time step:
+     * replaces its fluxes by the fluxes of the time steps of the neighbors.
+     */
+    void correctFluxes(int i_tile) {
+      Block &l_block = *tiles[i_tile];
+      const Float2D &l_h = l_block.getWaterHeight();
+      const Float2D &l_hu = l_block.getDischarge_hu();
+      const Float2D &l_hv = l_block.getDischarge_hv();
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        const int l_neighbor = otherClassNeighbor(i_tile, l_edge);
+        if (l_neighbor < 0 || timestepClasses[l_neighbor] > timestepClasses[i_tile])
+          continue;
+
+        const bool l_vertical = (l_edge == BND_LEFT || l_edge == BND_RIGHT);
+        // the fluxes point in positive x- (y-)direction, i.e. out of the cells at the right (top) edge
+        const float l_scale = ((l_edge == BND_RIGHT || l_edge == BND_TOP) ? 1.f : -1.f) / (l_vertical ? dx : dy);
+        const std::vector<float> &l_fluxes = fluxes[4*i_tile + l_edge];
+        const std::vector<float> &l_neighborFluxes = fluxes[4*l_neighbor + (l_edge ^ 1)];
+
+        for (int k = 0; k < edgeLength(i_tile, l_edge); k++) {
+          const int i = (l_edge == BND_LEFT) ? 1 : (l_edge == BND_RIGHT) ? l_block.getNx() : k+1;
+          const int j = (l_edge == BND_BOTTOM) ? 1 : (l_edge == BND_TOP) ? l_block.getNy() : k+1;
+
+          const float l_h_new = l_h[i][j] + l_scale * (l_fluxes[2*k] - l_neighborFluxes[2*k]);
+          const float l_dMomentum = l_scale * (l_fluxes[2*k+1] - l_neighborFluxes[2*k+1]);
+
+          if (l_h_new < 0.f)
+            l_block.setUnknowns(i-1, j-1, 0.f, 0.f, 0.f);
+          else
+            l_block.setUnknowns( i-1, j-1, l_h_new, l_hu[i][j] + (l_vertical ? l_dMomentum : 0.f),
+                                                    l_hv[i][j] + (l_vertical ? 0.f : l_dMomentum) );
+        }
+      }
+    }
+
+    /**
+     * @return true if all cells of a tile are at rest: no momentum, dry (see SWE_Block::restDryTol)
+     *  or water surface at the sea level up to the round-off of h + b
+     */
+    bool isAtRest(int i_tile) {
+      Block &l_block = *tiles[i_tile];
+      const Float2D &l_h = l_block.getWaterHeight();
+      const Float2D &l_hu = l_block.getDischarge_hu();
+      const Float2D &l_hv = l_block.getDischarge_hv();
+      const Float2D &l_b = l_block.getBathymetry();
+
+      const float l_epsilon = 4.f * std::numeric_limits<float>::epsilon();
+      for (int i = 1; i <= l_block.getNx(); i++)
+        for (int j = 1; j <= l_block.getNy(); j++)
+          if ( l_hu[i][j] != 0.f || l_hv[i][j] != 0.f
+               || ( l_h[i][j] > SWE_Block::restDryTol
+                    && std::abs(l_h[i][j] + l_b[i][j] - seaLevel) > l_epsilon * (l_h[i][j] + std::abs(l_b[i][j])) ) )
+            return false;
+
+      return true;
+    }
+
+    /**
+     * Updates whether a tile is computed: the tile or one of its neighbors is not at rest.
+     * The neighbors have to be updated before.
+     */
+    void updateActiveTile(int i_tile) {
+      if (!trackActiveRegion)
+        return;
+
+      char l_active = disturbedTiles[i_tile] | exchangedTiles[i_tile];
+      for (int l_edge = 0; l_edge < 4; l_edge++)
+        l_active |= disturbedTiles[neighborIndex(i_tile, BoundaryEdge(l_edge))];
+      activeTiles[i_tile] = l_active;
+    }
+
+    /**
+     * Updates the unknowns of a computed tile and whether it is at rest afterwards.
+     */
+    void updateTile(int i_tile, float dt) {
+      if (!activeTiles[i_tile])
+        return;
+
+      tiles[i_tile]->updateUnknowns(dt);
+      if (trackActiveRegion)
+        disturbedTiles[i_tile] = !isAtRest(i_tile);
+    }
+
+    /**
+     * Sets the maximum time step to the minimum of all computed tiles.
+     */
+    void reduceMaxTimestep() {
+      maxTimestep = std::numeric_limits<float>::max();
+      for (size_t l_tile = 0; l_tile < tiles.size(); l_tile++)
+        if (tiles[l_tile] != 0 && activeTiles[l_tile])
+          maxTimestep = std::min(maxTimestep, tiles[l_tile]->getMaxTimestep());
+    }
+
+  public:
+    /**
+     * Allocates and initializes the tiles which are not on land.
+     *
+     * @param i_nx number of cells in x-direction.
+     * @param i_ny number of cells in y-direction.
+     * @param i_dx cell size in x-direction.
+     * @param i_dy cell size in y-direction.
+     * @param i_offsetX x-coordinate of the lower left corner.
+     * @param i_offsetY y-coordinate of the lower left corner.
+     * @param i_scenario the scenario.
+     * @param i_tileSize number of cells of a tile in each direction (<= 0: a single tile).
+     * @param i_landElevation tiles whose bathymetry is above this elevation are not allocated
+     *  (default: all tiles are allocated).
+     */
+    SWE_SparseBlockGrid( int i_nx, int i_ny,
+                         float i_dx, float i_dy,
+                         float i_offsetX, float i_offsetY,
+                         SWE_Scenario &i_scenario,
+                         int i_tileSize = 0,
+                         float i_landElevation = std::numeric_limits<float>::max() ):
+      nx(i_nx), ny(i_ny),
+      dx(i_dx), dy(i_dy),
+      offsetX(i_offsetX), offsetY(i_offsetY),
+      maxTimestep(std::numeric_limits<float>::max()),
+      maxTimestepClass(0),
+      largestTimestepClass(0),
+      trackActiveRegion(false),
+      seaLevel(0.f) {
+      cutsX = tools::Decomposition::tileCuts(tools::Decomposition::uniformCuts(nx, 1), i_tileSize);
+      cutsY = tools::Decomposition::tileCuts(tools::Decomposition::uniformCuts(ny, 1), i_tileSize);
+
+      const bool l_skipLand = i_landElevation < std::numeric_limits<float>::max();
+
+      tiles.resize(getTilesX() * getTilesY(), 0);
+      taskDependencies.resize(tiles.size());
+      disturbedTiles.assign(tiles.size(), 1);
+      activeTiles.assign(tiles.size(), 1);
+      exchangedTiles.assign(tiles.size(), 0);
+      for (int i = 0; i < getTilesX(); i++)
+        for (int j = 0; j < getTilesY(); j++) {
+          if (l_skipLand && isLand(i_scenario, i, j, i_landElevation))
+            continue;
+
+          Block* l_tile = new Block(getTileNx(i), getTileNy(j), dx, dy);
+          l_tile->initScenario(getTileOriginX(i), getTileOriginY(j), i_scenario, true);
+          tiles[i*getTilesY() + j] = l_tile;
+        }
+
+      for (int i = 0; i < getTilesX(); i++)
+        for (int j = 0; j < getTilesY(); j++)
+          if (getTile(i, j) != 0)
+            for (int l_edge = 0; l_edge < 4; l_edge++)
+              connect(i, j, BoundaryEdge(l_edge), i_scenario);
+    }
+
+    ~SWE_SparseBlockGrid() {
+      for (size_t l_layer = 0; l_layer < copyLayers.size(); l_layer++)
+        delete copyLayers[l_layer];
+      for (size_t l_tile = 0; l_tile < tiles.size(); l_tile++)
+        delete tiles[l_tile];
+    }
+
+    /**
+     * Sets the boundary condition of all allocated tiles at an outer edge of the grid.
+     */
+    void setBoundaryType(BoundaryEdge i_edge, BoundaryType i_type) {
+      for (int i = 0; i < getTilesX(); i++)
+        for (int j = 0; j < getTilesY(); j++)
+          if (getTile(i, j) != 0 && isOuterEdge(i, j, i_edge))
+            getTile(i, j)->setBoundaryType(i_edge, i_type);
+    }
+
+    /**
+     * @return true if the edge of the tile is part of the outer edge of the grid
+     */
+    bool isOuterEdge(int i, int j, BoundaryEdge i_edge) const {
+      switch (i_edge) {
+        case BND_LEFT:   return i == 0;
+        case BND_RIGHT:  return i == getTilesX()-1;
+        case BND_BOTTOM: return j == 0;
+        case BND_TOP:    return j == getTilesY()-1;
+      }
+      return false;
+    }
+
+    /**
+     * Sets the ghost layers of all tiles.
+     * The connected edges copy the values of the neighboring tiles.
+     */
+    void setGhostLayer() {
+      const int l_numberOfTiles = tiles.size();
+
+      #pragma omp parallel for schedule(dynamic) if(l_numberOfTiles > 1)
+      for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+        if (tiles[l_tile] != 0)
+          tiles[l_tile]->setGhostLayer();
+    }
+
+    /**
+     * Computes the cell-based time step of all tiles, see SWE_Block::computeMaxTimestep().
+     */
+    void computeMaxTimestep() {
+      const int l_numberOfTiles = tiles.size();
+
+      #pragma omp parallel for schedule(dynamic) if(l_numberOfTiles > 1)
+      for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+        if (tiles[l_tile] != 0)
+          tiles[l_tile]->computeMaxTimestep();
+
+      reduceMaxTimestep();
+    }
+
+    /**
+     * Computes upper bounds of the velocities and celerities of all tiles,
+     * see SWE_Block::computeWaveSpeedBounds().
+     *
+     * @param o_maxVelocity largest particle velocity.
+     * @param o_maxCelerity largest celerity.
+     */
+    void computeWaveSpeedBounds(float &o_maxVelocity, float &o_maxCelerity) const {
+      o_maxVelocity = o_maxCelerity = 0.f;
+
+      for (size_t l_tile = 0; l_tile < tiles.size(); l_tile++)
+        if (tiles[l_tile] != 0) {
+          float l_velocity, l_celerity;
+          tiles[l_tile]->computeWaveSpeedBounds(l_velocity, l_celerity);
+          o_maxVelocity = std::max(o_maxVelocity, l_velocity);
+          o_maxCelerity = std::max(o_maxCelerity, l_celerity);
+        }
+    }
+
+    /**
+     * Computes the numerical fluxes on all edges of all tiles.
+     */
+    void computeNumericalFluxes() {
+      const int l_numberOfTiles = tiles.size();
+
+      #pragma omp parallel for schedule(dynamic) if(l_numberOfTiles > 1)
+      for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+        if (tiles[l_tile] != 0) {
+          updateActiveTile(l_tile);
+          if (activeTiles[l_tile])
+            tiles[l_tile]->computeNumericalFluxes();
+        }
+
+      reduceMaxTimestep();
+    }
+
+    /**
+     * Computes the numerical fluxes on the edges which do not depend on the ghost layers
+     * of the tiles, i.e. these can be computed before the ghost layers are set.
+     * Has to be followed by computeOuterNumericalFluxes().
+     */
+    void computeInnerNumericalFluxes() {
+      const int l_numberOfTiles = tiles.size();
+
+      #pragma omp parallel for schedule(dynamic) if(l_numberOfTiles > 1)
+      for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+        if (tiles[l_tile] != 0) {
+          updateActiveTile(l_tile);
+          if (activeTiles[l_tile])
+            tiles[l_tile]->computeNumericalFluxes( 2, tiles[l_tile]->getNx()+1, 2, tiles[l_tile]->getNy()+1 );
+        }
+    }
+
+    /**
+     * Computes the numerical fluxes on the edges next to the ghost layers of the tiles.
+     */
+    void computeOuterNumericalFluxes() {
+      const int l_numberOfTiles = tiles.size();
+
+      #pragma omp parallel for schedule(dynamic) if(l_numberOfTiles > 1)
+      for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+        if (tiles[l_tile] != 0 && activeTiles[l_tile]) {
+          Block &l_block = *tiles[l_tile];
+          l_block.computeNumericalFluxes( 1, 2, 1, 2 );
+          l_block.computeNumericalFluxes( l_block.getNx()+1, l_block.getNx()+2, l_block.getNy()+1, l_block.getNy()+2 );
+        }
+
+      reduceMaxTimestep();
+    }
+
+    /**
+     * @return maximum time step of all tiles (after the computation of the fluxes)
+     */
+    float getMaxTimestep() const {
+      return maxTimestep;
+    }
+
+    /**
+     * Updates the unknowns of all computed tiles.
+     */
+    void updateUnknowns(float dt) {
+      const int l_numberOfTiles = tiles.size();
+
+      #pragma omp parallel for schedule(dynamic) if(l_numberOfTiles > 1)
+      for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+        if (tiles[l_tile] != 0)
+          updateTile(l_tile, dt);
+    }
+
+    /**
+     * Updates the unknowns of all tiles and computes the numerical fluxes of the next
+     * time step, i.e. updateUnknowns(), setGhostLayer() and computeNumericalFluxes().
+     *
+     * With OpenMP, the tiles are scheduled as tasks: the ghost layers of a tile are set
+     * and its fluxes computed as soon as the tile and its neighbors are updated. Idle
+     * threads steal the tasks of busy threads, which balances tiles of different cost
+     * (e.g. next to dry regions), and a tile is typically computed while it is still
+     * in the cache from its update.
+     *
+     * @param dt time step width of the update.
+     */
+    void updateUnknownsAndComputeNumericalFluxes(float dt) {
+#if defined(_OPENMP) && _OPENMP >= 201307
+      const int l_numberOfTiles = tiles.size();
+      char *l_updated = &taskDependencies[0];
+
+      #pragma omp parallel if(l_numberOfTiles > 1)
+      #pragma omp single
+      {
+        for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+          if (tiles[l_tile] != 0) {
+            #pragma omp task firstprivate(l_tile) depend(out: l_updated[l_tile])
+            updateTile(l_tile, dt);
+          }
+
+        for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+          if (tiles[l_tile] != 0) {
+            const int l_left = neighborIndex(l_tile, BND_LEFT), l_right = neighborIndex(l_tile, BND_RIGHT);
+            const int l_bottom = neighborIndex(l_tile, BND_BOTTOM), l_top = neighborIndex(l_tile, BND_TOP);
+
+            #pragma omp task firstprivate(l_tile) \
+                depend(in: l_updated[l_tile], l_updated[l_left], l_updated[l_right], l_updated[l_bottom], l_updated[l_top])
+            {
+              updateActiveTile(l_tile);
+              if (activeTiles[l_tile]) {
+                tiles[l_tile]->setGhostLayer();
+                tiles[l_tile]->computeNumericalFluxes();
+              }
+            }
+          }
+      }
+
+      reduceMaxTimestep();
+#else
+      updateUnknowns(dt);
+      setGhostLayer();
+      computeNumericalFluxes();
+#endif
+    }
+
+    /**
+     * Enables the active region tracking, i.e. skips the tiles which are at rest and whose
+     * neighbors are at rest as well. Requires the unknowns on the host (no CUDA) and cannot
+     * be combined with local time stepping. The grid does not know whether the neighbors
+     * behind exchanged outer edges (e.g. MPI) are at rest, these tiles have to be marked
+     * with setExchangedTile() and are always computed.
+     *
+     * @param i_seaLevel water surface of the ocean at rest.
+     */
+    void setActiveRegionTracking(float i_seaLevel = 0.f) {
+      trackActiveRegion = true;
+      seaLevel = i_seaLevel;
+
+      for (size_t l_tile = 0; l_tile < tiles.size(); l_tile++)
+        if (tiles[l_tile] != 0)
+          disturbedTiles[l_tile] = !isAtRest(l_tile);
+      for (size_t l_tile = 0; l_tile < tiles.size(); l_tile++)
+        if (tiles[l_tile] != 0)
+          updateActiveTile(l_tile);
+    }
+
+    /**
+     * Marks a tile whose ghost layers are (partly) set outside the grid, e.g. by an MPI exchange
+     * (active region tracking).
+     */
+    void setExchangedTile(int i, int j) {
+      exchangedTiles[i*getTilesY() + j] = 1;
+      updateActiveTile(i*getTilesY() + j);
+    }
+
+    /**
+     * Enables local time stepping (CPU blocks with SWE_Block::getBoundaryFluxes() only).
+     * The time step has to be computed with computeLocalTimesteps() and executed with
+     * simulateLocalTimesteps().
+     *
+     * @param i_maxClass largest time step class, i.e. the tiles advance with at most
+     *  2^i_maxClass times the smallest time step.
+     */
+    void setLocalTimestepping(int i_maxClass) {
+      assert(i_maxClass >= 0);
+      maxTimestepClass = i_maxClass;
+
+      timestepClasses.assign(tiles.size(), 0);
+      oldLayers.resize(4 * tiles.size());
+      fluxes.resize(4 * tiles.size());
+      for (size_t l_tile = 0; l_tile < tiles.size(); l_tile++)
+        if (tiles[l_tile] != 0)
+          for (int l_edge = 0; l_edge < 4; l_edge++) {
+            oldLayers[4*l_tile + l_edge].resize(3 * edgeLength(l_tile, l_edge));
+            fluxes[4*l_tile + l_edge].resize(2 * edgeLength(l_tile, l_edge));
+          }
+    }
+
+    /**
+     * Computes the time step of all tiles from their numerical fluxes and assigns the time
+     * step classes: the largest class whose time step does not exceed the time step of the
+     * tile, at most one larger than the classes of the neighbors.
+     *
+     * The fluxes include the edges to the neighbors, i.e. the wave speeds at the interfaces
+     * of the classes (a cell-based time step only sees the cells of the tile). They are
+     * computed once more by simulateLocalTimesteps().
+     *
+     * @return time step width of the tiles of the largest class (see getMaxTimestep()).
+     */
+    float computeLocalTimesteps() {
+      assert(timestepClasses.size() == tiles.size()); // see setLocalTimestepping()
+      setGhostLayer();
+      computeNumericalFluxes();
+
+      const int l_numberOfTiles = tiles.size();
+      for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+        if (tiles[l_tile] != 0) {
+          int &l_class = timestepClasses[l_tile];
+          for (l_class = 0; l_class < maxTimestepClass &&
+                            tiles[l_tile]->getMaxTimestep() >= maxTimestep * (2 << l_class); l_class++);
+        }
+
+      // neighbors differ by at most one class
+      for (bool l_changed = true; l_changed; ) {
+        l_changed = false;
+        for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+          if (tiles[l_tile] != 0)
+            for (int l_edge = 0; l_edge < 4; l_edge++) {
+              const int l_neighbor = neighborIndex(l_tile, BoundaryEdge(l_edge));
+              if (timestepClasses[l_tile] > timestepClasses[l_neighbor] + 1) {
+                timestepClasses[l_tile] = timestepClasses[l_neighbor] + 1;
+                l_changed = true;
+              }
+            }
+      }
+
+      largestTimestepClass = 0;
+      for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+        if (tiles[l_tile] != 0)
+          largestTimestepClass = std::max(largestTimestepClass, timestepClasses[l_tile]);
+
+      maxTimestep *= 1 << largestTimestepClass;
+      return maxTimestep;
+    }
+
+    /**
+     * Advances all tiles by a time step with local time stepping: a tile of class c executes
+     * 2^(c-largest class) steps. Sets the ghost layers and computes the fluxes itself.
+     *
+     * @param dt time step width of the tiles of the largest class (at most computeLocalTimesteps()).
+     */
+    void simulateLocalTimesteps(float dt) {
+      assert(timestepClasses.size() == tiles.size()); // see setLocalTimestepping()
+      const int l_numberOfTiles = tiles.size();
+      const int l_numberOfSteps = 1 << largestTimestepClass;
+      const float l_dt = dt / l_numberOfSteps;
+
+      //! tiles which finish or start a time step
+      std::vector<int> l_tiles;
+
+      for (int l_step = 0; l_step <= l_numberOfSteps; l_step++) {
+        // correct the tiles which finished their time step
+        l_tiles.clear();
+        for (int l_tile = 0; l_tile < l_numberOfTiles && l_step > 0; l_tile++)
+          if (tiles[l_tile] != 0 && l_step % (1 << timestepClasses[l_tile]) == 0)
+            l_tiles.push_back(l_tile);
+
+        const int l_numberOfCorrections = l_tiles.size();
+        #pragma omp parallel for schedule(dynamic) if(l_numberOfCorrections > 1)
+        for (int l_tile = 0; l_tile < l_numberOfCorrections; l_tile++)
+          correctFluxes(l_tiles[l_tile]);
+
+        if (l_step == l_numberOfSteps)
+          break;
+
+        // time steps of the tiles which start one
+        l_tiles.clear();
+        for (int l_tile = 0; l_tile < l_numberOfTiles; l_tile++)
+          if (tiles[l_tile] != 0 && l_step % (1 << timestepClasses[l_tile]) == 0)
+            l_tiles.push_back(l_tile);
+
+        const int l_numberOfActiveTiles = l_tiles.size();
+        #pragma omp parallel for schedule(dynamic) if(l_numberOfActiveTiles > 1)
+        for (int l_tile = 0; l_tile < l_numberOfActiveTiles; l_tile++) {
+          const int l_index = l_tiles[l_tile];
+          tiles[l_index]->setGhostLayer();
+          interpolateGhostLayers(l_index, l_step);
+          tiles[l_index]->computeNumericalFluxes();
+          addFluxes(l_index, l_step, l_dt * (1 << timestepClasses[l_index]));
+        }
+
+        #pragma omp parallel for schedule(dynamic) if(l_numberOfActiveTiles > 1)
+        for (int l_tile = 0; l_tile < l_numberOfActiveTiles; l_tile++) {
+          const int l_index = l_tiles[l_tile];
+          storeOldLayers(l_index);
+          tiles[l_index]->updateUnknowns(l_dt * (1 << timestepClasses[l_index]));
+        }
+      }
+    }
+
+    /**
+     * @return time step class of a tile (local time stepping)
+     */
+    int getTimestepClass(int i, int j) const {
+      return timestepClasses.empty() ? 0 : timestepClasses[i*getTilesY() + j];
+    }
+
+    /**
+     * @return true if a tile is computed in the current time step (active region tracking)
+     */
+    bool isComputed(int i, int j) const {
+      return activeTiles[i*getTilesY() + j] != 0;
+    }
+
+    int getNx() const { return nx; }
+    int getNy() const { return ny; }
+
+    int getTilesX() const { return cutsX.size()-1; }
+    int getTilesY() const { return cutsY.size()-1; }
+
+    //! @return the tile, 0 if it is a land tile
+    Block* getTile(int i, int j) const { return tiles[i*getTilesY() + j]; }
+
+    //! @return first cell of tile column i
+    int getTileOffsetX(int i) const { return cutsX[i]; }
+    //! @return first cell of tile row j
+    int getTileOffsetY(int j) const { return cutsY[j]; }
+
+    //! @return number of cells of tile column i
+    int getTileNx(int i) const { return cutsX[i+1] - cutsX[i]; }
+    //! @return number of cells of tile row j
+    int getTileNy(int j) const { return cutsY[j+1] - cutsY[j]; }
+
+    //! @return x-coordinate of the lower left corner of tile column i
+    float getTileOriginX(int i) const { return offsetX + cutsX[i]*dx; }
+    //! @return y-coordinate of the lower left corner of tile row j
+    float getTileOriginY(int j) const { return offsetY + cutsY[j]*dy; }
+
+    /**
+     * @return number of cells in the tiles which are computed in the current time step
+     */
+    long getNumberOfComputedCells() const {
+      long l_cells = 0;
+      for (int i = 0; i < getTilesX(); i++)
+        for (int j = 0; j < getTilesY(); j++)
+          if (getTile(i, j) != 0 && activeTiles[i*getTilesY() + j])
+            l_cells += (long) getTileNx(i) * getTileNy(j);
+
+      return l_cells;
+    }
+
+    /**
+     * @return number of cells in the allocated tiles
+     */
+    long getNumberOfActiveCells() const {
+      long l_cells = 0;
+      for (int i = 0; i < getTilesX(); i++)
+        for (int j = 0; j < getTilesY(); j++)
+          if (getTile(i, j) != 0)
+            l_cells += (long) getTileNx(i) * getTileNy(j);
+
+      return l_cells;
+    }
+};
+
+#endif // SWE_SPARSEBLOCKGRID_HH_
@@ -56,8 +56,14 @@ SWE_WaveAccumulationBlock::SWE_WaveAccumulationBlock(
   SWE_Block(l_nx, l_ny, l_dx, l_dy),
   hNetUpdates (nx+2, ny+2),
   huNetUpdates(nx+2, ny+2),
-  hvNetUpdates(nx+2, ny+2)
-{}
+  hvNetUpdates(nx+2, ny+2),
+  maxWaveSpeedOfStep(0.f)
+{
+	// the net updates are accumulated, start with zero
+	for(int i = 0; i < nx+2; i++)
+		for(int j = 0; j < ny+2; j++)
+			hNetUpdates[i][j] = huNetUpdates[i][j] = hvNetUpdates[i][j] = (float) 0;
+}
 
 /**
  * Compute net updates for the block.
@@ -65,6 +71,21 @@ SWE_WaveAccumulationBlock::SWE_WaveAccumulationBlock(
  * maximum allowed time step size
  */
 void SWE_WaveAccumulationBlock::computeNumericalFluxes() {
+	computeNumericalFluxes(1, nx+2, 1, ny+2);
+}
+
+/**
+ * Compute net updates for a sub-range of the edges (see SWE_Block).
+ * The net updates and the maximum wave speed are accumulated until
+ * the next call of updateUnknowns(), i.e. #maxTimestep is valid for
+ * all edges computed so far.
+ *
+ * @param i_xStart first vertical edge.
+ * @param i_xEnd vertical edge after the last one.
+ * @param i_yStart first horizontal edge.
+ * @param i_yEnd horizontal edge after the last one.
+ */
+void SWE_WaveAccumulationBlock::computeNumericalFluxes(int i_xStart, int i_xEnd, int i_yStart, int i_yEnd) {
 
 	float dx_inv = 1.0f/dx;
 	float dy_inv = 1.0f/dy;
@@ -79,42 +100,62 @@ void SWE_WaveAccumulationBlock::computeNumericalFluxes() {
 {
 	// thread-local maximum wave speed:
 	float l_maxWaveSpeed = (float) 0.;
+#endif // LOOP_OPENMP
 
-	// Use OpenMP for the outer loop
-	#pragma omp for
+	// Edge i accumulates to the cells i-1 and i. Hence, the vertical edges are
+	// processed in two passes (every other edge), such that the edges of one pass
+	// update disjoint columns and can be distributed among the threads without races.
+	for(int l_colour = 0; l_colour < 2; l_colour++) {
+#ifdef LOOP_OPENMP
+		// Use OpenMP for the outer loop (implicit barrier between the passes)
+		#pragma omp for
 #endif // LOOP_OPENMP
-	for(int i = 1; i < nx+2; i++) {
-		const int ny_end = ny+1;	// compiler might refuse to vectorize j-loop without this ...
+		for(int i = i_xStart + l_colour; i < i_xEnd; i += 2) {
+			const int ny_end = ny+1;	// compiler might refuse to vectorize j-loop without this ...
+
+#if WAVE_PROPAGATION_SOLVER==4
+			// lake at rest: zero net updates, nothing to accumulate
+			float maxColumnSpeed;
+			if( isLakeAtRest(h[i-1] + 1, h[i] + 1, hu[i-1] + 1, hu[i] + 1, b[i-1] + 1, b[i] + 1, ny, maxColumnSpeed) ) {
+				#ifdef LOOP_OPENMP
+					l_maxWaveSpeed = std::max(l_maxWaveSpeed, maxColumnSpeed);
+				#else // LOOP_OPENMP
+					maxWaveSpeed = std::max(maxWaveSpeed, maxColumnSpeed);
+				#endif // LOOP_OPENMP
+				continue;
+			}
+#endif
 
 #ifdef VECTORIZE // Vectorize the inner loop
-		#pragma simd
+			#pragma simd
 #endif // VECTORIZE
-		for(int j = 1; j < ny_end; j++) {
-
-			float maxEdgeSpeed;
-			float hNetUpLeft, hNetUpRight;
-			float huNetUpLeft, huNetUpRight;
-
-			wavePropagationSolver.computeNetUpdates( h[i-1][j], h[i][j],
-                                               hu[i-1][j], hu[i][j],
-                                               b[i-1][j], b[i][j],
-                                               hNetUpLeft, hNetUpRight,
-                                               huNetUpLeft, huNetUpRight,
-                                               maxEdgeSpeed );
-
-			// accumulate net updates to cell-wise net updates for h and hu
-			hNetUpdates[i-1][j]  += dx_inv * hNetUpLeft;
-			huNetUpdates[i-1][j] += dx_inv * huNetUpLeft;
-			hNetUpdates[i][j]    += dx_inv * hNetUpRight;
-			huNetUpdates[i][j]   += dx_inv * huNetUpRight;
-
-			#ifdef LOOP_OPENMP
-				//update the thread-local maximum wave speed
-				l_maxWaveSpeed = std::max(l_maxWaveSpeed, maxEdgeSpeed);
-			#else // LOOP_OPENMP
-				//update the maximum wave speed
-				maxWaveSpeed = std::max(maxWaveSpeed, maxEdgeSpeed);
-			#endif // LOOP_OPENMP
+			for(int j = 1; j < ny_end; j++) {
+
+				float maxEdgeSpeed;
+				float hNetUpLeft, hNetUpRight;
+				float huNetUpLeft, huNetUpRight;
+
+				wavePropagationSolver.computeNetUpdates( h[i-1][j], h[i][j],
+	                                               hu[i-1][j], hu[i][j],
+	                                               b[i-1][j], b[i][j],
+	                                               hNetUpLeft, hNetUpRight,
+	                                               huNetUpLeft, huNetUpRight,
+	                                               maxEdgeSpeed );
+
+				// accumulate net updates to cell-wise net updates for h and hu
+				hNetUpdates[i-1][j]  += dx_inv * hNetUpLeft;
+				huNetUpdates[i-1][j] += dx_inv * huNetUpLeft;
+				hNetUpdates[i][j]    += dx_inv * hNetUpRight;
+				huNetUpdates[i][j]   += dx_inv * huNetUpRight;
+
+				#ifdef LOOP_OPENMP
+					//update the thread-local maximum wave speed
+					l_maxWaveSpeed = std::max(l_maxWaveSpeed, maxEdgeSpeed);
+				#else // LOOP_OPENMP
+					//update the maximum wave speed
+					maxWaveSpeed = std::max(maxWaveSpeed, maxEdgeSpeed);
+				#endif // LOOP_OPENMP
+			}
 		}
 	}
 
@@ -124,12 +165,26 @@ void SWE_WaveAccumulationBlock::computeNumericalFluxes() {
 	#pragma omp for
 #endif // LOOP_OPENMP
 	for(int i = 1; i < nx+1; i++) {
-		const int ny_end = ny+2;	// compiler refused to vectorize j-loop without this ...
+		const int ny_end = i_yEnd;	// compiler refused to vectorize j-loop without this ...
+
+#if WAVE_PROPAGATION_SOLVER==4
+		// lake at rest: zero net updates, nothing to accumulate
+		float maxColumnSpeed;
+		if( isLakeAtRest(h[i] + i_yStart - 1, h[i] + i_yStart, hv[i] + i_yStart - 1, hv[i] + i_yStart,
+		                 b[i] + i_yStart - 1, b[i] + i_yStart, i_yEnd - i_yStart, maxColumnSpeed) ) {
+			#ifdef LOOP_OPENMP
+				l_maxWaveSpeed = std::max(l_maxWaveSpeed, maxColumnSpeed);
+			#else // LOOP_OPENMP
+				maxWaveSpeed = std::max(maxWaveSpeed, maxColumnSpeed);
+			#endif // LOOP_OPENMP
+			continue;
+		}
+#endif
 
 #ifdef VECTORIZE // Vectorize the inner loop	
 		#pragma simd
 #endif // VECTORIZE
-		for(int j = 1; j < ny_end; j++) {
+		for(int j = i_yStart; j < ny_end; j++) {
 			float maxEdgeSpeed;
 			float hNetUpDow, hNetUpUpw;
 			float hvNetUpDow, hvNetUpUpw;
@@ -166,6 +221,10 @@ void SWE_WaveAccumulationBlock::computeNumericalFluxes() {
 } // #pragma omp parallel
 #endif
 
+	// include the edges of previous calls in this time step
+	maxWaveSpeedOfStep = std::max(maxWaveSpeedOfStep, maxWaveSpeed);
+	maxWaveSpeed = maxWaveSpeedOfStep;
+
 	if(maxWaveSpeed > 0.00001) {
 		//TODO zeroTol
 
@@ -190,6 +249,9 @@ void SWE_WaveAccumulationBlock::computeNumericalFluxes() {
  */
 void SWE_WaveAccumulationBlock::updateUnknowns(float dt) {
 
+  // the next call of computeNumericalFluxes starts a new time step
+  maxWaveSpeedOfStep = 0.f;
+
   //update cell averages with the net-updates
 #ifdef LOOP_OPENMP
 	#pragma omp parallel for
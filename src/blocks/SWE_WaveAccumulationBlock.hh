@@ -76,6 +76,9 @@ class SWE_WaveAccumulationBlock: public SWE_Block {
     //! net-updates for the y-momentums of the cells (for accumulation)
     Float2D hvNetUpdates;
 
+    //! maximum wave speed of all edges computed since the last update
+    float maxWaveSpeedOfStep;
+
   public:
     //constructor of a SWE_WaveAccumulationBlock.
     SWE_WaveAccumulationBlock(int l_nx, int l_ny, float l_dx, float l_dy);
@@ -84,6 +87,7 @@ class SWE_WaveAccumulationBlock: public SWE_Block {
 
     //computes the net-updates for the block
     void computeNumericalFluxes();
+    void computeNumericalFluxes(int i_xStart, int i_xEnd, int i_yStart, int i_yEnd);
 
     //update the cells
     void updateUnknowns(float dt);
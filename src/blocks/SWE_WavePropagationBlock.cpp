@@ -87,10 +87,100 @@ SWE_WavePropagationBlock::SWE_WavePropagationBlock (int l_nx, int l_ny, float l_
 	hNetUpdatesBelow (nx, ny + 1),
 	hNetUpdatesAbove (nx, ny + 1),
 	hvNetUpdatesBelow (nx, ny + 1),
-	hvNetUpdatesAbove (nx, ny + 1)
+	hvNetUpdatesAbove (nx, ny + 1),
+	maxWaveSpeedOfStep (0.f)
+#ifdef INVARIANT_CACHE
+	, bathymetryDifferencesX (nx + 1, ny),
+	bathymetryDifferencesY (nx, ny + 1),
+	bathymetryDifferencesValid (false),
+	sqrtWaterHeight (nx + 2, ny + 2),
+	inverseWaterHeight (nx + 2, ny + 2),
+	invariantColumns (nx + 2, 0)
+#endif
 {
 }
 
+#ifdef INVARIANT_CACHE
+/**
+ * Sets the bathymetry of one cell (see SWE_Block) and
+ * invalidates the bathymetry differences.
+ */
+void
+SWE_WavePropagationBlock::setBathymetry (int i_x, int i_y, float i_b)
+{
+	SWE_Block::setBathymetry (i_x, i_y, i_b);
+	bathymetryDifferencesValid = false;
+}
+
+/**
+ * Invalidates the bathymetry differences after an update of the bathymetry.
+ */
+void
+SWE_WavePropagationBlock::synchBathymetryAfterWrite ()
+{
+	bathymetryDifferencesValid = false;
+}
+
+/**
+ * Recomputes the bathymetry differences across all edges,
+ * if the bathymetry was changed since the last call.
+ */
+void
+SWE_WavePropagationBlock::updateBathymetryDifferences ()
+{
+	if (bathymetryDifferencesValid)
+		return;
+
+	for (int i = 1; i < nx + 2; i++)
+		for (int j = 1; j < ny + 1; j++)
+			bathymetryDifferencesX[i - 1][j - 1] = b[i][j] - b[i - 1][j];
+
+	for (int i = 1; i < nx + 1; i++)
+		for (int j = 1; j < ny + 2; j++)
+			bathymetryDifferencesY[i - 1][j - 1] = b[i][j] - b[i][j - 1];
+
+	bathymetryDifferencesValid = true;
+}
+
+/**
+ * Computes the square roots and inverses of the water heights of a rectangle of cells.
+ *
+ * @param i_xStart first column.
+ * @param i_xEnd column after the last one.
+ * @param i_yStart first row.
+ * @param i_yEnd row after the last one.
+ */
+void
+SWE_WavePropagationBlock::computeCellInvariants (int i_xStart, int i_xEnd, int i_yStart, int i_yEnd)
+{
+	for (int i = i_xStart; i < i_xEnd; i++) {
+#ifdef VECTORIZE
+#pragma ivdep
+#endif // VECTORIZE
+		for (int j = i_yStart; j < i_yEnd; j++) {
+			sqrtWaterHeight[i][j] = std::sqrt (h[i][j]);
+			inverseWaterHeight[i][j] = (h[i][j] > 0.f) ? 1.f / h[i][j] : 0.f;
+		}
+	}
+}
+
+/**
+ * Computes the invariants of the inner cells of a column,
+ * if they were not computed before in the current call of computeNumericalFluxes().
+ *
+ * @param i_column the column.
+ */
+void
+SWE_WavePropagationBlock::computeColumnInvariants (int i_column)
+{
+	if (invariantColumns[i_column])
+		return;
+
+	computeCellInvariants (i_column, i_column + 1, 1, ny + 1);
+	invariantColumns[i_column] = 1;
+}
+#endif // INVARIANT_CACHE
+
 /**
  * Compute net updates for the block.
  * The member variable #maxTimestep will be updated with the 
@@ -98,22 +188,67 @@ SWE_WavePropagationBlock::SWE_WavePropagationBlock (int l_nx, int l_ny, float l_
  */
 void
 SWE_WavePropagationBlock::computeNumericalFluxes ()
+{
+	computeNumericalFluxes (1, nx + 2, 1, ny + 2);
+}
+
+/**
+ * Compute net updates for a sub-range of the edges (see SWE_Block).
+ * The maximum wave speed is accumulated until the next call of
+ * updateUnknowns(), i.e. #maxTimestep is valid for all edges computed so far.
+ *
+ * @param i_xStart first vertical edge.
+ * @param i_xEnd vertical edge after the last one.
+ * @param i_yStart first horizontal edge.
+ * @param i_yEnd horizontal edge after the last one.
+ */
+void
+SWE_WavePropagationBlock::computeNumericalFluxes (int i_xStart, int i_xEnd, int i_yStart, int i_yEnd)
 {
 	//maximum (linearized) wave speed within one iteration
 	float maxWaveSpeed = (float) 0.;
 
+#ifdef INVARIANT_CACHE
+	updateBathymetryDifferences ();
+
+	// the invariants are computed (each cell once) for the columns which are not at rest, see below
+	invariantColumns.assign (nx + 2, 0);
+#endif
+
 	/***************************************************************************************
 	 * compute the net-updates for the vertical edges
 	 **************************************************************************************/
 
-	for (int i = 1; i < nx+2; i++) {
+	for (int i = i_xStart; i < i_xEnd; i++) {
+#if WAVE_PROPAGATION_SOLVER==1
+		// lake at rest: zero net-updates without calling the solver
+		float maxColumnSpeed;
+		if (isLakeAtRest (h[i - 1] + 1, h[i] + 1, hu[i - 1] + 1, hu[i] + 1, b[i - 1] + 1, b[i] + 1, ny, maxColumnSpeed)) {
+			for (int j = 0; j < ny; j++)
+				hNetUpdatesLeft[i - 1][j] = hNetUpdatesRight[i - 1][j] = huNetUpdatesLeft[i - 1][j] = huNetUpdatesRight[i - 1][j] = 0.f;
+
+			maxWaveSpeed = std::max (maxWaveSpeed, maxColumnSpeed);
+			continue;
+		}
+#endif
+#ifdef INVARIANT_CACHE
+		computeColumnInvariants (i - 1);
+		computeColumnInvariants (i);
+#endif
+
 		for (int j=1; j < ny+1; ++j) {
 			float maxEdgeSpeed;
 
 			wavePropagationSolver.computeNetUpdates (
 				h[i - 1][j], h[i][j],
 				hu[i - 1][j], hu[i][j],
+#ifdef INVARIANT_CACHE
+				bathymetryDifferencesX[i - 1][j - 1],
+				sqrtWaterHeight[i - 1][j], sqrtWaterHeight[i][j],
+				inverseWaterHeight[i - 1][j], inverseWaterHeight[i][j],
+#else
 				b[i - 1][j], b[i][j],
+#endif
 				hNetUpdatesLeft[i - 1][j - 1], hNetUpdatesRight[i - 1][j - 1],
 				huNetUpdatesLeft[i - 1][j - 1], huNetUpdatesRight[i - 1][j - 1],
 				maxEdgeSpeed
@@ -129,13 +264,42 @@ SWE_WavePropagationBlock::computeNumericalFluxes ()
 	 **************************************************************************************/
 
 	for (int i=1; i < nx + 1; i++) {
-		for (int j=1; j < ny + 2; j++) {
+#if WAVE_PROPAGATION_SOLVER==1
+		// lake at rest: zero net-updates without calling the solver
+		float maxColumnSpeed;
+		if (isLakeAtRest (h[i] + i_yStart - 1, h[i] + i_yStart, hv[i] + i_yStart - 1, hv[i] + i_yStart,
+		                  b[i] + i_yStart - 1, b[i] + i_yStart, i_yEnd - i_yStart, maxColumnSpeed)) {
+			for (int j = i_yStart - 1; j < i_yEnd - 1; j++)
+				hNetUpdatesBelow[i - 1][j] = hNetUpdatesAbove[i - 1][j] = hvNetUpdatesBelow[i - 1][j] = hvNetUpdatesAbove[i - 1][j] = 0.f;
+
+			maxWaveSpeed = std::max (maxWaveSpeed, maxColumnSpeed);
+			continue;
+		}
+#endif
+#ifdef INVARIANT_CACHE
+		// the inner cells of the column may be cached by the vertical edges, the ghost cells are not
+		if (invariantColumns[i]) {
+			if (i_yStart == 1)
+				computeCellInvariants (i, i + 1, 0, 1);
+			if (i_yEnd == ny + 2)
+				computeCellInvariants (i, i + 1, ny + 1, ny + 2);
+		} else
+			computeCellInvariants (i, i + 1, i_yStart - 1, i_yEnd);
+#endif
+
+		for (int j=i_yStart; j < i_yEnd; j++) {
 			float maxEdgeSpeed;
 
 			wavePropagationSolver.computeNetUpdates (
 				h[i][j - 1], h[i][j],
 				hv[i][j - 1], hv[i][j],
+#ifdef INVARIANT_CACHE
+				bathymetryDifferencesY[i - 1][j - 1],
+				sqrtWaterHeight[i][j - 1], sqrtWaterHeight[i][j],
+				inverseWaterHeight[i][j - 1], inverseWaterHeight[i][j],
+#else
 				b[i][j - 1], b[i][j],
+#endif
 				hNetUpdatesBelow[i - 1][j - 1], hNetUpdatesAbove[i - 1][j - 1],
 				hvNetUpdatesBelow[i - 1][j - 1], hvNetUpdatesAbove[i - 1][j - 1],
 				maxEdgeSpeed
@@ -146,6 +310,10 @@ SWE_WavePropagationBlock::computeNumericalFluxes ()
 		}
 	}
 
+	// include the edges of previous calls in this time step
+	maxWaveSpeedOfStep = std::max (maxWaveSpeedOfStep, maxWaveSpeed);
+	maxWaveSpeed = maxWaveSpeedOfStep;
+
 	if (maxWaveSpeed > 0.00001) {
 		//TODO zeroTol
 
@@ -163,6 +331,57 @@ SWE_WavePropagationBlock::computeNumericalFluxes ()
 	}
 }
 
+/**
+ * Returns the fluxes through the edges at a boundary (see SWE_Block):
+ * the physical flux of the cells on one side of the edges, corrected by the
+ * net-updates of this side, i.e. f(Q_l) + A^-dQ or f(Q_r) - A^+dQ.
+ *
+ * @param i_edge boundary of the block.
+ * @param i_ghostSide evaluate the fluxes on the side of the ghost cells.
+ * @param o_hFlux flux of the water height through each edge.
+ * @param o_momentumFlux flux of the normal momentum through each edge.
+ */
+void
+SWE_WavePropagationBlock::getBoundaryFluxes (BoundaryEdge i_edge, bool i_ghostSide, float* o_hFlux, float* o_momentumFlux)
+{
+	// the ghost cells are on the left (lower) side of the edges at the left (bottom) boundary
+	const bool l_leftSide = (i_ghostSide == (i_edge == BND_LEFT || i_edge == BND_BOTTOM));
+
+	if (i_edge == BND_LEFT || i_edge == BND_RIGHT) {
+		// edge i lies between the cells i and i+1
+		const int l_edge = (i_edge == BND_LEFT) ? 0 : nx;
+		const int i = l_leftSide ? l_edge : l_edge + 1;
+
+		for (int j = 1; j < ny+1; j++) {
+			const float l_momentumFlux = (h[i][j] > 0.f) ? hu[i][j]*hu[i][j]/h[i][j] + .5f*g*h[i][j]*h[i][j] : 0.f;
+
+			if (l_leftSide) {
+				o_hFlux[j-1] = hu[i][j] + hNetUpdatesLeft[l_edge][j-1];
+				o_momentumFlux[j-1] = l_momentumFlux + huNetUpdatesLeft[l_edge][j-1];
+			} else {
+				o_hFlux[j-1] = hu[i][j] - hNetUpdatesRight[l_edge][j-1];
+				o_momentumFlux[j-1] = l_momentumFlux - huNetUpdatesRight[l_edge][j-1];
+			}
+		}
+	} else {
+		// edge j lies between the cells j and j+1
+		const int l_edge = (i_edge == BND_BOTTOM) ? 0 : ny;
+		const int j = l_leftSide ? l_edge : l_edge + 1;
+
+		for (int i = 1; i < nx+1; i++) {
+			const float l_momentumFlux = (h[i][j] > 0.f) ? hv[i][j]*hv[i][j]/h[i][j] + .5f*g*h[i][j]*h[i][j] : 0.f;
+
+			if (l_leftSide) {
+				o_hFlux[i-1] = hv[i][j] + hNetUpdatesBelow[i-1][l_edge];
+				o_momentumFlux[i-1] = l_momentumFlux + hvNetUpdatesBelow[i-1][l_edge];
+			} else {
+				o_hFlux[i-1] = hv[i][j] - hNetUpdatesAbove[i-1][l_edge];
+				o_momentumFlux[i-1] = l_momentumFlux - hvNetUpdatesAbove[i-1][l_edge];
+			}
+		}
+	}
+}
+
 /**
  * Updates the unknowns with the already computed net-updates.
  *
@@ -171,6 +390,9 @@ SWE_WavePropagationBlock::computeNumericalFluxes ()
 void
 SWE_WavePropagationBlock::updateUnknowns (float dt)
 {
+	// the next call of computeNumericalFluxes starts a new time step
+	maxWaveSpeedOfStep = 0.f;
+
 	//update cell averages with the net-updates
 	for (int i = 1; i < nx+1; i++) {
 		for (int j = 1; j < ny + 1; j++) {
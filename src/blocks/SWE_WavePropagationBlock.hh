@@ -34,6 +34,7 @@
 #include "tools/help.hh"
 
 #include <string>
+#include <vector>
 
 //which wave propagation solver should be used
 //  0: Hybrid
@@ -42,13 +43,21 @@
 #if WAVE_PROPAGATION_SOLVER==0
 #include "solvers/Hybrid.hpp"
 #elif WAVE_PROPAGATION_SOLVER==1
+#ifdef INVARIANT_CACHE
+#include "solvers/FWaveCached.hpp"
+#else
 #include "solvers/FWave.hpp"
+#endif
 #elif WAVE_PROPAGATION_SOLVER==2
 //#include "solvers/AugRie.hpp"
 #else
 #warning SWE_WavePropagationBlock should only be used with Riemann solvers 0, 1, and 2 (FWave, AugRie or Hybrid)
 #endif
 
+#if defined(INVARIANT_CACHE) && WAVE_PROPAGATION_SOLVER!=1
+#error The invariant cache (INVARIANT_CACHE) requires the f-wave solver
+#endif
+
 /**
  * SWE_WavePropagationBlock is an implementation of the SWE_Block abstract class.
  * It uses a wave propagation solver which is defined with the pre-compiler flag WAVE_PROPAGATION_SOLVER (see above).
@@ -65,8 +74,13 @@ private:
     //! Hybrid solver (f-wave + augmented)
     solver::Hybrid<float> wavePropagationSolver;
 #elif WAVE_PROPAGATION_SOLVER==1
+#ifdef INVARIANT_CACHE
+    //! F-wave Riemann solver with cached invariants
+    solver::FWaveCached<float> wavePropagationSolver;
+#else
     //! F-wave Riemann solver
     solver::FWave<float> wavePropagationSolver;
+#endif
 #elif WAVE_PROPAGATION_SOLVER==2
     //! Approximate Augmented Riemann solver
     solver::AugRie<float> wavePropagationSolver;
@@ -92,6 +106,36 @@ private:
     //! net-updates for the y-momentums of the cells above the horizontal edges.
     Float2D hvNetUpdatesAbove;
 
+    //! maximum wave speed of all edges computed since the last update
+    float maxWaveSpeedOfStep;
+
+#ifdef INVARIANT_CACHE
+    //! bathymetry differences across the vertical edges (right minus left cell), same layout as the net-updates.
+    Float2D bathymetryDifferencesX;
+    //! bathymetry differences across the horizontal edges (upper minus lower cell), same layout as the net-updates.
+    Float2D bathymetryDifferencesY;
+    //! true if the bathymetry differences match the current bathymetry.
+    bool bathymetryDifferencesValid;
+
+    //! square roots of the water heights, including the ghost layer.
+    Float2D sqrtWaterHeight;
+    //! inverse water heights (0 in dry cells), including the ghost layer.
+    Float2D inverseWaterHeight;
+    //! 1 for the columns whose inner cells are cached by the current call of computeNumericalFluxes().
+    std::vector<char> invariantColumns;
+
+    //recomputes the bathymetry differences if the bathymetry changed
+    void updateBathymetryDifferences();
+    //computes the invariants of the cells [i_xStart, i_xEnd) x [i_yStart, i_yEnd)
+    void computeCellInvariants(int i_xStart, int i_xEnd, int i_yStart, int i_yEnd);
+    //computes the invariants of the inner cells of a column, unless they are cached
+    void computeColumnInvariants(int i_column);
+
+  protected:
+    //invalidates the bathymetry differences
+    virtual void synchBathymetryAfterWrite();
+#endif
+
   public:
     //constructor of a SWE_WavePropagationBlock.
     SWE_WavePropagationBlock(int l_nx, int l_ny,
@@ -99,11 +143,21 @@ private:
 
     //computes the net-updates for the block
     void computeNumericalFluxes();
+    void computeNumericalFluxes(int i_xStart, int i_xEnd, int i_yStart, int i_yEnd);
+
+    //returns the fluxes through the edges at a boundary
+    void getBoundaryFluxes(BoundaryEdge i_edge, bool i_ghostSide, float* o_hFlux, float* o_momentumFlux);
 
     //update the cells
     void updateUnknowns(float dt);
     void updateUnknownsRow(float dt, int i);
 
+#ifdef INVARIANT_CACHE
+    //set the bathymetry (invalidates the bathymetry differences)
+    using SWE_Block::setBathymetry;
+    void setBathymetry(int i_x, int i_y, float i_b);
+#endif
+
     /**
      * Destructor of a SWE_WavePropagationBlock.
      *
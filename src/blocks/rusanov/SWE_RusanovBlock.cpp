@@ -28,6 +28,8 @@
 #include "SWE_RusanovBlock.hh"
 #include <math.h>
 
+const float SWE_RusanovBlock::timestepFactor = 0.5f;
+
 /**
  * Constructor: allocate variables for simulation
  *
@@ -42,11 +44,13 @@
  *
  * bathymetry source terms are defined for cells with indices [1,..,nx]*[1,..,ny]
  *
- * @ param _offsetX	x coordinate of block origin
- * @ param _offsetY	y coordinate of block origin
+ * @param l_nx	number of cells in x-direction
+ * @param l_ny	number of cells in y-direction
+ * @param l_dx	cell size in x-direction
+ * @param l_dy	cell size in y-direction
  */
-SWE_RusanovBlock::SWE_RusanovBlock(float _offsetX, float _offsetY) 
-: SWE_Block(_offsetX,_offsetY),
+SWE_RusanovBlock::SWE_RusanovBlock(int l_nx, int l_ny, float l_dx, float l_dy) 
+: SWE_Block(l_nx,l_ny,l_dx,l_dy),
   Fh(nx+1,ny+1), Fhu(nx+1,ny+1), Fhv(nx+1,ny+1),
   Gh(nx+1,ny+1), Ghu(nx+1,ny+1), Ghv(nx+1,ny+1),
   Bx(nx+1,ny+1), By(nx+1,ny+1)
@@ -66,10 +70,18 @@ SWE_RusanovBlock::~SWE_RusanovBlock() {
  * (and stored in the variables Fh, Gh, etc.);
  * compute the balance terms for each cell, and update the 
  * unknowns according to an Euler time step.
+ * The largest allowed time step for the updated unknowns is computed
+ * in the same pass (see computeMaxTimestep()).
  * @param dt	size of the time step.
  */
 void SWE_RusanovBlock::updateUnknowns(float dt) {
 
+  // maximum wave speed of all updated cells
+  float l_maxWaveSpeed = 0.f;
+
+#ifdef LOOP_OPENMP
+#pragma omp parallel for reduction(max:l_maxWaveSpeed)
+#endif // LOOP_OPENMP
   for(int i=1; i<=nx; i++)
     for(int j=1; j<=ny; j++) {
       h[i][j] -= dt *( (Fh[i][j]-Fh[i-1][j])/dx + (Gh[i][j]-Gh[i][j-1])/dy );
@@ -85,7 +97,19 @@ void SWE_RusanovBlock::updateUnknowns(float dt) {
          hu[i][j] = 0.0;
          hv[i][j] = 0.0;
       };
+
+      // wave speed of the updated cell, dry cells are ignored
+      float l_waveSpeed = ( h[i][j] > dryTol )
+        ? std::max( std::abs(hu[i][j]), std::abs(hv[i][j]) ) / h[i][j] + std::sqrt( g * h[i][j] )
+        : 0.f;
+      l_maxWaveSpeed = std::max( l_maxWaveSpeed, l_waveSpeed );
     };
+
+  // largest allowed time step for the next update (same as computeMaxTimestep())
+  maxTimestep = std::min( dx, dy ) / l_maxWaveSpeed;
+  maxTimestep *= cflNumber;
+  // more pessimistic choice of the time step
+  maxTimestep *= timestepFactor;
 }
 
 /** 
@@ -118,18 +142,21 @@ void SWE_RusanovBlock::simulateTimestep(float dt) {
  */
 float SWE_RusanovBlock::simulate(float tStart, float tEnd) {
   float t = tStart;
+
+  // largest allowed time step of the initial unknowns
+  // (updated by updateUnknowns() after each time step)
+  computeMaxTimestep();
+
   do {
      // set values in ghost cells:
      setGhostLayer();
      
-     // execute Euler time step:
-     simulateTimestep(maxTimestep);
+     // execute Euler time step (updates maxTimestep):
+     float dt = maxTimestep;
+     simulateTimestep(dt);
 
-     t += maxTimestep; cout << "Simulation at time " << t << endl << flush;
+     t += dt; cout << "Simulation at time " << t << endl << flush;
 
-     // calculate and set largest allowed time step:
-     computeMaxTimestep();
-     
   } while(t < tEnd);
 
   return t;
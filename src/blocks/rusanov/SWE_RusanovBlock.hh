@@ -47,7 +47,7 @@ class SWE_RusanovBlock : public SWE_Block {
 
   public:
     // Constructor und Destructor
-    SWE_RusanovBlock(float _offsetX = 0, float _offsetY = 0);
+    SWE_RusanovBlock(int l_nx, int l_ny, float l_dx, float l_dy);
     virtual ~SWE_RusanovBlock();
     
   // object methods
@@ -70,12 +70,16 @@ class SWE_RusanovBlock : public SWE_Block {
     float computeLocalSV(int i, int j, char dir);
 
     // compute the largest allowed time step for the current grid block
+    // (initialization only, updateUnknowns() computes it for the updated cells)
     virtual void computeMaxTimestep() {
        SWE_Block::computeMaxTimestep();
        // more pessimistic choice of the time step
-       maxTimestep *= 0.5; 
+       maxTimestep *= timestepFactor; 
     };
 
+    /// factor for a more pessimistic choice of the time step (applied on top of the CFL number)
+    static const float timestepFactor;
+
     // define additional arrays for temporary unknowns: 
     // - arrays to hold the values of the flux terms at cell edges
     Float2D Fh;
@@ -0,0 +1,266 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Setting of SWE with block-structured adaptive mesh refinement, which uses a wave propagation solver
+ * and an artificial or ASAGI scenario.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "blocks/SWE_WavePropagationBlock.hh"
+#include "blocks/SWE_AdaptiveBlockGrid.hh"
+
+#include "writer/VtkWriter.hh"
+
+#ifdef ASAGI
+#include "scenarios/SWE_AsagiScenario.hh"
+#else
+#include "scenarios/SWE_ArtificialTsunamiScenario.hh"
+#endif
+
+#include "tools/args.hh"
+#include "tools/help.hh"
+#include "tools/Logger.hh"
+#include "tools/OutputScheduler.hh"
+#include "tools/ProgressBar.hh"
+
+/**
+ * Writes the leaves of the grid (one file per leaf and a multi-block container) and
+ * prints the number of cells of each level.
+ */
+static void writeLeaves( SWE_AdaptiveBlockGrid<SWE_WavePropagationBlock> &i_grid,
+                         std::string &i_baseName, size_t i_frame, float i_time ) {
+  //boundary size of the ghost layers
+  io::BoundarySize l_boundarySize = {{1, 1, 1, 1}};
+
+  std::vector<std::string> l_fileNames;
+  for (int l_leaf = 0; l_leaf < i_grid.getNumberOfLeaves(); l_leaf++) {
+    SWE_Block &l_block = *i_grid.getLeaf(l_leaf);
+
+    // the leaves change with each regrid, a writer per leaf and frame
+    std::ostringstream l_fileName;
+    l_fileName << i_baseName << "_" << l_leaf;
+    io::VtkWriter l_writer( l_fileName.str(),
+                            l_block.getBathymetry(),
+                            l_boundarySize,
+                            l_block.getNx(), l_block.getNy(),
+                            l_block.getDx(), l_block.getDy(),
+                            i_grid.getLeafOffsetX(l_leaf), i_grid.getLeafOffsetY(l_leaf),
+                            true, i_frame );
+    l_writer.writeTimeStep( l_block.getWaterHeight(),
+                            l_block.getDischarge_hu(),
+                            l_block.getDischarge_hv(),
+                            i_time );
+
+    l_fileName << '.' << i_frame << ".vtr";
+    l_fileNames.push_back(l_fileName.str());
+  }
+
+  io::VtkWriter::writeMultiBlockContainer(i_baseName, i_frame, l_fileNames);
+
+  for (int l_level = 0; l_level < i_grid.getNumberOfLevels(); l_level++)
+    tools::Logger::logger.cout() << "level " << l_level << ": " << i_grid.getNumberOfCells(l_level) << " cells" << std::endl;
+}
+
+/**
+ * Main program for the simulation with adaptive mesh refinement.
+ */
+int main( int argc, char** argv ) {
+  /**
+   * Initialization.
+   */
+  // Parse command line parameters
+  tools::Args args;
+  args.addOption("grid-size-x", 'x', "Number of cells in x direction (coarsest level)");
+  args.addOption("grid-size-y", 'y', "Number of cells in y direction (coarsest level)");
+  args.addOption("output-basepath", 'o', "Output base file name");
+  args.addOption("output-interval", 0, "Simulated time between two outputs (default: 1/20 of the simulation time)", tools::Args::Required, false);
+  args.addOption("output-wall-fraction", 0, "Maximum fraction of the wall clock time spent on output", tools::Args::Required, false);
+  args.addOption("block-size", 0, "Number of cells of a block in each direction (default: 32)", tools::Args::Required, false);
+  args.addOption("refine-levels", 0, "Maximum number of refinement levels (default: 2)", tools::Args::Required, false);
+  args.addOption("refine-threshold", 0, "Refine where the water surface of neighboring cells differs by more than this value (default: 0.01)", tools::Args::Required, false);
+  args.addOption("regrid-interval", 0, "Number of time steps between two regrids (default: 4)", tools::Args::Required, false);
+  args.addOption("timestep-factor", 0, "Safety factor of the time step (default: 0.75)", tools::Args::Required, false);
+
+  tools::Args::Result ret = args.parse(argc, argv);
+
+  switch (ret)
+  {
+  case tools::Args::Error:
+	  return 1;
+  case tools::Args::Help:
+	  return 0;
+  case tools::Args::Success:
+	  break;
+  }
+
+  //! number of grid cells of the coarsest level in x- and y-direction.
+  int l_nX, l_nY;
+
+  //! l_baseName of the plots.
+  std::string l_baseName;
+
+  // read command line parameters
+  l_nX = args.getArgument<int>("grid-size-x");
+  l_nY = args.getArgument<int>("grid-size-y");
+  l_baseName = args.getArgument<std::string>("output-basepath");
+
+  const int l_blockSize = args.getArgument<int>("block-size", 32);
+  const int l_maxLevel = args.getArgument<int>("refine-levels", 2);
+  const int l_regridInterval = args.getArgument<int>("regrid-interval", 4);
+  if( l_blockSize < 2 || l_maxLevel < 0 || l_regridInterval < 1 ) {
+    tools::Logger::logger.printString("Aborting. The block size must be at least 2, the regrid interval at least 1.");
+    return 1;
+  }
+
+  #ifdef ASAGI
+  //simulation area (see swe_simple)
+  float simulationArea[4];
+  simulationArea[0] = -450000;
+  simulationArea[1] = 6450000;
+  simulationArea[2] = -2450000;
+  simulationArea[3] = 1450000;
+
+  SWE_AsagiScenario l_scenario( ASAGI_INPUT_DIR "tohoku_gebco_ucsb3_500m_hawaii_bath.nc",
+                                ASAGI_INPUT_DIR "tohoku_gebco_ucsb3_500m_hawaii_displ.nc",
+                                (float) 28800., simulationArea);
+  #else
+  // create a simple artificial scenario
+  SWE_ArtificialTsunamiScenario l_scenario(l_nX, l_nY);
+  #endif
+
+  //! number of checkpoints for visualization (at each checkpoint in time, an output file is written).
+  int l_numberOfCheckPoints = 20;
+
+  //! size of a single cell of the coarsest level in x- and y-direction
+  float l_dX, l_dY;
+
+  // compute the size of a single cell
+  l_dX = (l_scenario.getBoundaryPos(BND_RIGHT) - l_scenario.getBoundaryPos(BND_LEFT) )/l_nX;
+  l_dY = (l_scenario.getBoundaryPos(BND_TOP) - l_scenario.getBoundaryPos(BND_BOTTOM) )/l_nY;
+
+  // create the root blocks and refine them for the initial condition
+  SWE_AdaptiveBlockGrid<SWE_WavePropagationBlock> l_grid( l_nX, l_nY, l_dX, l_dY,
+                                                           l_scenario.getBoundaryPos(BND_LEFT),
+                                                           l_scenario.getBoundaryPos(BND_BOTTOM),
+                                                           l_scenario, l_blockSize, l_maxLevel,
+                                                           args.getArgument<float>("refine-threshold", .01f),
+                                                           args.getArgument<float>("timestep-factor", .75f) );
+
+  //! time when the simulation ends.
+  float l_endSimulation = l_scenario.endSimulation();
+
+  //! decides when output files are written.
+  tools::OutputScheduler l_outputScheduler( 0.f, l_endSimulation,
+    args.getArgument<float>("output-interval", l_endSimulation/l_numberOfCheckPoints),
+    args.getArgument<float>("output-wall-fraction", 1.f) );
+
+  // Init fancy progressbar
+  tools::ProgressBar progressBar(l_endSimulation);
+
+  // write the output at time zero
+  tools::Logger::logger.printOutputTime((float) 0.);
+  progressBar.update(0.);
+
+  //! number of written output frames
+  size_t l_frames = 0;
+
+  l_outputScheduler.beginOutput();
+  writeLeaves(l_grid, l_baseName, l_frames++, 0.f);
+  l_outputScheduler.endOutput();
+
+  /**
+   * Simulation.
+   */
+  // print the start message and reset the wall clock time
+  progressBar.clear();
+  tools::Logger::logger.printStartMessage();
+  tools::Logger::logger.initWallClockTime(time(NULL));
+
+  //! simulation time.
+  float l_t = 0.0;
+  progressBar.update(l_t);
+
+  unsigned int l_iterations = 0;
+
+  // do time steps until the end of the simulation is reached
+  while( !l_outputScheduler.isFinished(l_t) ) {
+    // reset the cpu clock
+    tools::Logger::logger.resetClockToCurrentTime("Cpu");
+
+    //! time step width of the coarsest level, clipped to hit the next output time.
+    float l_maxTimeStepWidth = l_outputScheduler.clipTimestep( l_t, l_grid.computeMaxTimestep() );
+
+    // time step of the coarsest level with the sub-cycles of the finer levels
+    l_grid.simulateTimestep(l_maxTimeStepWidth);
+
+    l_t += l_maxTimeStepWidth;
+    l_iterations++;
+
+    // follow the waves
+    if( l_iterations % l_regridInterval == 0 )
+      l_grid.regrid();
+
+    // update the cpu time in the logger
+    tools::Logger::logger.updateTime("Cpu");
+
+    // print the current simulation time
+    progressBar.clear();
+    tools::Logger::logger.printSimulationTime(l_t);
+    progressBar.update(l_t);
+
+    if( !l_outputScheduler.isOutputDue(l_t) )
+      continue;
+
+    // print current simulation time of the output
+    progressBar.clear();
+    tools::Logger::logger.printOutputTime(l_t);
+    progressBar.update(l_t);
+
+    // write output
+    l_outputScheduler.beginOutput();
+    writeLeaves(l_grid, l_baseName, l_frames++, l_t);
+    l_outputScheduler.endOutput();
+  }
+
+  /**
+   * Finalize.
+   */
+  // write the statistics message
+  progressBar.clear();
+  tools::Logger::logger.printStatisticsMessage();
+
+  // print the cpu time
+  tools::Logger::logger.printTime("Cpu", "CPU time");
+
+  // print the wall clock time (includes plotting)
+  tools::Logger::logger.printWallClockTime(time(NULL));
+
+  // printer iteration counter
+  tools::Logger::logger.printIterationsDone(l_iterations);
+
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include "tools/args.hh"
+#include "tools/OutputScheduler.hh"
 #include "blocks/SWE_DimensionalSplitting.hpp"
 #include "scenarios/SWE_simple_scenarios.hh"
 #ifdef WRITENETCDF
@@ -19,6 +20,7 @@
 #define ARG_BOUND "boundary_type"
 #define ARG_INPUT "input_folder"
 #define ARG_COMPRESSION "compression"
+#define ARG_COMPRESSIONREDUCER "compression_reducer"
 #define ARG_LOGGINGSTEPS "percentage_logging_steps"
 #define ARG_LEFT "left"
 #define ARG_RIGHT "right"
@@ -27,6 +29,9 @@
 #define ARG_SEISMOLOGYPATH "seismological_data"
 #define ARG_CONSTBATHYMETRY "constant_bathymetry"
 #define ARG_FIXDISPLACEMENTTIME "fix-disp-time"
+#define ARG_OUTPUTINTERVAL "output_interval"
+#define ARG_OUTPUTWALLFRACTION "output_wall_fraction"
+#define ARG_OUTPUTEVENT "output_event_threshold"
 
 /**
 * Main program for the simulation using dimensional splitting
@@ -42,6 +47,7 @@ int main(int argc, char** argv){
 	args.addOption(ARG_BOUND, 0, "Sets the boundary conditions, where 1 is Wall and 2 is Outflow", tools::Args::Required, false);
 	args.addOption(ARG_INPUT, 'i', "Folder containing the input nc files", tools::Args::Required, false);
 	args.addOption(ARG_COMPRESSION, 'c', "Compression value. Simulation calculated with [x]x[y] domain and written [x/c]x[y/c] domain", tools::Args::Required, false);
+	args.addOption(ARG_COMPRESSIONREDUCER, 0, "Combines the cells of h, hu and hv for the compression: mean (default), min, max (e.g. hazard maps) or wet_mean", tools::Args::Required, false);
 	args.addOption(ARG_LOGGINGSTEPS, 'l', "Logs a message telling about the progress with the given stepsize", tools::Args::Required, false);
   args.addOption(ARG_LEFT, 0, "Sets the minimum coordinate value in x direction. If one boundary is set, all others must be set too!", tools::Args::Required, false);
   args.addOption(ARG_RIGHT, 0, "Sets the maximum coordinate value in x direction. If one boundary is set, all others must be set too!", tools::Args::Required, false);
@@ -50,6 +56,9 @@ int main(int argc, char** argv){
   args.addOption(ARG_SEISMOLOGYPATH, 's', "Path to the seismological data", tools::Args::Required, false);
   args.addOption(ARG_CONSTBATHYMETRY, 0, "Setting the bathymetry to the negative of the given value", tools::Args::Required, false);
   args.addOption(ARG_FIXDISPLACEMENTTIME, 0, "Setting the bathymetry to the value it would be at the given time in seconds", tools::Args::Required, false);
+  args.addOption(ARG_OUTPUTINTERVAL, 0, "Simulated time between two outputs (default: output after every time step)", tools::Args::Required, false);
+  args.addOption(ARG_OUTPUTWALLFRACTION, 0, "Maximum fraction of the wall clock time spent on output", tools::Args::Required, false);
+  args.addOption(ARG_OUTPUTEVENT, 0, "Additional output if the water surface changed by more than this value", tools::Args::Required, false);
 
 	// Parse them
 	tools::Args::Result parseResult = args.parse(argc, argv);
@@ -287,16 +296,44 @@ int main(int argc, char** argv){
 	tools::Logger::logger.printLine();
 	tools::Logger::logger.printString("Preparing writer");
 
+	// decides when output is written
+	float l_outputInterval = args.getArgument<float>(ARG_OUTPUTINTERVAL, 0.f);
+	tools::OutputScheduler l_outputScheduler(l_time, l_endOfSimulation,
+		l_outputInterval,
+		args.getArgument<float>(ARG_OUTPUTWALLFRACTION, 1.f),
+		args.getArgument<float>(ARG_OUTPUTEVENT, 0.f));
+
 #ifdef WRITENETCDF
 	int l_timeStepsPerCheckpoint = 10, l_cpCounter = 0;
 	size_t l_checkpoints = 0;
 	l_checkpoints = l_scenario->getCheckpointCount();
+
+	// number of frames already in the output file when continuing a run:
+	// one per time step, or one per interval (frames are written at multiples of the interval)
+	size_t l_outputFrames = l_checkpoints * l_timeStepsPerCheckpoint;
+	if(test_cp && l_outputInterval > 0)
+		l_outputFrames = (size_t) (l_time / l_outputInterval + 1e-4f) + 1;
 	
 	float l_originx, l_originy;
 	int compression = 1;
 
 	if(args.isSet(ARG_COMPRESSION) && !args.isSet(ARG_CP))
 		compression = args.getArgument<int>(ARG_COMPRESSION);
+
+	Float2D::CompressReducer compressionReducer = Float2D::COMPRESS_MEAN;
+	if(args.isSet(ARG_COMPRESSIONREDUCER)) {
+		const std::string reducer = args.getArgument<std::string>(ARG_COMPRESSIONREDUCER);
+		if(reducer == "min")
+			compressionReducer = Float2D::COMPRESS_MIN;
+		else if(reducer == "max")
+			compressionReducer = Float2D::COMPRESS_MAX;
+		else if(reducer == "wet_mean")
+			compressionReducer = Float2D::COMPRESS_WET_MEAN;
+		else if(reducer != "mean") {
+			tools::Logger::logger.printString("Unknown compression reducer: " + reducer);
+			return 1;
+		}
+	}
 	
 	l_originx = l_scenario->getBoundaryPos(BND_LEFT);
 	l_originy = l_scenario->getBoundaryPos(BND_BOTTOM);
@@ -308,8 +345,10 @@ int main(int argc, char** argv){
 			l_dx, l_dy,
 			l_originx, l_originy,
 			0,
-			l_checkpoints * l_timeStepsPerCheckpoint,
-			compression);
+			l_outputFrames,
+			compression,
+			io::VAR_ALL,
+			compressionReducer);
 	
 	// Set up Checkpoint writer
 	std::string checkpointFile = "SWE_checkpoints";
@@ -362,13 +401,16 @@ int main(int argc, char** argv){
 	tools::Logger::logger.printString("Starting simulation");
 
 	//Print initial state
+	l_outputScheduler.beginOutput();
 	l_writer.writeTimeStep( l_dimensionalSplitting.getWaterHeight(),
                         l_dimensionalSplitting.getDischarge_hu(),
                         l_dimensionalSplitting.getDischarge_hv(),
                         l_dimensionalSplitting.getBathymetry(),
                         l_time);
+	l_outputScheduler.endOutput(l_dimensionalSplitting.getWaterHeight(),
+                        l_dimensionalSplitting.getBathymetry());
 
-  float fixTimestep = 3, actTimestep, bathymetryUpdateTime = 0;
+  float fixTimestep = 3, bathymetryUpdateTime = 0;
 #ifdef WRITENETCDF
   if(test_seis){
     ((SWE_SeismologyScenario*)l_scenario)->getTimestepInformation(&bathymetryUpdateTime, &fixTimestep);
@@ -377,7 +419,7 @@ int main(int argc, char** argv){
 #endif
 
 	// Loop over timesteps *************************************************************************************
-	while(l_time < l_endOfSimulation)	{
+	while(!l_outputScheduler.isFinished(l_time))	{
 
 #ifdef WRITENETCDF
     if(test_seis)
@@ -385,23 +427,36 @@ int main(int argc, char** argv){
 #endif
 
 		l_dimensionalSplitting.setGhostLayer();
+
+		// limit the time step: hit the next output time exactly and
+		// use the fixed time step while the bathymetry is updated
+    float l_timestepLimit = l_outputScheduler.clipTimestep(l_time, std::numeric_limits<float>::max());
+    if(l_time < bathymetryUpdateTime)
+      l_timestepLimit = std::min(l_timestepLimit, fixTimestep);
+    l_dimensionalSplitting.setTimestepLimit(l_timestepLimit);
 		
 		// compute one timestep
 		l_dimensionalSplitting.computeNumericalFluxes();
 
 		// increment time
-    actTimestep = l_dimensionalSplitting.getMaxTimestep();
-    if(l_time < bathymetryUpdateTime && fixTimestep < actTimestep)
-      l_time+=fixTimestep;
-    else
-      l_time+=actTimestep;
+    l_time += l_dimensionalSplitting.getMaxTimestep();
 
     //Write timestep
-		l_writer.writeTimeStep( l_dimensionalSplitting.getWaterHeight(),
-    	l_dimensionalSplitting.getDischarge_hu(),
-      l_dimensionalSplitting.getDischarge_hv(),
-      l_dimensionalSplitting.getBathymetry(),
-      l_time);
+    float l_surfaceChange = 0.f;
+    if(l_outputScheduler.hasEventTrigger())
+      l_surfaceChange = l_outputScheduler.computeSurfaceChange(l_dimensionalSplitting.getWaterHeight(),
+        l_dimensionalSplitting.getBathymetry());
+
+    if(l_outputScheduler.isOutputDue(l_time, l_surfaceChange)) {
+      l_outputScheduler.beginOutput();
+      l_writer.writeTimeStep( l_dimensionalSplitting.getWaterHeight(),
+        l_dimensionalSplitting.getDischarge_hu(),
+        l_dimensionalSplitting.getDischarge_hv(),
+        l_dimensionalSplitting.getBathymetry(),
+        l_time);
+      l_outputScheduler.endOutput(l_dimensionalSplitting.getWaterHeight(),
+        l_dimensionalSplitting.getBathymetry());
+    } // if(l_outputScheduler.isOutputDue(l_time, l_surfaceChange))
 		
 // 		std::ostringstream buff;
 //    		buff << l_time;
@@ -31,9 +31,13 @@
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
+#include <limits>
 #include <mpi.h>
 #include <string>
 #include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifndef CUDA
 #include "blocks/SWE_WavePropagationBlock.hh"
@@ -41,9 +45,12 @@
 #else
 #include "blocks/cuda/SWE_WavePropagationBlockCuda.hh"
 #endif
+#include "blocks/SWE_SparseBlockGrid.hh"
+#include "writer/DeltaWriter.hh"
 
 #ifdef WRITENETCDF
 #include "writer/NetCdfWriter.hh"
+#include "writer/RegionOutput.hh"
 #else
 #include "writer/VtkWriter.hh"
 #endif
@@ -59,36 +66,74 @@
 #endif
 
 #include "tools/args.hh"
+#include "tools/Decomposition.hh"
 #include "tools/help.hh"
+#ifndef CUDA
+#include "tools/HaloExchange.hh"
+#if MPI_VERSION >= 3
+#include "tools/SharedHaloWindow.hh"
+#endif
+#include "tools/Checkpoint.hh"
+#endif
 #include "tools/Logger.hh"
+#include "tools/OutputScheduler.hh"
 #include "tools/ProgressBar.hh"
 
-/**
- * Compute the number of block rows from the total number of processes.
- *
- * The number of rows is determined as the square root of the
- * number of processes, if this is a square number;
- * otherwise, we use the largest number that is smaller than the square
- * root and still a divisor of the number of processes.
- *
- * @param numProcs number of process.
- * @return number of block rows
- */
-int computeNumberOfBlockRows(int i_numberOfProcesses) {
-  int l_numberOfRows = std::sqrt(i_numberOfProcesses);
-  while (i_numberOfProcesses % l_numberOfRows != 0) l_numberOfRows--;
-  return l_numberOfRows;
-};
-
 // Exchanges the left and right ghost layers.
 void exchangeLeftRightGhostLayers( const int i_leftNeighborRank,  SWE_Block1D* o_leftInflow,  SWE_Block1D* i_leftOutflow,
                                    const int i_rightNeighborRank, SWE_Block1D* o_rightInflow, SWE_Block1D* i_rightOutflow,
-                                   MPI_Datatype i_mpiCol);
+                                   MPI_Datatype i_mpiCol, MPI_Comm i_communicator);
 
 // Exchanges the bottom and top ghist layers.
 void exchangeBottomTopGhostLayers( const int i_bottomNeighborRank, SWE_Block1D* o_bottomNeighborInflow, SWE_Block1D* i_bottomNeighborOutflow,
                                    const int i_topNeighborRank,    SWE_Block1D* o_topNeighborInflow,    SWE_Block1D* i_topNeighborOutflow,
-                                   const MPI_Datatype i_mpiRow);
+                                   const MPI_Datatype i_mpiRow, MPI_Comm i_communicator);
+
+#ifndef CUDA
+/**
+ * Starts the exchange of the ghost layers of all tiles.
+ */
+void startHaloExchanges(std::vector<tools::HaloExchange*> &io_haloExchanges) {
+  for (size_t l_exchange = 0; l_exchange < io_haloExchanges.size(); l_exchange++)
+    io_haloExchanges[l_exchange]->start();
+}
+
+/**
+ * Waits for the ghost layers of all tiles.
+ */
+void waitHaloExchanges(std::vector<tools::HaloExchange*> &io_haloExchanges) {
+  for (size_t l_exchange = 0; l_exchange < io_haloExchanges.size(); l_exchange++)
+    io_haloExchanges[l_exchange]->wait();
+}
+
+/**
+ * Progresses the exchange of the ghost layers of all tiles without blocking.
+ *
+ * @return true if all ghost layers arrived.
+ */
+bool testHaloExchanges(std::vector<tools::HaloExchange*> &io_haloExchanges) {
+  bool l_done = true;
+  for (size_t l_exchange = 0; l_exchange < io_haloExchanges.size(); l_exchange++)
+    l_done = io_haloExchanges[l_exchange]->test() && l_done;
+
+  return l_done;
+}
+
+/**
+ * @param i_waveSpeedBounds largest particle velocity and largest celerity of all processes,
+ *   see SWE_Block::computeWaveSpeedBounds().
+ * @param i_dx cell size in x-direction.
+ * @param i_dy cell size in y-direction.
+ * @return time step width which satisfies the CFL condition on all edges.
+ */
+float boundedTimestep(const float i_waveSpeedBounds[2], const float i_dx, const float i_dy) {
+  const float l_maxWaveSpeed = i_waveSpeedBounds[0] + i_waveSpeedBounds[1];
+  if( l_maxWaveSpeed <= 0.f )
+    return std::numeric_limits<float>::max();
+
+  return std::min(i_dx, i_dy) / l_maxWaveSpeed * SWE_Block::cflNumber;
+}
+#endif
 
 /**
  * Main program for the simulation on a single SWE_WavePropagationBlock or SWE_WaveAccumulationBlock.
@@ -102,9 +147,12 @@ int main( int argc, char** argv ) {
   //! number of MPI processes.
   int l_numberOfProcesses;
 
-  // initialize MPI
-  if ( MPI_Init(&argc,&argv) != MPI_SUCCESS ) {
-    std::cerr << "MPI_Init failed." << std::endl;
+  //! thread support provided by the MPI library.
+  int l_threadSupport;
+
+  // initialize MPI, only the main thread of a process calls MPI (hybrid MPI+OpenMP)
+  if ( MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &l_threadSupport) != MPI_SUCCESS ) {
+    std::cerr << "MPI_Init_thread failed." << std::endl;
   }
 
   // determine local MPI rank
@@ -122,6 +170,11 @@ int main( int argc, char** argv ) {
   tools::Logger::logger.initWallClockTime( MPI_Wtime() );
   //print the number of processes
   tools::Logger::logger.printNumberOfProcesses(l_numberOfProcesses);
+#ifdef _OPENMP
+  tools::Logger::logger.cout() << "OpenMP threads per process: " << omp_get_max_threads() << std::endl;
+  if( l_threadSupport < MPI_THREAD_FUNNELED )
+    tools::Logger::logger.printString( "Warning: the MPI library does not support MPI_THREAD_FUNNELED" );
+#endif
 
   // check if the necessary command line input parameters are given
   tools::Args args;
@@ -129,7 +182,36 @@ int main( int argc, char** argv ) {
   args.addOption("grid-size-x", 'x', "Number of cell in x direction");
   args.addOption("grid-size-y", 'y', "Number of cell in y direction");
   args.addOption("output-basepath", 'o', "Output base file name");
-  args.addOption("output-steps-count", 'c', "Number of output time steps");
+  args.addOption("output-steps-count", 'c', "Number of output time steps", tools::Args::Required, false);
+  args.addOption("end-time", 'e', "Simulated time at which the simulation ends (default: end of the scenario)", tools::Args::Required, false);
+  args.addOption("output-interval", 0, "Simulated time between two outputs (overrides output-steps-count)", tools::Args::Required, false);
+  args.addOption("output-wall-fraction", 0, "Maximum fraction of the wall clock time spent on output", tools::Args::Required, false);
+  args.addOption("output-event-threshold", 0, "Additional output if the water surface changed by more than this value", tools::Args::Required, false);
+  args.addOption("output-windows", 0, "File describing additional output windows (regions of interest)", tools::Args::Required, false);
+  args.addOption("output-delta-keyframes", 0, "Write delta-encoded output with a keyframe every N frames", tools::Args::Required, false);
+  args.addOption("output-delta-tolerance", 0, "Maximum error of values omitted in delta-encoded output", tools::Args::Required, false);
+#ifdef WRITENETCDF
+  args.addOption("single-output-file", 0, "Write all blocks into one netCDF file with collective parallel writes", tools::Args::No, false);
+#endif
+  args.addOption("decomposition", 0, "Decomposition of the grid: uniform (default) or wet (balances the wet cells)", tools::Args::Required, false);
+  args.addOption("dry-cell-cost", 0, "Cost of a dry cell relative to a wet cell (wet decomposition)", tools::Args::Required, false);
+  args.addOption("decomposition-file", 0, "Read the decomposition from a file (e.g. the rebalanced decomposition of a previous run)", tools::Args::Required, false);
+  args.addOption("rebalance-threshold", 0, "Write a rebalanced decomposition at a checkpoint if the slowest process exceeds the mean compute time by this fraction", tools::Args::Required, false);
+#ifndef CUDA
+  args.addOption("overlap-timestep-reduction", 0, "Reduce a bound of the wave speeds while the fluxes are computed (hides the latency, smaller time steps)", tools::Args::No, false);
+  args.addOption("halo-width", 0, "Number of ghost layers exchanged at once; the halo is exchanged every halo-width time steps", tools::Args::Required, false);
+  args.addOption("halo-timestep-factor", 0, "Factor (<= 1) of the time step, which is fixed for all time steps between two exchanges of a deep halo (smaller factors restart fewer cycles)", tools::Args::Required, false);
+  args.addOption("tile-size", 0, "Number of cells of a tile in each direction (multiple blocks per process)", tools::Args::Required, false);
+  args.addOption("land-elevation", 0, "Tiles whose bathymetry is above this elevation and which are dry are not allocated", tools::Args::Required, false);
+  args.addOption("active-region", 0, "Skip the tiles which (and whose neighbors) are at rest or dry, the tiles at the edges of the process are always computed", tools::Args::No, false);
+  args.addOption("no-shared-memory-halo", 0, "Exchange the ghost layers with neighbors on the same node by messages instead of a shared memory window", tools::Args::No, false);
+  args.addOption("checkpoint-file", 0, "Write checkpoints of all blocks to this file", tools::Args::Required, false);
+  args.addOption("checkpoint-interval", 0, "Minimum wall clock time in seconds between two checkpoints (default: a checkpoint after each output)", tools::Args::Required, false);
+  args.addOption("restart", 0, "Restart from a checkpoint file (the number of processes may differ)", tools::Args::Required, false);
+#ifdef _OPENMP
+  args.addOption("progress-thread", 0, "Dedicate one thread of each process to the communication while the other threads compute the inner fluxes (of several tiles, or of one tile with LOOP_OPENMP)", tools::Args::No, false);
+#endif
+#endif
   #ifdef ASAGI
   args.addOption("bathymetry-file", 'b', "File containing the bathymetry");
   args.addOption("displacement-file", 'd', "File containing the displacement");
@@ -185,21 +267,70 @@ int main( int argc, char** argv ) {
   //! number of SWE_Blocks in x- and y-direction.
   int l_blocksX, l_blocksY;
 
-  // determine the layout of MPI-ranks: use l_blocksX*l_blocksY grid blocks
-  l_blocksY = computeNumberOfBlockRows(l_numberOfProcesses);
+  // determine the layout of MPI-ranks: use l_blocksX*l_blocksY grid blocks with the shortest edges between them
+  l_blocksY = tools::Decomposition::processGridRows(l_numberOfProcesses, l_nX, l_nY);
   l_blocksX = l_numberOfProcesses/l_blocksY;
 
   // print information about the grid
   tools::Logger::logger.printNumberOfCells(l_nX, l_nY);
   tools::Logger::logger.printNumberOfBlocks(l_blocksX, l_blocksY);
 
+  //! position of the block of this process in the process grid (x*l_blocksY + y), the blocks of a node form a patch
+  int l_placement = -1;
+
+#if MPI_VERSION >= 3
+  {
+    MPI_Comm l_nodeCommunicator, l_nodeRankCommunicator;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &l_nodeCommunicator);
+
+    int l_nodeRank, l_processesPerNode[2];
+    MPI_Comm_rank(l_nodeCommunicator, &l_nodeRank);
+    MPI_Comm_size(l_nodeCommunicator, &l_processesPerNode[0]);
+    l_processesPerNode[1] = -l_processesPerNode[0];
+
+    // the nodes are numbered by the order of their first processes
+    int l_node;
+    MPI_Comm_split(MPI_COMM_WORLD, l_nodeRank, l_mpiRank, &l_nodeRankCommunicator);
+    MPI_Comm_rank(l_nodeRankCommunicator, &l_node);
+    MPI_Bcast(&l_node, 1, MPI_INT, 0, l_nodeCommunicator);
+    MPI_Comm_free(&l_nodeRankCommunicator);
+    MPI_Comm_free(&l_nodeCommunicator);
+
+    // patches require the same number of processes on all nodes
+    MPI_Allreduce(MPI_IN_PLACE, l_processesPerNode, 2, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if( l_processesPerNode[0] == -l_processesPerNode[1] && l_processesPerNode[0] > 1 )
+      l_placement = tools::Decomposition::nodeBlockPosition( l_blocksX, l_blocksY, l_nX, l_nY,
+                                                             l_processesPerNode[0], l_node, l_nodeRank );
+  }
+#endif
+
+  if( l_placement < 0 )
+    l_placement = l_mpiRank;
+
+  //! Cartesian communicator of the process grid, the MPI library may reorder the ranks further
+  MPI_Comm l_communicator;
+  {
+    MPI_Comm l_placedCommunicator;
+    MPI_Comm_split(MPI_COMM_WORLD, 0, l_placement, &l_placedCommunicator);
+
+    int l_dimensions[2] = { l_blocksX, l_blocksY };
+    int l_periods[2] = { 0, 0 };
+    MPI_Cart_create(l_placedCommunicator, 2, l_dimensions, l_periods, 1, &l_communicator);
+    MPI_Comm_free(&l_placedCommunicator);
+  }
+
+  // all communication below uses the rank in the process grid
+  MPI_Comm_rank(l_communicator, &l_mpiRank);
+  tools::Logger::logger.setProcessRank(l_mpiRank);
 
   //! local position of each MPI process in x- and y-direction.
   int l_blockPositionX, l_blockPositionY;
 
   // determine local block coordinates of each SWE_Block
-  l_blockPositionX = l_mpiRank / l_blocksY;
-  l_blockPositionY = l_mpiRank % l_blocksY;
+  int l_coordinates[2];
+  MPI_Cart_coords(l_communicator, l_mpiRank, 2, l_coordinates);
+  l_blockPositionX = l_coordinates[0];
+  l_blockPositionY = l_coordinates[1];
 
   #ifdef ASAGI
   /*
@@ -229,22 +360,88 @@ int main( int argc, char** argv ) {
   #endif
 
   //! number of checkpoints for visualization (at each checkpoint in time, an output file is written).
-  int l_numberOfCheckPoints = args.getArgument<int>("output-steps-count");
-
-  //! number of grid cells in x- and y-direction per process.
-  int l_nXLocal, l_nYLocal;
+  int l_numberOfCheckPoints = args.getArgument<int>("output-steps-count", 20);
 
   //! size of a single cell in x- and y-direction
   float l_dX, l_dY;
 
-  // compute local number of cells for each SWE_Block
-  l_nXLocal = (l_blockPositionX < l_blocksX-1) ? l_nX/l_blocksX : l_nX - (l_blocksX-1)*(l_nX/l_blocksX);
-  l_nYLocal = (l_blockPositionY < l_blocksY-1) ? l_nY/l_blocksY : l_nY - (l_blocksY-1)*(l_nY/l_blocksY);
-
   // compute the size of a single cell
   l_dX = (l_scenario.getBoundaryPos(BND_RIGHT) - l_scenario.getBoundaryPos(BND_LEFT) )/l_nX;
   l_dY = (l_scenario.getBoundaryPos(BND_TOP) - l_scenario.getBoundaryPos(BND_BOTTOM) )/l_nY;
 
+  //! number of ghost layers exchanged with the neighbors at once (deep halo if > 1)
+#ifndef CUDA
+  const int l_haloWidth = args.getArgument<int>("halo-width", 1);
+#else
+  const int l_haloWidth = 1;
+#endif
+
+  //! decomposition of the grid into the blocks of all processes
+  tools::Decomposition l_decomposition(l_nX, l_nY, l_blocksX, l_blocksY);
+
+  //! minimum number of cells of a weighted block in each direction (a deep halo must not exceed the block)
+  const int l_minBlockSize = std::max( 1, std::min(l_haloWidth, std::min(l_nX/l_blocksX, l_nY/l_blocksY)) );
+
+  //! estimated cost of each column and row of cells (uniform unless the wet cells are balanced)
+  std::vector<double> l_columnCosts(l_nX, l_nY), l_rowCosts(l_nY, l_nX);
+
+  const std::string l_decompositionType = args.getArgument<std::string>("decomposition", "uniform");
+  if( args.isSet("decomposition-file") ) {
+    if( !l_decomposition.read( args.getArgument<std::string>("decomposition-file") ) ) {
+      tools::Logger::logger.printString("Could not read the decomposition file or it does not match the grid and the number of processes.");
+      MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+  } else if( l_decompositionType == "wet" ) {
+    // each process evaluates the initial water height of every l_numberOfProcesses-th cell row
+    tools::Decomposition::estimateCosts( l_scenario,
+        l_scenario.getBoundaryPos(BND_LEFT), l_scenario.getBoundaryPos(BND_BOTTOM),
+        l_dX, l_dY,
+        args.getArgument<double>("dry-cell-cost", .25),
+        l_mpiRank, l_numberOfProcesses,
+        l_columnCosts, l_rowCosts );
+    MPI_Allreduce(MPI_IN_PLACE, &l_columnCosts[0], l_nX, MPI_DOUBLE, MPI_SUM, l_communicator);
+    MPI_Allreduce(MPI_IN_PLACE, &l_rowCosts[0], l_nY, MPI_DOUBLE, MPI_SUM, l_communicator);
+
+    l_decomposition.balance( l_columnCosts, l_rowCosts, l_minBlockSize );
+  } else if( l_decompositionType != "uniform" ) {
+    tools::Logger::logger.printString("Unknown decomposition " + l_decompositionType);
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+
+  //! simulated time and number of time steps done before the restart
+  float l_restartTime = 0.f;
+  int l_restartIteration = 0;
+  //! decomposition of the run which wrote the checkpoint
+  std::vector<int> l_restartCutsX, l_restartCutsY;
+
+#ifndef CUDA
+  if( args.isSet("restart") ) {
+    if( !tools::Checkpoint::readHeader( args.getArgument<std::string>("restart"), l_nX, l_nY,
+                                        l_restartTime, l_restartIteration,
+                                        l_restartCutsX, l_restartCutsY, l_communicator ) ) {
+      tools::Logger::logger.printString("Could not read the checkpoint or it does not match the grid.");
+      MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    // with the same process grid, continue with the decomposition rebalanced at the checkpoint
+    // or with the decomposition of the checkpoint (unless a file is given)
+    if( !args.isSet("decomposition-file") ) {
+      if( l_decomposition.read(l_baseName + "_decomposition.txt") )
+        tools::Logger::logger.cout() << "continuing with the rebalanced decomposition "
+                                     << l_baseName << "_decomposition.txt" << std::endl;
+      else
+        l_decomposition.setCuts(l_restartCutsX, l_restartCutsY);
+    }
+  }
+#endif
+
+  //! number of grid cells in x- and y-direction per process.
+  int l_nXLocal, l_nYLocal;
+
+  // compute local number of cells for each SWE_Block
+  l_nXLocal = l_decomposition.getSizeX(l_blockPositionX);
+  l_nYLocal = l_decomposition.getSizeY(l_blockPositionY);
+
   // print information about the cell size and local number of cells
   tools::Logger::logger.printCellSize(l_dX, l_dY);
   tools::Logger::logger.printNumberOfCellsPerProcess(l_nXLocal, l_nYLocal);
@@ -253,13 +450,65 @@ int main( int argc, char** argv ) {
   float l_originX, l_originY;
 
   // get the origin from the scenario
-  l_originX = l_scenario.getBoundaryPos(BND_LEFT) + l_blockPositionX*l_nXLocal*l_dX;;
-  l_originY = l_scenario.getBoundaryPos(BND_BOTTOM) + l_blockPositionY*l_nYLocal*l_dY;
+  l_originX = l_scenario.getBoundaryPos(BND_LEFT) + l_decomposition.getOffsetX(l_blockPositionX)*l_dX;
+  l_originY = l_scenario.getBoundaryPos(BND_BOTTOM) + l_decomposition.getOffsetY(l_blockPositionY)*l_dY;
+
+  if( l_haloWidth < 1 || l_haloWidth > std::min(l_nXLocal, l_nYLocal) ) {
+    tools::Logger::logger.printString("The halo width has to be between 1 and the number of cells per process.");
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+
+  // with a deep halo, the block overlaps its neighbors by l_haloWidth-1 cells, which are computed redundantly
+  const int l_overlapLeft   = (l_blockPositionX > 0)           ? l_haloWidth-1 : 0;
+  const int l_overlapRight  = (l_blockPositionX < l_blocksX-1) ? l_haloWidth-1 : 0;
+  const int l_overlapBottom = (l_blockPositionY > 0)           ? l_haloWidth-1 : 0;
+  const int l_overlapTop    = (l_blockPositionY < l_blocksY-1) ? l_haloWidth-1 : 0;
+
+  //! number of cells of the block (incl. the overlap) in x- and y-direction.
+  const int l_nXBlock = l_nXLocal + l_overlapLeft + l_overlapRight;
+  const int l_nYBlock = l_nYLocal + l_overlapBottom + l_overlapTop;
+
+#ifndef CUDA
+  //! number of cells of a tile in each direction (0: a single block per process)
+  const int l_tileSize = args.getArgument<int>("tile-size", 0);
 
-  // create a single wave propagation block
+  //! tiles above this elevation (and dry) are neither allocated nor computed
+  const float l_landElevation = args.getArgument<float>("land-elevation", std::numeric_limits<float>::max());
+
+  //! skip the tiles at rest?
+  const bool l_activeRegion = args.isSet("active-region");
+#else
+  const int l_tileSize = 0;
+  const float l_landElevation = std::numeric_limits<float>::max();
+#endif
+
+  //! multiple blocks (tiles) per process or skipped land tiles?
+  const bool l_sparse = l_tileSize > 0 || l_landElevation < std::numeric_limits<float>::max();
+  if( l_sparse && (l_haloWidth > 1 || args.isSet("output-windows")) ) {
+    tools::Logger::logger.printString("Tiles cannot be combined with a deep halo or output windows.");
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+
+#ifdef WRITENETCDF
+  //! write a single file with the global grid instead of one file per block?
+  const bool l_singleOutputFile = args.isSet("single-output-file");
+  if( l_sparse && l_singleOutputFile ) {
+    // the collective writes require exactly one block per process
+    tools::Logger::logger.printString("Tiles cannot be combined with a single output file.");
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+  if( l_singleOutputFile && args.isSet("output-delta-keyframes") ) {
+    tools::Logger::logger.printString("Delta-encoded output cannot be combined with a single output file.");
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+#endif
+
+  // create the wave propagation blocks (a single block unless the process is tiled)
   #ifndef CUDA
-  // SWE_WavePropagationBlock l_waveBlock(l_nXLocal,l_nYLocal,l_dX,l_dY);
-  SWE_WaveAccumulationBlock l_waveBlock(l_nXLocal,l_nYLocal,l_dX,l_dY);
+  // SWE_SparseBlockGrid<SWE_WavePropagationBlock> l_grid( ... );
+  SWE_SparseBlockGrid<SWE_WaveAccumulationBlock> l_grid( l_nXBlock, l_nYBlock, l_dX, l_dY,
+      l_originX - l_overlapLeft*l_dX, l_originY - l_overlapBottom*l_dY,
+      l_scenario, l_tileSize, l_landElevation );
   #else
   //! number of CUDA devices per node TODO: hardcoded
   int l_cudaDevicesPerNode = 7;
@@ -269,22 +518,197 @@ int main( int argc, char** argv ) {
 
   SWE_BlockCUDA::init(l_cudaDeviceId);
 
-  SWE_WavePropagationBlockCuda l_waveBlock(l_nXLocal,l_nYLocal,l_dX,l_dY);
+  SWE_SparseBlockGrid<SWE_WavePropagationBlockCuda> l_grid( l_nXBlock, l_nYBlock, l_dX, l_dY,
+      l_originX - l_overlapLeft*l_dX, l_originY - l_overlapBottom*l_dY,
+      l_scenario );
   #endif
 
-  // initialize the wave propgation block
-  l_waveBlock.initScenario(l_originX, l_originY, l_scenario, true);
+  //! tiles of the whole domain, the tiles of each process start at its lower left corner
+  const std::vector<int> l_tileCutsX = tools::Decomposition::tileCuts(l_decomposition.getCutsX(), l_tileSize);
+  const std::vector<int> l_tileCutsY = tools::Decomposition::tileCuts(l_decomposition.getCutsY(), l_tileSize);
+  const int l_tilesX = l_tileCutsX.size()-1, l_tilesY = l_tileCutsY.size()-1;
+
+  //! position of the first tile of this process in the whole domain
+  const int l_firstTileX = std::lower_bound( l_tileCutsX.begin(), l_tileCutsX.end(),
+                                             l_decomposition.getOffsetX(l_blockPositionX) ) - l_tileCutsX.begin();
+  const int l_firstTileY = std::lower_bound( l_tileCutsY.begin(), l_tileCutsY.end(),
+                                             l_decomposition.getOffsetY(l_blockPositionY) ) - l_tileCutsY.begin();
+
+  //! allocated tiles of all processes (column-major), required at the edges of the processes
+  std::vector<int> l_activeTiles(l_tilesX*l_tilesY, 0);
+  for (int i = 0; i < l_grid.getTilesX(); i++)
+    for (int j = 0; j < l_grid.getTilesY(); j++)
+      if (l_grid.getTile(i, j) != 0)
+        l_activeTiles[(l_firstTileX+i)*l_tilesY + l_firstTileY+j] = 1;
+  MPI_Allreduce(MPI_IN_PLACE, &l_activeTiles[0], l_tilesX*l_tilesY, MPI_INT, MPI_MAX, l_communicator);
+
+  if( l_sparse )
+    tools::Logger::logger.cout() << "allocated cells: " << l_grid.getNumberOfActiveCells()
+                                 << " of " << (long) l_nXBlock*l_nYBlock << std::endl;
+
+#ifndef CUDA
+  //! writes the checkpoints and restores the blocks at a restart
+  tools::Checkpoint* l_checkpoint = 0;
+
+  //! file of the checkpoints, empty if no checkpoints are written
+  const std::string l_checkpointFile = args.getArgument<std::string>("checkpoint-file", "");
+
+  if( !l_checkpointFile.empty() || args.isSet("restart") ) {
+    l_checkpoint = new tools::Checkpoint( l_nX, l_nY,
+        l_decomposition.getOffsetX(l_blockPositionX), l_decomposition.getOffsetY(l_blockPositionY),
+        l_nXLocal, l_nYLocal, l_communicator );
+
+    for (int i = 0; i < l_grid.getTilesX(); i++)
+      for (int j = 0; j < l_grid.getTilesY(); j++)
+        if (l_grid.getTile(i, j) != 0)
+          l_checkpoint->addBlock( *l_grid.getTile(i, j),
+                                  l_tileCutsX[l_firstTileX+i] - l_overlapLeft, l_tileCutsY[l_firstTileY+j] - l_overlapBottom );
+  }
+
+  if( args.isSet("restart") ) {
+    // each process reads the cells of its blocks (incl. the overlap)
+    l_checkpoint->read( args.getArgument<std::string>("restart"),
+                        l_restartCutsX.size()-1, l_restartCutsY.size()-1 );
+    tools::Logger::logger.cout() << "restarted at time " << l_restartTime
+                                 << " after " << l_restartIteration << " time steps" << std::endl;
+  }
+
+  //! minimum wall clock time between two checkpoints
+  const double l_checkpointInterval = args.getArgument<double>("checkpoint-interval", 0.);
+  //! wall clock time of the last checkpoint
+  double l_checkpointWallTime = MPI_Wtime();
+  //! output written since the last checkpoint (checkpoints after outputs)
+  bool l_checkpointPending = false;
+#endif
 
   //! time when the simulation ends.
-  float l_endSimulation = l_scenario.endSimulation();
+  float l_endSimulation = args.getArgument<float>("end-time", l_scenario.endSimulation());
+
+  //! decides when output files are written.
+  tools::OutputScheduler l_outputScheduler( l_restartTime, l_endSimulation,
+    args.getArgument<float>("output-interval", l_endSimulation/l_numberOfCheckPoints),
+    args.getArgument<float>("output-wall-fraction", 1.f),
+    args.getArgument<float>("output-event-threshold", 0.f) );
+
+#ifndef CUDA
+  //! reduce the time step in the background?
+  const bool l_overlapTimestepReduction = args.isSet("overlap-timestep-reduction");
+
+  //! factor of the time step between two exchanges of a deep halo
+  const float l_haloTimestepFactor = args.getArgument<float>("halo-timestep-factor", .75f);
+  if( l_haloTimestepFactor <= 0.f || l_haloTimestepFactor > 1.f ) {
+    tools::Logger::logger.printString("The halo time step factor has to be in (0, 1].");
+    MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+#endif
+
+#if !defined(CUDA) && defined(_OPENMP)
+  //! progress the halo exchange by a dedicated thread?
+  const bool l_progressThread = args.isSet("progress-thread");
+
+  //! threads computing the inner fluxes next to the progress thread
+  int l_computeThreads = std::max(1, omp_get_max_threads()-1);
+#ifndef LOOP_OPENMP
+  // the tiles are computed in parallel, the loops of a single block are not:
+  // the inner fluxes of a single tile are computed by one thread next to the progress thread
+  if( l_grid.getTilesX()*l_grid.getTilesY() == 1 )
+    l_computeThreads = 1;
+#endif
+  if( l_progressThread ) {
+    // the compute threads form a nested team
+    omp_set_max_active_levels(2);
+    tools::Logger::logger.cout() << "progress thread and " << l_computeThreads << " compute threads" << std::endl;
+  }
+#endif
 
-  //! checkpoints when output files are written.
-  float* l_checkPoints = new float[l_numberOfCheckPoints+1];
+  //! MPI ranks of the neighbors
+  int l_leftNeighborRank, l_rightNeighborRank, l_bottomNeighborRank, l_topNeighborRank;
+
+  // compute MPI ranks of the neighbour processes (MPI_PROC_NULL at the domain boundary)
+  MPI_Cart_shift(l_communicator, 0, 1, &l_leftNeighborRank, &l_rightNeighborRank);
+  MPI_Cart_shift(l_communicator, 1, 1, &l_bottomNeighborRank, &l_topNeighborRank);
+
+  // print the MPI grid
+  tools::Logger::logger.cout() << "neighbors: "
+                     << l_leftNeighborRank << " (left), "
+                     << l_rightNeighborRank << " (right), "
+                     << l_bottomNeighborRank << " (bottom), "
+                     << l_topNeighborRank << " (top)" << std::endl;
+
+  const int l_neighborRanks[4] = { l_leftNeighborRank, l_rightNeighborRank, l_bottomNeighborRank, l_topNeighborRank };
+
+  // outflow at the boundary of the simulation domain
+  for (int l_edge = 0; l_edge < 4; l_edge++)
+    if (l_neighborRanks[l_edge] == MPI_PROC_NULL)
+      l_grid.setBoundaryType(BoundaryEdge(l_edge), OUTFLOW);
+
+#ifndef CUDA
+  /*
+   * Connect the tiles at the edges of the process with the tiles of the neighbors:
+   * the ghost layers are exchanged with allocated tiles, land tiles of the neighbor are reflecting.
+   */
+  tools::Logger::logger.printString("Connecting SWE blocks at the boundaries.");
+
+  //! packed, persistent exchange of the ghost layers, one per tile at the edge of the process
+  std::vector<tools::HaloExchange*> l_haloExchanges;
+
+  for (int i = 0; i < l_grid.getTilesX(); i++)
+    for (int j = 0; j < l_grid.getTilesY(); j++) {
+      SWE_Block* l_tile = l_grid.getTile(i, j);
+      if (l_tile == 0)
+        continue;
+
+      int l_tileNeighborRanks[4] = { MPI_PROC_NULL, MPI_PROC_NULL, MPI_PROC_NULL, MPI_PROC_NULL };
+      bool l_connected = false;
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        if (l_neighborRanks[l_edge] == MPI_PROC_NULL || !l_grid.isOuterEdge(i, j, BoundaryEdge(l_edge)))
+          continue;
+
+        const int l_neighborTileX = l_firstTileX + i + (l_edge == BND_RIGHT) - (l_edge == BND_LEFT);
+        const int l_neighborTileY = l_firstTileY + j + (l_edge == BND_TOP) - (l_edge == BND_BOTTOM);
+
+        if (l_activeTiles[l_neighborTileX*l_tilesY + l_neighborTileY]) {
+          l_tile->setBoundaryType(BoundaryEdge(l_edge), PASSIVE);
+          l_tileNeighborRanks[l_edge] = l_neighborRanks[l_edge];
+          l_connected = true;
+        } else
+          l_tile->setBoundaryType(BoundaryEdge(l_edge), WALL);
+      }
+
+      if (l_connected) {
+        l_haloExchanges.push_back( new tools::HaloExchange( *l_tile, l_tileNeighborRanks, l_haloWidth, i, j, l_communicator ) );
+        l_grid.setExchangedTile(i, j);
+      }
+    }
 
-  // compute the checkpoints in time
-  for(int cp = 0; cp <= l_numberOfCheckPoints; cp++) {
-     l_checkPoints[cp] = cp*(l_endSimulation/l_numberOfCheckPoints);
+  // the water surface of the scenarios is at zero where the ocean is at rest
+  if( l_activeRegion )
+    l_grid.setActiveRegionTracking(0.f);
+
+#if MPI_VERSION >= 3
+  // neighbors on the same node read the ghost layers from a shared memory window
+  tools::SharedHaloWindow* l_sharedHaloWindow = 0;
+  if( !args.isSet("no-shared-memory-halo") ) {
+    l_sharedHaloWindow = new tools::SharedHaloWindow(l_haloExchanges, l_communicator);
+    tools::Logger::logger.cout() << "edges exchanged in shared memory: "
+                                 << l_sharedHaloWindow->getNumberOfSharedEdges() << std::endl;
   }
+#endif
+
+  //! time step of a deep halo, fixed between two exchanges
+  float l_haloTimeStepWidth = 0.f;
+  //! time steps since the last exchange of the deep halo
+  int l_cycleStep = 0;
+  //! number of cycles of the deep halo restarted because the time step was too large
+  unsigned int l_cycleRestarts = 0;
+
+  // intially exchange ghost and copy layers
+  startHaloExchanges(l_haloExchanges);
+  waitHaloExchanges(l_haloExchanges);
+#else
+  //! the single block of the process
+  SWE_WavePropagationBlockCuda &l_waveBlock = *l_grid.getTile(0, 0);
 
   /*
    * Connect SWE blocks at boundaries
@@ -344,77 +768,137 @@ int main( int argc, char** argv ) {
    *     See SWE_BlockCUDA.hh/.cu for details.
    *  -> The stride for a column is 1, because we can access the elements linear in memory.
    */
-  //! MPI row-vector: l_nXLocal+2 blocks, 1 element per block, stride of l_nYLocal+2
+  //! MPI row-vector: l_nXBlock+2 blocks, 1 element per block, stride of l_nYBlock+2
   MPI_Datatype l_mpiRow;
-  #ifndef CUDA
-  MPI_Type_vector(l_nXLocal+2, 1          , l_nYLocal+2, MPI_FLOAT, &l_mpiRow);
-  #else
-  MPI_Type_vector(1,           l_nXLocal+2, 1          , MPI_FLOAT, &l_mpiRow);
-  #endif
+  MPI_Type_vector(1,           l_nXBlock+2, 1          , MPI_FLOAT, &l_mpiRow);
   MPI_Type_commit(&l_mpiRow);
 
-  //! MPI row-vector: 1 block, l_nYLocal+2 elements per block, stride of 1
+  //! MPI row-vector: 1 block, l_nYBlock+2 elements per block, stride of 1
   MPI_Datatype l_mpiCol;
-  MPI_Type_vector(1,           l_nYLocal+2, 1,           MPI_FLOAT, &l_mpiCol);
+  MPI_Type_vector(1,           l_nYBlock+2, 1,           MPI_FLOAT, &l_mpiCol);
   MPI_Type_commit(&l_mpiCol);
 
-  //! MPI ranks of the neighbors
-  int l_leftNeighborRank, l_rightNeighborRank, l_bottomNeighborRank, l_topNeighborRank;
-
-  // compute MPI ranks of the neighbour processes
-  l_leftNeighborRank   = (l_blockPositionX > 0) ? l_mpiRank-l_blocksY : MPI_PROC_NULL;
-  l_rightNeighborRank  = (l_blockPositionX < l_blocksX-1) ? l_mpiRank+l_blocksY : MPI_PROC_NULL;
-  l_bottomNeighborRank = (l_blockPositionY > 0) ? l_mpiRank-1 : MPI_PROC_NULL;
-  l_topNeighborRank    = (l_blockPositionY < l_blocksY-1) ? l_mpiRank+1 : MPI_PROC_NULL;
-
-  // print the MPI grid
-  tools::Logger::logger.cout() << "neighbors: "
-                     << l_leftNeighborRank << " (left), "
-                     << l_rightNeighborRank << " (right), "
-                     << l_bottomNeighborRank << " (bottom), "
-                     << l_topNeighborRank << " (top)" << std::endl;
-
   // intially exchange ghost and copy layers
   exchangeLeftRightGhostLayers( l_leftNeighborRank,  l_leftInflow,  l_leftOutflow,
                   l_rightNeighborRank, l_rightInflow, l_rightOutflow,
-                  l_mpiCol );
+                  l_mpiCol, l_communicator );
 
   exchangeBottomTopGhostLayers( l_bottomNeighborRank, l_bottomInflow, l_bottomOutflow,
                   l_topNeighborRank,    l_topInflow,    l_topOutflow,
-                  l_mpiRow );
+                  l_mpiRow, l_communicator );
+#endif
 
   // Init fancy progressbar
   tools::ProgressBar progressBar(l_endSimulation, l_mpiRank);
 
   // write the output at time zero
-  tools::Logger::logger.printOutputTime(0);
-  progressBar.update(0.);
+  tools::Logger::logger.printOutputTime(l_restartTime);
+  progressBar.update(l_restartTime);
+
+  //boundary size of the ghost layers and the overlap
+  io::BoundarySize l_boundarySize = {{1 + l_overlapLeft, 1 + l_overlapRight, 1 + l_overlapBottom, 1 + l_overlapTop}};
+
+  //! output writers of the tiles (column-major), 0 for land tiles
+  std::vector<io::Writer*> l_writers(l_grid.getTilesX()*l_grid.getTilesY(), 0);
+
+#ifndef WRITENETCDF
+  //! position of the first allocated tile of the domain, its process writes the ParaView container
+  const int l_containerTile = std::find(l_activeTiles.begin(), l_activeTiles.end(), 1) - l_activeTiles.begin();
+#endif
+
+  for (int i = 0; i < l_grid.getTilesX(); i++)
+    for (int j = 0; j < l_grid.getTilesY(); j++) {
+      SWE_Block* l_tile = l_grid.getTile(i, j);
+      if (l_tile == 0)
+        continue;
+
+      std::string l_fileName = generateBaseFileName(l_baseName, l_firstTileX+i, l_firstTileY+j);
+      if( args.isSet("output-delta-keyframes") ) {
+        // delta-encoded output of the tile, see io::DeltaReader
+        l_writers[i*l_grid.getTilesY() + j] = new io::DeltaWriter( l_fileName,
+            l_tile->getBathymetry(),
+            l_boundarySize,
+            l_grid.getTileNx(i) - l_overlapLeft - l_overlapRight, l_grid.getTileNy(j) - l_overlapBottom - l_overlapTop,
+            l_dX, l_dY,
+            l_grid.getTileOriginX(i) + l_overlapLeft*l_dX, l_grid.getTileOriginY(j) + l_overlapBottom*l_dY,
+            args.getArgument<unsigned int>("output-delta-keyframes"),
+            args.getArgument<float>("output-delta-tolerance", 1e-3f) );
+        continue;
+      }
 
-  std::string l_fileName = generateBaseFileName(l_baseName,l_blockPositionX,l_blockPositionY);
-  //boundary size of the ghost layers
-  io::BoundarySize l_boundarySize = {{1, 1, 1, 1}};
 #ifdef WRITENETCDF
-  //construct a NetCdfWriter
-  io::NetCdfWriter l_writer( l_fileName,
-		  l_waveBlock.getBathymetry(),
-		  l_boundarySize,
-		  l_nXLocal, l_nYLocal,
-		  l_dX, l_dY,
-          l_originX, l_originY );
+      if( l_singleOutputFile ) {
+        // all processes write their block into the global grid of one file
+        l_writers[i*l_grid.getTilesY() + j] = new io::NetCdfWriter( l_baseName,
+            l_tile->getBathymetry(),
+            l_boundarySize,
+            l_nXLocal, l_nYLocal,
+            l_dX, l_dY,
+            l_decomposition.getOffsetX(l_blockPositionX), l_decomposition.getOffsetY(l_blockPositionY),
+            l_nX, l_nY,
+            l_scenario.getBoundaryPos(BND_LEFT), l_scenario.getBoundaryPos(BND_BOTTOM),
+            l_communicator );
+        continue;
+      }
+
+      //construct a NetCdfWriter
+      l_writers[i*l_grid.getTilesY() + j] = new io::NetCdfWriter( l_fileName,
+          l_tile->getBathymetry(),
+          l_boundarySize,
+          l_grid.getTileNx(i) - l_overlapLeft - l_overlapRight, l_grid.getTileNy(j) - l_overlapBottom - l_overlapTop,
+          l_dX, l_dY,
+          l_grid.getTileOriginX(i) + l_overlapLeft*l_dX, l_grid.getTileOriginY(j) + l_overlapBottom*l_dY );
 #else
-  // Construct a VtkWriter
-  io::VtkWriter l_writer( l_fileName,
-		  l_waveBlock.getBathymetry(),
-		  l_boundarySize,
-		  l_nXLocal, l_nYLocal,
-		  l_dX, l_dY,
-		  l_blockPositionX*l_nXLocal, l_blockPositionY*l_nYLocal );
+      // Construct a VtkWriter
+      io::VtkWriter* l_writer = new io::VtkWriter( l_fileName,
+          l_tile->getBathymetry(),
+          l_boundarySize,
+          l_grid.getTileNx(i) - l_overlapLeft - l_overlapRight, l_grid.getTileNy(j) - l_overlapBottom - l_overlapTop,
+          l_dX, l_dY,
+          l_tileCutsX[l_firstTileX+i], l_tileCutsY[l_firstTileY+j] );
+      if ((l_firstTileX+i)*l_tilesY + l_firstTileY+j == l_containerTile)
+        l_writer->setContainer( l_baseName, l_tileCutsX, l_tileCutsY,
+                                std::vector<bool>(l_activeTiles.begin(), l_activeTiles.end()) );
+      l_writers[i*l_grid.getTilesY() + j] = l_writer;
 #endif
+    }
+
   // Write zero time step
-  l_writer.writeTimeStep( l_waveBlock.getWaterHeight(),
-                          l_waveBlock.getDischarge_hu(),
-                          l_waveBlock.getDischarge_hv(),
-                          (float) 0.);
+  l_outputScheduler.beginOutput();
+  for (size_t l_tile = 0; l_tile < l_writers.size(); l_tile++) {
+    if (l_writers[l_tile] == 0)
+      continue;
+
+    SWE_Block &l_block = *l_grid.getTile(l_tile / l_grid.getTilesY(), l_tile % l_grid.getTilesY());
+    l_writers[l_tile]->writeTimeStep( l_block.getWaterHeight(),
+                                      l_block.getDischarge_hu(),
+                                      l_block.getDischarge_hv(),
+                                      l_restartTime);
+    l_outputScheduler.storeSurface( l_block.getWaterHeight(),
+                                    l_block.getBathymetry(), l_tile );
+  }
+  l_outputScheduler.endOutput();
+
+#ifdef WRITENETCDF
+  // output windows (regions of interest), each rank writes its part of a window (a single block only)
+  io::RegionOutput* l_regionOutput = 0;
+  if( args.isSet("output-windows") ) {
+    SWE_Block &l_block = *l_grid.getTile(0, 0);
+    l_regionOutput = new io::RegionOutput( generateBaseFileName(l_baseName,l_blockPositionX,l_blockPositionY),
+        l_block.getBathymetry(),
+        l_boundarySize,
+        l_nXLocal, l_nYLocal,
+        l_dX, l_dY,
+        l_originX, l_originY,
+        l_restartTime, l_endSimulation,
+        io::RegionOutput::readWindows( args.getArgument<std::string>("output-windows") ) );
+    l_regionOutput->writeTimeStep( l_block.getWaterHeight(),
+                                   l_block.getDischarge_hu(),
+                                   l_block.getDischarge_hv(),
+                                   l_restartTime );
+  }
+#endif
+
   /**
    * Simulation.
    */
@@ -423,69 +907,282 @@ int main( int argc, char** argv ) {
   tools::Logger::logger.printStartMessage();
   tools::Logger::logger.initWallClockTime(time(NULL));
 
+  // start the timers at zero, the time step loop does not run after a restart at the end time
+  tools::Logger::logger.resetClockToCurrentTime("Cpu");
+  tools::Logger::logger.updateTime("Cpu");
+  tools::Logger::logger.resetClockToCurrentTime("CpuCommunication");
+  tools::Logger::logger.updateTime("CpuCommunication");
+
   //! simulation time.
-  float l_t = 0.0;
+  float l_t = l_restartTime;
   progressBar.update(l_t);
 
-  unsigned int l_iterations = 0;
+  unsigned int l_iterations = l_restartIteration;
 
-  // loop over checkpoints
-  for(int c=1; c<=l_numberOfCheckPoints; c++) {
+  //! imbalance of the compute times (max/mean - 1) which triggers a rebalanced decomposition
+  const double l_rebalanceThreshold = args.getArgument<double>("rebalance-threshold", .1);
+  //! cpu time of this process at the last checkpoint
+  double l_checkpointCpuTime = 0.;
 
-    // do time steps until next checkpoint is reached
-    while( l_t < l_checkPoints[c] ) {
-      //reset CPU-Communication clock
-      tools::Logger::logger.resetClockToCurrentTime("CpuCommunication");
+  // do time steps until the end of the simulation is reached
+  while( !l_outputScheduler.isFinished(l_t) ) {
+    //reset CPU-Communication clock
+    tools::Logger::logger.resetClockToCurrentTime("CpuCommunication");
 
-      // exchange ghost and copy layers
-      exchangeLeftRightGhostLayers( l_leftNeighborRank,  l_leftInflow,  l_leftOutflow,
-                      l_rightNeighborRank, l_rightInflow, l_rightOutflow,
-                      l_mpiCol );
+    //! maximum allowed time steps of all blocks
+    float l_maxTimeStepWidthGlobal;
 
-      exchangeBottomTopGhostLayers( l_bottomNeighborRank, l_bottomInflow, l_bottomOutflow,
-                      l_topNeighborRank,    l_topInflow,    l_topOutflow,
-                      l_mpiRow );
+#ifndef CUDA
+    //! background reduction of the time step
+    MPI_Request l_timestepRequest = MPI_REQUEST_NULL;
+    //! largest particle velocity and celerity of this process and of all processes
+    float l_waveSpeedBounds[2], l_waveSpeedBoundsGlobal[2];
+
+    if( l_haloWidth > 1 ) {
+      if( l_cycleStep == 0 ) {
+        // exchange the deep halo, all cells of the block are valid afterwards
+        startHaloExchanges(l_haloExchanges);
+        waitHaloExchanges(l_haloExchanges);
+
+        // the invalid layers grow by one cell per step and reach the own cells after l_haloWidth steps:
+        // fix the time step of the cycle up front; the wave speed bound (see below) holds for the first
+        // step, the following steps are checked against the time step of their fluxes
+        l_grid.computeWaveSpeedBounds(l_waveSpeedBounds[0], l_waveSpeedBounds[1]);
+        MPI_Allreduce(l_waveSpeedBounds, l_waveSpeedBoundsGlobal, 2, MPI_FLOAT, MPI_MAX, l_communicator);
+        l_haloTimeStepWidth = boundedTimestep(l_waveSpeedBoundsGlobal, l_dX, l_dY) * l_haloTimestepFactor;
+      }
 
       // reset the cpu clock
       tools::Logger::logger.resetClockToCurrentTime("Cpu");
 
-      // set values in ghost cells
-      l_waveBlock.setGhostLayer();
+      // set values in ghost cells at the domain boundary
+      l_grid.setGhostLayer();
 
-      // compute numerical flux on each edge
-      l_waveBlock.computeNumericalFluxes();
+      // compute numerical flux on each edge (incl. the overlap)
+      l_grid.computeNumericalFluxes();
+    } else {
+      if( l_overlapTimestepReduction ) {
+        // the cell-based time step (computeMaxTimestep()) ignores shallow cells and may exceed the
+        // time step of the fluxes; the wave speed bounds (all wet cells) do not, the sum of their global
+        // maxima bounds the speeds of all edges and can be reduced before the fluxes are known
+        l_grid.computeWaveSpeedBounds(l_waveSpeedBounds[0], l_waveSpeedBounds[1]);
+        MPI_Iallreduce(l_waveSpeedBounds, l_waveSpeedBoundsGlobal, 2, MPI_FLOAT, MPI_MAX, l_communicator, &l_timestepRequest);
+      }
 
-      //! maximum allowed time step width within a block.
-      float l_maxTimeStepWidth = l_waveBlock.getMaxTimestep();
+      // start the exchange of ghost and copy layers
+      startHaloExchanges(l_haloExchanges);
+
+      // reset the cpu clock
+      tools::Logger::logger.resetClockToCurrentTime("Cpu");
+
+      // compute numerical flux on the edges which do not depend on the ghost layers
+#ifdef _OPENMP
+      if( l_progressThread ) {
+        //! set by the compute threads after the inner fluxes
+        int l_computed = 0;
+
+        #pragma omp parallel num_threads(2)
+        {
+          if( omp_get_thread_num() == 0 ) {
+            // the main thread (MPI_THREAD_FUNNELED) progresses the messages until the inner fluxes are done
+            bool l_communicated = false;
+            int l_done = 0;
+            while( !l_done ) {
+              if( !l_communicated ) {
+                int l_reduced = 1;
+                if( l_timestepRequest != MPI_REQUEST_NULL )
+                  MPI_Test(&l_timestepRequest, &l_reduced, MPI_STATUS_IGNORE);
+                l_communicated = testHaloExchanges(l_haloExchanges) && l_reduced;
+              }
+
+              #pragma omp atomic read
+              l_done = l_computed;
+            }
+          } else {
+            omp_set_num_threads(l_computeThreads);
+            l_grid.computeInnerNumericalFluxes();
+
+            #pragma omp atomic write
+            l_computed = 1;
+          }
+        }
+      } else
+#endif
+      l_grid.computeInnerNumericalFluxes();
 
       // update the cpu time in the logger
       tools::Logger::logger.updateTime("Cpu");
 
-      //! maximum allowed time steps of all blocks
-      float l_maxTimeStepWidthGlobal;
+      // wait for the ghost layers
+      waitHaloExchanges(l_haloExchanges);
 
-      // determine smallest time step of all blocks
-      MPI_Allreduce(&l_maxTimeStepWidth, &l_maxTimeStepWidthGlobal, 1, MPI_FLOAT, MPI_MIN, MPI_COMM_WORLD);
-
-      // reset the cpu time
+      // reset the cpu clock
       tools::Logger::logger.resetClockToCurrentTime("Cpu");
 
-      // update the cell values
-      l_waveBlock.updateUnknowns(l_maxTimeStepWidthGlobal);
+      // set values in ghost cells (incl. the edges between the tiles)
+      l_grid.setGhostLayer();
 
-      // update the cpu and CPU-communication time in the logger
-      tools::Logger::logger.updateTime("Cpu");
-      tools::Logger::logger.updateTime("CpuCommunication");
+      // compute numerical flux on the edges next to the ghost layers
+      l_grid.computeOuterNumericalFluxes();
+    }
+#else
+    // exchange ghost and copy layers
+    exchangeLeftRightGhostLayers( l_leftNeighborRank,  l_leftInflow,  l_leftOutflow,
+                    l_rightNeighborRank, l_rightInflow, l_rightOutflow,
+                    l_mpiCol, l_communicator );
+
+    exchangeBottomTopGhostLayers( l_bottomNeighborRank, l_bottomInflow, l_bottomOutflow,
+                    l_topNeighborRank,    l_topInflow,    l_topOutflow,
+                    l_mpiRow, l_communicator );
+
+    // reset the cpu clock
+    tools::Logger::logger.resetClockToCurrentTime("Cpu");
+
+    // set values in ghost cells
+    l_grid.setGhostLayer();
+
+    // compute numerical flux on each edge
+    l_grid.computeNumericalFluxes();
+#endif
+
+    //! maximum allowed time step width within a block.
+    float l_maxTimeStepWidth = l_grid.getMaxTimestep();
+
+    // update the cpu time in the logger
+    tools::Logger::logger.updateTime("Cpu");
+
+#ifndef CUDA
+    if( l_haloWidth > 1 && l_cycleStep > 0 ) {
+      // the waves may have accelerated since the exchange: if the time step of the cycle is too large
+      // for the fluxes of any process, restart the cycle (exchange the halo, recompute the time step)
+      int l_exceeded = ( l_maxTimeStepWidth < l_haloTimeStepWidth );
+      MPI_Allreduce(MPI_IN_PLACE, &l_exceeded, 1, MPI_INT, MPI_LOR, l_communicator);
+
+      if( l_exceeded ) {
+        tools::Logger::logger.updateTime("CpuCommunication");
+        l_cycleStep = 0;
+        l_cycleRestarts++;
+        continue;
+      }
+    }
+#endif
+
+    // determine smallest time step of all blocks
+#ifndef CUDA
+    if( l_haloWidth > 1 )
+      l_maxTimeStepWidthGlobal = l_haloTimeStepWidth;
+    else if( l_overlapTimestepReduction ) {
+      MPI_Wait(&l_timestepRequest, MPI_STATUS_IGNORE);
+      l_maxTimeStepWidthGlobal = boundedTimestep(l_waveSpeedBoundsGlobal, l_dX, l_dY);
+
+      // the bound may exceed the time step of the fluxes by round-off only
+      assert( l_maxTimeStepWidthGlobal <= l_maxTimeStepWidth * 1.0001f );
+    } else
+#endif
+      MPI_Allreduce(&l_maxTimeStepWidth, &l_maxTimeStepWidthGlobal, 1, MPI_FLOAT, MPI_MIN, l_communicator);
+
+    // hit the next output time exactly (the same on all ranks)
+    l_maxTimeStepWidthGlobal = l_outputScheduler.clipTimestep(l_t, l_maxTimeStepWidthGlobal);
+#ifdef WRITENETCDF
+    if( l_regionOutput != 0 )
+      l_maxTimeStepWidthGlobal = l_regionOutput->clipTimestep(l_t, l_maxTimeStepWidthGlobal);
+#endif
+
+    // reset the cpu time
+    tools::Logger::logger.resetClockToCurrentTime("Cpu");
+
+    // update the cell values
+    l_grid.updateUnknowns(l_maxTimeStepWidthGlobal);
+
+    // update the cpu and CPU-communication time in the logger
+    tools::Logger::logger.updateTime("Cpu");
+    tools::Logger::logger.updateTime("CpuCommunication");
 
-      // update simulation time with time step width.
-      l_t += l_maxTimeStepWidthGlobal;
-      l_iterations++;
+    // update simulation time with time step width.
+    l_t += l_maxTimeStepWidthGlobal;
+    l_iterations++;
+#ifndef CUDA
+    l_cycleStep = (l_cycleStep + 1) % l_haloWidth;
+#endif
+
+    // print the current simulation time
+    progressBar.clear();
+    tools::Logger::logger.printSimulationTime(l_t);
+    progressBar.update(l_t);
+
+#ifdef WRITENETCDF
+    // write the output windows which are due
+    if( l_regionOutput != 0 )
+      l_regionOutput->writeTimeStep( l_grid.getTile(0, 0)->getWaterHeight(),
+                                     l_grid.getTile(0, 0)->getDischarge_hu(),
+                                     l_grid.getTile(0, 0)->getDischarge_hv(),
+                                     l_t );
+#endif
+
+    //! maximum change of the water surface since the last output (event trigger only)
+    float l_surfaceChange = 0.f;
+    if( l_outputScheduler.hasEventTrigger() )
+      for (size_t l_tile = 0; l_tile < l_writers.size(); l_tile++)
+        if (l_writers[l_tile] != 0) {
+          SWE_Block &l_block = *l_grid.getTile(l_tile / l_grid.getTilesY(), l_tile % l_grid.getTilesY());
+          l_surfaceChange = std::max( l_surfaceChange,
+                                      l_outputScheduler.computeSurfaceChange( l_block.getWaterHeight(),
+                                                                              l_block.getBathymetry(), l_tile ) );
+        }
+
+    //! write an output file in this time step?
+    int l_outputDue = l_outputScheduler.isOutputDue(l_t, l_surfaceChange);
+
+    // events and the wall clock budget are evaluated locally: all ranks write if one rank does
+    if( !l_outputScheduler.isDeterministic() )
+      MPI_Allreduce(MPI_IN_PLACE, &l_outputDue, 1, MPI_INT, MPI_MAX, l_communicator);
 
-      // print the current simulation time
-      progressBar.clear();
-      tools::Logger::logger.printSimulationTime(l_t);
-      progressBar.update(l_t);
+#ifndef CUDA
+    // write a checkpoint in the background once per interval (the first process decides) or, without an
+    // interval, after an output; with a deep halo only at the end of a cycle, since the time step of a
+    // cycle is not part of the checkpoint
+    if( !l_checkpointFile.empty() ) {
+      l_checkpointPending = l_checkpointPending || l_outputDue;
+
+      if( l_cycleStep == 0 ) {
+        int l_checkpointDue = l_checkpointPending;
+        if( l_checkpointInterval > 0. ) {
+          l_checkpointDue = ( MPI_Wtime() - l_checkpointWallTime >= l_checkpointInterval );
+          MPI_Bcast(&l_checkpointDue, 1, MPI_INT, 0, l_communicator);
+        }
+
+        if( l_checkpointDue ) {
+          l_checkpoint->write(l_checkpointFile, l_t, l_iterations, l_decomposition);
+          l_checkpointWallTime = MPI_Wtime();
+          l_checkpointPending = false;
+
+          // rebalance with the compute times since the last checkpoint: the blocks are not migrated during
+          // the run (the output files have fixed block sizes), a restart continues with the new decomposition
+          //! compute time of this process since the last checkpoint
+          double l_blockTime = tools::Logger::logger.getTime("Cpu") - l_checkpointCpuTime;
+          l_checkpointCpuTime += l_blockTime;
+
+          //! compute times of all processes
+          std::vector<double> l_blockTimes(l_numberOfProcesses);
+          MPI_Gather(&l_blockTime, 1, MPI_DOUBLE, &l_blockTimes[0], 1, MPI_DOUBLE, 0, l_communicator);
+
+          const double l_imbalance = tools::Decomposition::imbalance(l_blockTimes);
+          if( l_mpiRank == 0 && l_imbalance > 1. + l_rebalanceThreshold ) {
+            tools::Decomposition l_rebalanced(l_decomposition);
+            l_rebalanced.rebalance(l_columnCosts, l_rowCosts, l_blockTimes, l_minBlockSize);
+            l_rebalanced.write(l_baseName + "_decomposition.txt");
+
+            tools::Logger::logger.cout() << "compute time imbalance " << l_imbalance
+                                         << ", rebalanced decomposition written to "
+                                         << l_baseName << "_decomposition.txt" << std::endl;
+          }
+        }
+      }
     }
+#endif
+
+    if( !l_outputDue )
+      continue;
 
     // print current simulation time
     progressBar.clear();
@@ -493,10 +1190,21 @@ int main( int argc, char** argv ) {
     progressBar.update(l_t);
 
     // write output
-    l_writer.writeTimeStep( l_waveBlock.getWaterHeight(),
-                            l_waveBlock.getDischarge_hu(),
-                            l_waveBlock.getDischarge_hv(),
-                            l_t);
+    l_outputScheduler.beginOutput();
+    for (size_t l_tile = 0; l_tile < l_writers.size(); l_tile++) {
+      if (l_writers[l_tile] == 0)
+        continue;
+
+      SWE_Block &l_block = *l_grid.getTile(l_tile / l_grid.getTilesY(), l_tile % l_grid.getTilesY());
+      l_writers[l_tile]->writeTimeStep( l_block.getWaterHeight(),
+                                        l_block.getDischarge_hu(),
+                                        l_block.getDischarge_hv(),
+                                        l_t);
+      l_outputScheduler.storeSurface( l_block.getWaterHeight(),
+                                      l_block.getBathymetry(), l_tile );
+    }
+    l_outputScheduler.endOutput();
+
   }
 
   /**
@@ -509,6 +1217,23 @@ int main( int argc, char** argv ) {
 
   progressBar.clear();
 
+  for (size_t l_tile = 0; l_tile < l_writers.size(); l_tile++)
+    delete l_writers[l_tile];
+#ifndef CUDA
+  for (size_t l_exchange = 0; l_exchange < l_haloExchanges.size(); l_exchange++)
+    delete l_haloExchanges[l_exchange];
+#if MPI_VERSION >= 3
+  delete l_sharedHaloWindow;
+#endif
+#endif
+#ifdef WRITENETCDF
+  delete l_regionOutput;
+#endif
+#ifndef CUDA
+  // completes the last checkpoint
+  delete l_checkpoint;
+#endif
+
   // write the statistics message
   tools::Logger::logger.printStatisticsMessage();
 
@@ -523,10 +1248,16 @@ int main( int argc, char** argv ) {
 
   // printer iteration counter
   tools::Logger::logger.printIterationsDone(l_iterations);
+#ifndef CUDA
+  if( l_haloWidth > 1 )
+    tools::Logger::logger.cout() << l_cycleRestarts << " cycles of the deep halo restarted" << std::endl;
+#endif
 
   // print the finish message
   tools::Logger::logger.printFinishMessage();
 
+  MPI_Comm_free(&l_communicator);
+
   // finalize MPI execution
   MPI_Finalize();
 
@@ -544,38 +1275,39 @@ int main( int argc, char** argv ) {
  * @param o_rightInflow ghost layer, where the right neighbor writes into.
  * @param i_rightOutflow layer, where the right neighbor reads form.
  * @param i_mpiCol MPI data type for the vertical gost layers.
+ * @param i_communicator communicator of the process grid.
  */
 void exchangeLeftRightGhostLayers( const int i_leftNeighborRank,  SWE_Block1D* o_leftInflow,  SWE_Block1D* i_leftOutflow,
                                    const int i_rightNeighborRank, SWE_Block1D* o_rightInflow, SWE_Block1D* i_rightOutflow,
-                                   MPI_Datatype i_mpiCol) {
+                                   MPI_Datatype i_mpiCol, MPI_Comm i_communicator) {
 
   MPI_Status l_status;
 
   // send to left, receive from the right:
   MPI_Sendrecv( i_leftOutflow->h.elemVector(), 1, i_mpiCol, i_leftNeighborRank,  1,
                 o_rightInflow->h.elemVector(), 1, i_mpiCol, i_rightNeighborRank, 1,
-                MPI_COMM_WORLD, &l_status );
+                i_communicator, &l_status );
 
   MPI_Sendrecv( i_leftOutflow->hu.elemVector(), 1, i_mpiCol, i_leftNeighborRank,  2,
                 o_rightInflow->hu.elemVector(), 1, i_mpiCol, i_rightNeighborRank, 2,
-                MPI_COMM_WORLD, &l_status );
+                i_communicator, &l_status );
 
   MPI_Sendrecv( i_leftOutflow->hv.elemVector(), 1, i_mpiCol, i_leftNeighborRank,  3,
                 o_rightInflow->hv.elemVector(), 1, i_mpiCol, i_rightNeighborRank, 3,
-                MPI_COMM_WORLD, &l_status );
+                i_communicator, &l_status );
 
   // send to right, receive from the left:
   MPI_Sendrecv( i_rightOutflow->h.elemVector(), 1, i_mpiCol, i_rightNeighborRank, 4,
                 o_leftInflow->h.elemVector(),   1, i_mpiCol, i_leftNeighborRank,  4,
-                MPI_COMM_WORLD, &l_status );
+                i_communicator, &l_status );
 
   MPI_Sendrecv( i_rightOutflow->hu.elemVector(), 1, i_mpiCol, i_rightNeighborRank, 5,
                 o_leftInflow->hu.elemVector(),   1, i_mpiCol, i_leftNeighborRank,  5,
-                MPI_COMM_WORLD, &l_status);
+                i_communicator, &l_status);
 
   MPI_Sendrecv( i_rightOutflow->hv.elemVector(), 1, i_mpiCol, i_rightNeighborRank, 6,
                 o_leftInflow->hv.elemVector(),   1, i_mpiCol, i_leftNeighborRank,  6,
-                MPI_COMM_WORLD, &l_status );
+                i_communicator, &l_status );
 
 }
 
@@ -589,36 +1321,37 @@ void exchangeLeftRightGhostLayers( const int i_leftNeighborRank,  SWE_Block1D* o
  * @param o_topNeighborInflow ghost layer, where the top neighbor writes into.
  * @param i_topNeighborOutflow ghost layer, where the top neighbor reads from.
  * @param i_mpiRow MPI data type for the horizontal ghost layers.
+ * @param i_communicator communicator of the process grid.
  */
 void exchangeBottomTopGhostLayers( const int i_bottomNeighborRank, SWE_Block1D* o_bottomNeighborInflow, SWE_Block1D* i_bottomNeighborOutflow,
                                    const int i_topNeighborRank,    SWE_Block1D* o_topNeighborInflow,    SWE_Block1D* i_topNeighborOutflow,
-                                   const MPI_Datatype i_mpiRow) {
+                                   const MPI_Datatype i_mpiRow, MPI_Comm i_communicator) {
   MPI_Status l_status;
 
   // send to bottom, receive from the top:
   MPI_Sendrecv( i_bottomNeighborOutflow->h.elemVector(), 1, i_mpiRow, i_bottomNeighborRank, 11,
                 o_topNeighborInflow->h.elemVector(),     1, i_mpiRow, i_topNeighborRank,11,
-                MPI_COMM_WORLD, &l_status );
+                i_communicator, &l_status );
 
   MPI_Sendrecv( i_bottomNeighborOutflow->hu.elemVector(), 1, i_mpiRow, i_bottomNeighborRank, 12,
                 o_topNeighborInflow->hu.elemVector(),     1, i_mpiRow, i_topNeighborRank,    12,
-                MPI_COMM_WORLD, &l_status );
+                i_communicator, &l_status );
 
   MPI_Sendrecv( i_bottomNeighborOutflow->hv.elemVector(), 1, i_mpiRow, i_bottomNeighborRank, 13,
                 o_topNeighborInflow->hv.elemVector(),     1, i_mpiRow, i_topNeighborRank, 13,
-                MPI_COMM_WORLD, &l_status);
+                i_communicator, &l_status);
 
   // send to top, receive from the bottom:
   MPI_Sendrecv( i_topNeighborOutflow->h.elemVector(),   1, i_mpiRow, i_topNeighborRank,    14,
                 o_bottomNeighborInflow->h.elemVector(), 1, i_mpiRow, i_bottomNeighborRank, 14,
-                MPI_COMM_WORLD, &l_status );
+                i_communicator, &l_status );
 
   MPI_Sendrecv( i_topNeighborOutflow->hu.elemVector(),   1, i_mpiRow, i_topNeighborRank, 15,
                 o_bottomNeighborInflow->hu.elemVector(), 1, i_mpiRow, i_bottomNeighborRank, 15,
-                MPI_COMM_WORLD, &l_status );
+                i_communicator, &l_status );
 
   MPI_Sendrecv( i_topNeighborOutflow->hv.elemVector(),   1, i_mpiRow, i_topNeighborRank,    16,
                 o_bottomNeighborInflow->hv.elemVector(), 1, i_mpiRow, i_bottomNeighborRank, 16,
-                MPI_COMM_WORLD, &l_status );
+                i_communicator, &l_status );
 
 }
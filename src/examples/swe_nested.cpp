@@ -0,0 +1,316 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Setting of SWE with static nested grids, which uses a wave propagation solver and an artificial or
+ * ASAGI scenario.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "blocks/SWE_WavePropagationBlock.hh"
+#include "blocks/SWE_NestedBlockGrid.hh"
+
+#ifdef WRITENETCDF
+#include "writer/NetCdfWriter.hh"
+#else
+#include "writer/VtkWriter.hh"
+#endif
+
+#ifdef ASAGI
+#include "scenarios/SWE_AsagiScenario.hh"
+#else
+#include "scenarios/SWE_ArtificialTsunamiScenario.hh"
+#endif
+
+#include "tools/args.hh"
+#include "tools/help.hh"
+#include "tools/Logger.hh"
+#include "tools/OutputScheduler.hh"
+#include "tools/ProgressBar.hh"
+
+#ifndef WRITENETCDF
+/**
+ * @return the VTK files of the grids in an output frame
+ */
+static std::vector<std::string> vtkFileNames( const std::vector<std::string> &i_baseNames, size_t i_frame ) {
+  std::vector<std::string> l_fileNames;
+  for (size_t l_nest = 0; l_nest < i_baseNames.size(); l_nest++) {
+    std::ostringstream l_fileName;
+    l_fileName << i_baseNames[l_nest] << '.' << i_frame << ".vtr";
+    l_fileNames.push_back(l_fileName.str());
+  }
+
+  return l_fileNames;
+}
+#endif
+
+/**
+ * Main program for the simulation with static nested grids.
+ */
+int main( int argc, char** argv ) {
+  /**
+   * Initialization.
+   */
+  // Parse command line parameters
+  tools::Args args;
+  args.addOption("grid-size-x", 'x', "Number of cells in x direction (outer grid)");
+  args.addOption("grid-size-y", 'y', "Number of cells in y direction (outer grid)");
+  args.addOption("output-basepath", 'o', "Output base file name");
+  args.addOption("nests", 0, "File describing the nested grids, one per line: xMin xMax yMin yMax ratio");
+  args.addOption("output-interval", 0, "Simulated time between two outputs (default: 1/20 of the simulation time)", tools::Args::Required, false);
+  args.addOption("output-wall-fraction", 0, "Maximum fraction of the wall clock time spent on output", tools::Args::Required, false);
+
+  tools::Args::Result ret = args.parse(argc, argv);
+
+  switch (ret)
+  {
+  case tools::Args::Error:
+	  return 1;
+  case tools::Args::Help:
+	  return 0;
+  case tools::Args::Success:
+	  break;
+  }
+
+  //! number of grid cells of the outer grid in x- and y-direction.
+  int l_nX, l_nY;
+
+  //! l_baseName of the plots.
+  std::string l_baseName;
+
+  // read command line parameters
+  l_nX = args.getArgument<int>("grid-size-x");
+  l_nY = args.getArgument<int>("grid-size-y");
+  l_baseName = args.getArgument<std::string>("output-basepath");
+
+  #ifdef ASAGI
+  //simulation area (see swe_simple)
+  float simulationArea[4];
+  simulationArea[0] = -450000;
+  simulationArea[1] = 6450000;
+  simulationArea[2] = -2450000;
+  simulationArea[3] = 1450000;
+
+  SWE_AsagiScenario l_scenario( ASAGI_INPUT_DIR "tohoku_gebco_ucsb3_500m_hawaii_bath.nc",
+                                ASAGI_INPUT_DIR "tohoku_gebco_ucsb3_500m_hawaii_displ.nc",
+                                (float) 28800., simulationArea);
+  #else
+  // create a simple artificial scenario
+  SWE_ArtificialTsunamiScenario l_scenario(l_nX, l_nY);
+  #endif
+
+  //! number of checkpoints for visualization (at each checkpoint in time, an output file is written).
+  int l_numberOfCheckPoints = 20;
+
+  //! size of a single cell of the outer grid in x- and y-direction
+  float l_dX, l_dY;
+
+  // compute the size of a single cell
+  l_dX = (l_scenario.getBoundaryPos(BND_RIGHT) - l_scenario.getBoundaryPos(BND_LEFT) )/l_nX;
+  l_dY = (l_scenario.getBoundaryPos(BND_TOP) - l_scenario.getBoundaryPos(BND_BOTTOM) )/l_nY;
+
+  // create the outer grid
+  SWE_NestedBlockGrid<SWE_WavePropagationBlock> l_grid( l_nX, l_nY, l_dX, l_dY,
+                                                         l_scenario.getBoundaryPos(BND_LEFT),
+                                                         l_scenario.getBoundaryPos(BND_BOTTOM),
+                                                         l_scenario );
+
+  // add the nests (inner nests after the outer ones)
+  std::ifstream l_nestFile(args.getArgument<std::string>("nests").c_str());
+  if( !l_nestFile.good() ) {
+    tools::Logger::logger.printString("Could not open nest file " + args.getArgument<std::string>("nests"));
+    return 1;
+  }
+
+  std::string l_line;
+  while( std::getline(l_nestFile, l_line) ) {
+    if( l_line.empty() || l_line[0] == '#' )
+      continue;
+
+    std::istringstream l_stream(l_line);
+    float l_xMin, l_xMax, l_yMin, l_yMax;
+    int l_ratio;
+    l_stream >> l_xMin >> l_xMax >> l_yMin >> l_yMax >> l_ratio;
+    if( l_stream.fail() || l_grid.addNest(l_xMin, l_xMax, l_yMin, l_yMax, l_ratio) < 0 ) {
+      tools::Logger::logger.printString("Aborting. Invalid nest (must be inside a grid, without overlaps): " + l_line);
+      return 1;
+    }
+
+    SWE_Block &l_nest = *l_grid.getNest(l_grid.getNumberOfNests()-1);
+    tools::Logger::logger.cout() << "nest " << l_grid.getNumberOfNests()-1 << ": "
+                                 << l_nest.getNx() << " x " << l_nest.getNy() << " cells of size "
+                                 << l_nest.getDx() << " x " << l_nest.getDy() << std::endl;
+  }
+
+  //! time when the simulation ends.
+  float l_endSimulation = l_scenario.endSimulation();
+
+  //! decides when output files are written.
+  tools::OutputScheduler l_outputScheduler( 0.f, l_endSimulation,
+    args.getArgument<float>("output-interval", l_endSimulation/l_numberOfCheckPoints),
+    args.getArgument<float>("output-wall-fraction", 1.f) );
+
+  // Init fancy progressbar
+  tools::ProgressBar progressBar(l_endSimulation);
+
+  // write the output at time zero
+  tools::Logger::logger.printOutputTime((float) 0.);
+  progressBar.update(0.);
+
+  //boundary size of the ghost layers
+  io::BoundarySize l_boundarySize = {{1, 1, 1, 1}};
+
+  //! output writers of the grids (0: outer grid)
+  std::vector<io::Writer*> l_writers;
+
+  //! base names of the output files of the grids
+  std::vector<std::string> l_fileNames;
+
+  for (int l_nest = 0; l_nest < l_grid.getNumberOfNests(); l_nest++) {
+    SWE_Block &l_block = *l_grid.getNest(l_nest);
+
+    std::ostringstream l_fileName;
+    l_fileName << l_baseName << "_nest" << l_nest;
+#ifdef WRITENETCDF
+    //construct a NetCdfWriter
+    l_writers.push_back( new io::NetCdfWriter( l_fileName.str(),
+		  l_block.getBathymetry(),
+		  l_boundarySize,
+		  l_block.getNx(), l_block.getNy(),
+		  l_block.getDx(), l_block.getDy(),
+		  l_block.getOffx(), l_block.getOffy() ) );
+#else
+    // construct a VtkWriter
+    l_writers.push_back( new io::VtkWriter( l_fileName.str(),
+		  l_block.getBathymetry(),
+		  l_boundarySize,
+		  l_block.getNx(), l_block.getNy(),
+		  l_block.getDx(), l_block.getDy(),
+		  l_grid.getNestOffsetX(l_nest), l_grid.getNestOffsetY(l_nest) ) );
+#endif
+    l_fileNames.push_back(l_fileName.str());
+  }
+
+  //! number of written output frames
+  size_t l_frames = 0;
+
+  // Write zero time step
+  l_outputScheduler.beginOutput();
+  for (int l_nest = 0; l_nest < l_grid.getNumberOfNests(); l_nest++) {
+    SWE_Block &l_block = *l_grid.getNest(l_nest);
+    l_writers[l_nest]->writeTimeStep( l_block.getWaterHeight(),
+                                      l_block.getDischarge_hu(),
+                                      l_block.getDischarge_hv(),
+                                      (float) 0.);
+  }
+#ifndef WRITENETCDF
+  io::VtkWriter::writeMultiBlockContainer(l_baseName, l_frames, vtkFileNames(l_fileNames, l_frames));
+#endif
+  l_frames++;
+  l_outputScheduler.endOutput();
+
+  /**
+   * Simulation.
+   */
+  // print the start message and reset the wall clock time
+  progressBar.clear();
+  tools::Logger::logger.printStartMessage();
+  tools::Logger::logger.initWallClockTime(time(NULL));
+
+  //! simulation time.
+  float l_t = 0.0;
+  progressBar.update(l_t);
+
+  unsigned int l_iterations = 0;
+
+  // do time steps until the end of the simulation is reached
+  while( !l_outputScheduler.isFinished(l_t) ) {
+    // reset the cpu clock
+    tools::Logger::logger.resetClockToCurrentTime("Cpu");
+
+    //! time step width of the outer grid, clipped to hit the next output time.
+    float l_maxTimeStepWidth = l_outputScheduler.clipTimestep( l_t, l_grid.computeMaxTimestep() );
+
+    // time step of the outer grid with the sub-cycles of the nests
+    l_grid.simulateTimestep(l_maxTimeStepWidth);
+
+    // update the cpu time in the logger
+    tools::Logger::logger.updateTime("Cpu");
+
+    l_t += l_maxTimeStepWidth;
+    l_iterations++;
+
+    // print the current simulation time
+    progressBar.clear();
+    tools::Logger::logger.printSimulationTime(l_t);
+    progressBar.update(l_t);
+
+    if( !l_outputScheduler.isOutputDue(l_t) )
+      continue;
+
+    // print current simulation time of the output
+    progressBar.clear();
+    tools::Logger::logger.printOutputTime(l_t);
+    progressBar.update(l_t);
+
+    // write output
+    l_outputScheduler.beginOutput();
+    for (int l_nest = 0; l_nest < l_grid.getNumberOfNests(); l_nest++) {
+      SWE_Block &l_block = *l_grid.getNest(l_nest);
+      l_writers[l_nest]->writeTimeStep( l_block.getWaterHeight(),
+                                        l_block.getDischarge_hu(),
+                                        l_block.getDischarge_hv(),
+                                        l_t);
+    }
+#ifndef WRITENETCDF
+    io::VtkWriter::writeMultiBlockContainer(l_baseName, l_frames, vtkFileNames(l_fileNames, l_frames));
+#endif
+    l_frames++;
+    l_outputScheduler.endOutput();
+  }
+
+  /**
+   * Finalize.
+   */
+  for (size_t l_nest = 0; l_nest < l_writers.size(); l_nest++)
+    delete l_writers[l_nest];
+
+  // write the statistics message
+  progressBar.clear();
+  tools::Logger::logger.printStatisticsMessage();
+
+  // print the cpu time
+  tools::Logger::logger.printTime("Cpu", "CPU time");
+
+  // print the wall clock time (includes plotting)
+  tools::Logger::logger.printWallClockTime(time(NULL));
+
+  // printer iteration counter
+  tools::Logger::logger.printIterationsDone(l_iterations);
+
+  return 0;
+}
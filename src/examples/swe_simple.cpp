@@ -27,21 +27,27 @@
  */
 
 #include <cassert>
+#include <algorithm>
 #include <cstdlib>
+#include <limits>
 #include <string>
 #include <iostream>
+#include <vector>
 
 #ifndef CUDA
 #include "blocks/SWE_WavePropagationBlock.hh"
 #else
 #include "blocks/cuda/SWE_WavePropagationBlockCuda.hh"
 #endif
+#include "blocks/SWE_SparseBlockGrid.hh"
 
 #ifdef WRITENETCDF
 #include "writer/NetCdfWriter.hh"
+#include "writer/RegionOutput.hh"
 #else
 #include "writer/VtkWriter.hh"
 #endif
+#include "writer/DeltaWriter.hh"
 
 #ifdef ASAGI
 #include "scenarios/SWE_AsagiScenario.hh"
@@ -57,10 +63,11 @@
 #include "tools/args.hh"
 #include "tools/help.hh"
 #include "tools/Logger.hh"
+#include "tools/OutputScheduler.hh"
 #include "tools/ProgressBar.hh"
 
 /**
- * Main program for the simulation on a single SWE_WavePropagationBlock.
+ * Main program for the simulation on a single SWE_WavePropagationBlock or a grid of tiles.
  */
 int main( int argc, char** argv ) {
   /**
@@ -72,6 +79,18 @@ int main( int argc, char** argv ) {
   args.addOption("grid-size-x", 'x', "Number of cells in x direction");
   args.addOption("grid-size-y", 'y', "Number of cells in y direction");
   args.addOption("output-basepath", 'o', "Output base file name");
+  args.addOption("output-interval", 0, "Simulated time between two outputs (default: 1/20 of the simulation time)", tools::Args::Required, false);
+  args.addOption("output-wall-fraction", 0, "Maximum fraction of the wall clock time spent on output", tools::Args::Required, false);
+  args.addOption("output-event-threshold", 0, "Additional output if the water surface changed by more than this value", tools::Args::Required, false);
+  args.addOption("output-delta-keyframes", 0, "Write delta-encoded output with a keyframe every N frames", tools::Args::Required, false);
+  args.addOption("output-delta-tolerance", 0, "Maximum error of values omitted in delta-encoded output", tools::Args::Required, false);
+  args.addOption("output-windows", 0, "File describing additional output windows (regions of interest)", tools::Args::Required, false);
+#ifndef CUDA
+  args.addOption("tile-size", 0, "Number of cells of a tile in each direction (multiple blocks, e.g. cache-sized)", tools::Args::Required, false);
+  args.addOption("land-elevation", 0, "Tiles whose bathymetry is above this elevation and which are dry are not allocated", tools::Args::Required, false);
+  args.addOption("local-timestepping", 0, "Tiles advance with up to 2^N times the smallest time step of all tiles", tools::Args::Required, false);
+  args.addOption("active-region", 0, "Skip the tiles which (and whose neighbors) are at rest or dry", tools::Args::No, false);
+#endif
   #endif
 
   tools::Args::Result ret = args.parse(argc, argv);
@@ -152,13 +171,6 @@ int main( int argc, char** argv ) {
   l_dX = (l_scenario.getBoundaryPos(BND_RIGHT) - l_scenario.getBoundaryPos(BND_LEFT) )/l_nX;
   l_dY = (l_scenario.getBoundaryPos(BND_TOP) - l_scenario.getBoundaryPos(BND_BOTTOM) )/l_nY;
 
-  // create a single wave propagation block
-  #ifndef CUDA
-  SWE_WavePropagationBlock l_wavePropgationBlock(l_nX,l_nY,l_dX,l_dY);
-  #else
-  SWE_WavePropagationBlockCuda l_wavePropgationBlock(l_nX,l_nY,l_dX,l_dY);
-  #endif
-
   //! origin of the simulation domain in x- and y-direction
   float l_originX, l_originY;
 
@@ -166,20 +178,68 @@ int main( int argc, char** argv ) {
   l_originX = l_scenario.getBoundaryPos(BND_LEFT);
   l_originY = l_scenario.getBoundaryPos(BND_BOTTOM);
 
-  // initialize the wave propagation block
-  l_wavePropgationBlock.initScenario(l_originX, l_originY, l_scenario);
+#ifndef CUDA
+  //! number of cells of a tile in each direction (0: a single block)
+  const int l_tileSize = args.getArgument<int>("tile-size", 0);
 
+  //! tiles above this elevation (and dry) are neither allocated nor computed
+  const float l_landElevation = args.getArgument<float>("land-elevation", std::numeric_limits<float>::max());
 
-  //! time when the simulation ends.
-  float l_endSimulation = l_scenario.endSimulation();
+  //! largest time step class of the tiles (0: all tiles use the same time step)
+  const int l_maxTimestepClass = args.getArgument<int>("local-timestepping", 0);
 
-  //! checkpoints when output files are written.
-  float* l_checkPoints = new float[l_numberOfCheckPoints+1];
+  //! skip the tiles at rest?
+  const bool l_activeRegion = args.isSet("active-region");
+#else
+  const int l_tileSize = 0;
+  const float l_landElevation = std::numeric_limits<float>::max();
+  const int l_maxTimestepClass = 0;
+  const bool l_activeRegion = false;
+#endif
 
-  // compute the checkpoints in time
-  for(int cp = 0; cp <= l_numberOfCheckPoints; cp++) {
-     l_checkPoints[cp] = cp*(l_endSimulation/l_numberOfCheckPoints);
+  //! multiple blocks (tiles) or skipped land tiles?
+  const bool l_sparse = l_tileSize > 0 || l_landElevation < std::numeric_limits<float>::max();
+  if( l_sparse && args.isSet("output-windows") ) {
+    tools::Logger::logger.printString("Tiles cannot be combined with output windows.");
+    return 1;
+  }
+  if( l_maxTimestepClass < 0 || (l_maxTimestepClass > 0 && l_tileSize <= 0) ) {
+    tools::Logger::logger.printString("Local time stepping requires tiles and a non-negative number of classes.");
+    return 1;
   }
+  if( l_activeRegion && l_maxTimestepClass > 0 ) {
+    tools::Logger::logger.printString("The active region tracking cannot be combined with local time stepping.");
+    return 1;
+  }
+
+  // create and initialize the wave propagation blocks (a single block unless the domain is tiled)
+  #ifndef CUDA
+  SWE_SparseBlockGrid<SWE_WavePropagationBlock> l_grid( l_nX, l_nY, l_dX, l_dY, l_originX, l_originY,
+                                                         l_scenario, l_tileSize, l_landElevation );
+  #else
+  SWE_SparseBlockGrid<SWE_WavePropagationBlockCuda> l_grid( l_nX, l_nY, l_dX, l_dY, l_originX, l_originY,
+                                                             l_scenario );
+  #endif
+
+  if( l_maxTimestepClass > 0 )
+    l_grid.setLocalTimestepping(l_maxTimestepClass);
+
+  if( l_sparse )
+    tools::Logger::logger.cout() << "allocated cells: " << l_grid.getNumberOfActiveCells()
+                                 << " of " << (long) l_nX*l_nY << std::endl;
+
+  // the water surface of the scenarios is at zero where the ocean is at rest
+  if( l_activeRegion )
+    l_grid.setActiveRegionTracking(0.f);
+
+  //! time when the simulation ends.
+  float l_endSimulation = l_scenario.endSimulation();
+
+  //! decides when output files are written.
+  tools::OutputScheduler l_outputScheduler( 0.f, l_endSimulation,
+    args.getArgument<float>("output-interval", l_endSimulation/l_numberOfCheckPoints),
+    args.getArgument<float>("output-wall-fraction", 1.f),
+    args.getArgument<float>("output-event-threshold", 0.f) );
 
   // Init fancy progressbar
   tools::ProgressBar progressBar(l_endSimulation);
@@ -188,31 +248,98 @@ int main( int argc, char** argv ) {
   tools::Logger::logger.printOutputTime((float) 0.);
   progressBar.update(0.);
 
-  std::string l_fileName = generateBaseFileName(l_baseName,0,0);
   //boundary size of the ghost layers
   io::BoundarySize l_boundarySize = {{1, 1, 1, 1}};
+
+  //! output writers of the tiles (column-major), 0 for land tiles
+  std::vector<io::Writer*> l_writers(l_grid.getTilesX()*l_grid.getTilesY(), 0);
+
+  //! allocated tiles, written to the ParaView container
+  std::vector<bool> l_activeTiles(l_writers.size());
+  for (size_t l_tile = 0; l_tile < l_writers.size(); l_tile++)
+    l_activeTiles[l_tile] = l_grid.getTile(l_tile / l_grid.getTilesY(), l_tile % l_grid.getTilesY()) != 0;
+
+  for (int i = 0; i < l_grid.getTilesX(); i++)
+    for (int j = 0; j < l_grid.getTilesY(); j++) {
+      SWE_Block* l_tile = l_grid.getTile(i, j);
+      if (l_tile == 0)
+        continue;
+
+      std::string l_fileName = generateBaseFileName(l_baseName,i,j);
+      io::Writer* l_writer;
+      if( args.isSet("output-delta-keyframes") ) {
+        // construct a DeltaWriter
+        l_writer = new io::DeltaWriter( l_fileName,
+		  l_tile->getBathymetry(),
+		  l_boundarySize,
+		  l_grid.getTileNx(i), l_grid.getTileNy(j),
+		  l_dX, l_dY,
+		  l_grid.getTileOriginX(i), l_grid.getTileOriginY(j),
+		  args.getArgument<unsigned int>("output-delta-keyframes"),
+		  args.getArgument<float>("output-delta-tolerance", 1e-3f) );
+      } else {
 #ifdef WRITENETCDF
-  //construct a NetCdfWriter
-  io::NetCdfWriter l_writer( l_fileName,
-		  l_wavePropgationBlock.getBathymetry(),
+        //construct a NetCdfWriter
+        l_writer = new io::NetCdfWriter( l_fileName,
+		  l_tile->getBathymetry(),
 		  l_boundarySize,
-		  l_nX, l_nY,
+		  l_grid.getTileNx(i), l_grid.getTileNy(j),
 		  l_dX, l_dY,
-		  l_originX, l_originY);
+		  l_grid.getTileOriginX(i), l_grid.getTileOriginY(j) );
 #else
-  // consturct a VtkWriter
-  io::VtkWriter l_writer( l_fileName,
-		  l_wavePropgationBlock.getBathymetry(),
+        // consturct a VtkWriter
+        io::VtkWriter* l_vtkWriter = new io::VtkWriter( l_fileName,
+		  l_tile->getBathymetry(),
 		  l_boundarySize,
-		  l_nX, l_nY,
-		  l_dX, l_dY );
+		  l_grid.getTileNx(i), l_grid.getTileNy(j),
+		  l_dX, l_dY,
+		  l_grid.getTileOffsetX(i), l_grid.getTileOffsetY(j) );
+        // the first allocated tile writes the container of all tiles
+        if( l_sparse && i*l_grid.getTilesY() + j == std::find(l_activeTiles.begin(), l_activeTiles.end(), true) - l_activeTiles.begin() )
+          l_vtkWriter->setContainer( l_baseName, tools::Decomposition::tileCuts(tools::Decomposition::uniformCuts(l_nX, 1), l_tileSize),
+                                     tools::Decomposition::tileCuts(tools::Decomposition::uniformCuts(l_nY, 1), l_tileSize),
+                                     l_activeTiles );
+        l_writer = l_vtkWriter;
 #endif
+      }
+      l_writers[i*l_grid.getTilesY() + j] = l_writer;
+    }
+
   // Write zero time step
-  l_writer.writeTimeStep( l_wavePropgationBlock.getWaterHeight(),
-                          l_wavePropgationBlock.getDischarge_hu(),
-                          l_wavePropgationBlock.getDischarge_hv(),
-                          (float) 0.);
+  l_outputScheduler.beginOutput();
+  for (size_t l_tile = 0; l_tile < l_writers.size(); l_tile++) {
+    if (l_writers[l_tile] == 0)
+      continue;
+
+    SWE_Block &l_block = *l_grid.getTile(l_tile / l_grid.getTilesY(), l_tile % l_grid.getTilesY());
+    l_writers[l_tile]->writeTimeStep( l_block.getWaterHeight(),
+                                      l_block.getDischarge_hu(),
+                                      l_block.getDischarge_hv(),
+                                      (float) 0.);
+    l_outputScheduler.storeSurface( l_block.getWaterHeight(),
+                                    l_block.getBathymetry(), l_tile );
+  }
+  l_outputScheduler.endOutput();
 
+#ifdef WRITENETCDF
+  // output windows (regions of interest), each with its own resolution and interval (a single block only)
+  io::RegionOutput* l_regionOutput = 0;
+  if( args.isSet("output-windows") ) {
+    SWE_Block &l_block = *l_grid.getTile(0, 0);
+    l_regionOutput = new io::RegionOutput( generateBaseFileName(l_baseName,0,0),
+		  l_block.getBathymetry(),
+		  l_boundarySize,
+		  l_nX, l_nY,
+		  l_dX, l_dY,
+		  l_originX, l_originY,
+		  0.f, l_endSimulation,
+		  io::RegionOutput::readWindows( args.getArgument<std::string>("output-windows") ) );
+    l_regionOutput->writeTimeStep( l_block.getWaterHeight(),
+                                   l_block.getDischarge_hu(),
+                                   l_block.getDischarge_hv(),
+                                   (float) 0. );
+  }
+#endif
 
   /**
    * Simulation.
@@ -228,59 +355,105 @@ int main( int argc, char** argv ) {
 
   unsigned int l_iterations = 0;
 
-  // loop over checkpoints
-  for(int c=1; c<=l_numberOfCheckPoints; c++) {
+  // reset the cpu clock
+  tools::Logger::logger.resetClockToCurrentTime("Cpu");
 
-    // do time steps until next checkpoint is reached
-    while( l_t < l_checkPoints[c] ) {
-      // set values in ghost cells:
-      l_wavePropgationBlock.setGhostLayer();
-      
-      // reset the cpu clock
-      tools::Logger::logger.resetClockToCurrentTime("Cpu");
+  // set values in ghost cells (incl. the edges between the tiles) and compute the fluxes of the first time step
+  l_grid.setGhostLayer();
+  l_grid.computeNumericalFluxes();
 
-      // approximate the maximum time step
-      // TODO: This calculation should be replaced by the usage of the wave speeds occuring during the flux computation
-      // Remark: The code is executed on the CPU, therefore a "valid result" depends on the CPU-GPU-synchronization.
-//      l_wavePropgationBlock.computeMaxTimestep();
+  // update the cpu time in the logger
+  tools::Logger::logger.updateTime("Cpu");
 
-      // compute numerical flux on each edge
-      l_wavePropgationBlock.computeNumericalFluxes();
+  // do time steps until the end of the simulation is reached
+  while( !l_outputScheduler.isFinished(l_t) ) {
+    // reset the cpu clock
+    tools::Logger::logger.resetClockToCurrentTime("Cpu");
 
-      //! maximum allowed time step width.
-      float l_maxTimeStepWidth = l_wavePropgationBlock.getMaxTimestep();
+    //! maximum allowed time step width (of the largest time step class), clipped to hit the next output time.
+    float l_maxTimeStepWidth = l_outputScheduler.clipTimestep( l_t,
+      l_maxTimestepClass > 0 ? l_grid.computeLocalTimesteps() : l_grid.getMaxTimestep() );
+#ifdef WRITENETCDF
+    if( l_regionOutput != 0 )
+      l_maxTimeStepWidth = l_regionOutput->clipTimestep( l_t, l_maxTimeStepWidth );
+#endif
 
-      // update the cell values
-      l_wavePropgationBlock.updateUnknowns(l_maxTimeStepWidth);
+    if( l_maxTimestepClass > 0 )
+      // each tile does the number of time steps required by its own CFL condition
+      l_grid.simulateLocalTimesteps(l_maxTimeStepWidth);
+    else
+      // update the cell values, set the ghost cells and compute the fluxes of the next time step
+      // (one task per tile and phase with OpenMP)
+      l_grid.updateUnknownsAndComputeNumericalFluxes(l_maxTimeStepWidth);
 
-      // update the cpu time in the logger
-      tools::Logger::logger.updateTime("Cpu");
+    // update the cpu time in the logger
+    tools::Logger::logger.updateTime("Cpu");
 
-      // update simulation time with time step width.
-      l_t += l_maxTimeStepWidth;
-      l_iterations++;
+    // update simulation time with time step width.
+    l_t += l_maxTimeStepWidth;
+    l_iterations++;
 
-      // print the current simulation time
-      progressBar.clear();
-      tools::Logger::logger.printSimulationTime(l_t);
-      progressBar.update(l_t);
+    // print the current simulation time
+    progressBar.clear();
+    tools::Logger::logger.printSimulationTime(l_t);
+    progressBar.update(l_t);
 
-    }
+#ifdef WRITENETCDF
+    // write the output windows which are due
+    if( l_regionOutput != 0 )
+      l_regionOutput->writeTimeStep( l_grid.getTile(0, 0)->getWaterHeight(),
+                                     l_grid.getTile(0, 0)->getDischarge_hu(),
+                                     l_grid.getTile(0, 0)->getDischarge_hv(),
+                                     l_t );
+#endif
+
+    //! maximum change of the water surface since the last output (event trigger only)
+    float l_surfaceChange = 0.f;
+    if( l_outputScheduler.hasEventTrigger() )
+      for (size_t l_tile = 0; l_tile < l_writers.size(); l_tile++)
+        if (l_writers[l_tile] != 0) {
+          SWE_Block &l_block = *l_grid.getTile(l_tile / l_grid.getTilesY(), l_tile % l_grid.getTilesY());
+          l_surfaceChange = std::max( l_surfaceChange,
+                                      l_outputScheduler.computeSurfaceChange( l_block.getWaterHeight(),
+                                                                              l_block.getBathymetry(), l_tile ) );
+        }
+
+    if( !l_outputScheduler.isOutputDue(l_t, l_surfaceChange) )
+      continue;
 
     // print current simulation time of the output
     progressBar.clear();
     tools::Logger::logger.printOutputTime(l_t);
+    if( l_activeRegion )
+      tools::Logger::logger.cout() << "computed cells: " << l_grid.getNumberOfComputedCells() << std::endl;
     progressBar.update(l_t);
 
     // write output
-    l_writer.writeTimeStep( l_wavePropgationBlock.getWaterHeight(),
-                            l_wavePropgationBlock.getDischarge_hu(),
-                            l_wavePropgationBlock.getDischarge_hv(),
-                            l_t);  }
+    l_outputScheduler.beginOutput();
+    for (size_t l_tile = 0; l_tile < l_writers.size(); l_tile++) {
+      if (l_writers[l_tile] == 0)
+        continue;
+
+      SWE_Block &l_block = *l_grid.getTile(l_tile / l_grid.getTilesY(), l_tile % l_grid.getTilesY());
+      l_writers[l_tile]->writeTimeStep( l_block.getWaterHeight(),
+                                        l_block.getDischarge_hu(),
+                                        l_block.getDischarge_hv(),
+                                        l_t);
+      l_outputScheduler.storeSurface( l_block.getWaterHeight(),
+                                      l_block.getBathymetry(), l_tile );
+    }
+    l_outputScheduler.endOutput();
+  }
 
   /**
    * Finalize.
    */
+  for (size_t l_tile = 0; l_tile < l_writers.size(); l_tile++)
+    delete l_writers[l_tile];
+#ifdef WRITENETCDF
+  delete l_regionOutput;
+#endif
+
   // write the statistics message
   progressBar.clear();
   tools::Logger::logger.printStatisticsMessage();
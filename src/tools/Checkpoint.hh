@@ -0,0 +1,373 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Coordinated checkpoint/restart of the blocks of all processes with MPI-IO.
+ */
+
+#ifndef CHECKPOINT_HH_
+#define CHECKPOINT_HH_
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include "blocks/SWE_Block.hh"
+#include "tools/Decomposition.hh"
+
+namespace tools {
+  class Checkpoint;
+}
+
+/**
+ * Writes the water height and the momentum of all processes into one binary
+ * file and restores them at a restart.
+ *
+ * The file starts with a header (grid size, iteration, simulated time and the
+ * decomposition of the writing run), followed by h, hu and hv of the global grid
+ * (x-major, y is the fastest index). Each process writes the cells it owns and
+ * reads the cells of its blocks, both with collective MPI-IO on a subarray of the
+ * global grid. A restart can therefore use a different number of processes or a
+ * different decomposition.
+ *
+ * A checkpoint is written asynchronously: write() copies the cells and starts a
+ * non-blocking collective write (if supported by the MPI library), wait() completes
+ * it. The file is written under a temporary name and renamed when it is complete,
+ * so a crash during a checkpoint keeps the previous one.
+ */
+class tools::Checkpoint {
+  private:
+    enum {
+      //! first entry of the header
+      MAGIC = 0x53574543,
+      //! number of header entries before the cuts of the decomposition
+      HEADER_SIZE = 7
+    };
+
+    //! a block and the position of its first inner cell in the global grid
+    struct Block {
+      SWE_Block* block;
+      int cellX, cellY;
+    };
+
+    //! number of cells of the global grid
+    int m_nX, m_nY;
+
+    //! cells owned by this process (written to the checkpoint)
+    int m_offsetX, m_offsetY, m_sizeX, m_sizeY;
+
+    //! processes writing the checkpoint
+    MPI_Comm m_communicator;
+
+    //! blocks of this process
+    std::vector<Block> m_blocks;
+
+    //! copy of the owned cells (h, hu, hv) while a checkpoint is written
+    std::vector<float> m_buffer;
+
+    //! file of the running checkpoint, MPI_FILE_NULL if none is running
+    MPI_File m_file;
+
+    //! the running write
+    MPI_Request m_request;
+
+    //! name of the running checkpoint
+    std::string m_fileName;
+
+    // no copies, a checkpoint may be running
+    Checkpoint(const Checkpoint&);
+    Checkpoint& operator=(const Checkpoint&);
+
+    /**
+     * Creates the file type of three (h, hu, hv) subarrays of the global grid.
+     */
+    MPI_Datatype createFileType(int i_offsetX, int i_offsetY, int i_sizeX, int i_sizeY) const {
+      int l_sizes[2] = { m_nX, m_nY };
+      int l_subsizes[2] = { i_sizeX, i_sizeY };
+      int l_starts[2] = { i_offsetX, i_offsetY };
+
+      // the extent of the subarray is the global grid, so the three variables follow each other
+      MPI_Datatype l_subarray, l_fileType;
+      MPI_Type_create_subarray(2, l_sizes, l_subsizes, l_starts, MPI_ORDER_C, MPI_FLOAT, &l_subarray);
+      MPI_Type_contiguous(3, l_subarray, &l_fileType);
+      MPI_Type_commit(&l_fileType);
+      MPI_Type_free(&l_subarray);
+
+      return l_fileType;
+    }
+
+    //! @return size of the header in bytes (the data starts after the header)
+    static MPI_Offset headerBytes(int i_blocksX, int i_blocksY) {
+      return (MPI_Offset) (HEADER_SIZE + i_blocksX+1 + i_blocksY+1) * sizeof(int);
+    }
+
+  public:
+    /**
+     * @param i_nX number of cells of the global grid in x-direction.
+     * @param i_nY number of cells of the global grid in y-direction.
+     * @param i_offsetX first cell owned by this process in x-direction.
+     * @param i_offsetY first cell owned by this process in y-direction.
+     * @param i_sizeX number of cells owned by this process in x-direction.
+     * @param i_sizeY number of cells owned by this process in y-direction.
+     * @param i_communicator communicator of all processes.
+     */
+    Checkpoint( int i_nX, int i_nY,
+                int i_offsetX, int i_offsetY,
+                int i_sizeX, int i_sizeY,
+                MPI_Comm i_communicator = MPI_COMM_WORLD ):
+      m_nX(i_nX), m_nY(i_nY),
+      m_offsetX(i_offsetX), m_offsetY(i_offsetY),
+      m_sizeX(i_sizeX), m_sizeY(i_sizeY),
+      m_communicator(i_communicator),
+      m_file(MPI_FILE_NULL),
+      m_request(MPI_REQUEST_NULL) {
+    }
+
+    /**
+     * Completes a running checkpoint.
+     */
+    ~Checkpoint() {
+      wait();
+    }
+
+    /**
+     * Adds a block of this process.
+     *
+     * The inner cells of the block which are owned by this process are written,
+     * all inner cells (incl. the overlap of a deep halo) are read at a restart.
+     *
+     * @param i_block the block.
+     * @param i_cellX position of the first inner cell of the block in the global grid (x-direction).
+     * @param i_cellY position of the first inner cell of the block in the global grid (y-direction).
+     */
+    void addBlock(SWE_Block &i_block, int i_cellX, int i_cellY) {
+      Block l_block = { &i_block, i_cellX, i_cellY };
+      m_blocks.push_back(l_block);
+    }
+
+    /**
+     * Starts to write a checkpoint (collective), a running checkpoint is completed first.
+     *
+     * @param i_fileName name of the checkpoint file.
+     * @param i_time simulated time.
+     * @param i_iteration number of time steps done.
+     * @param i_decomposition decomposition of the grid.
+     */
+    void write( const std::string &i_fileName,
+                float i_time, int i_iteration,
+                const Decomposition &i_decomposition ) {
+      wait();
+
+      // copy the owned cells, the blocks change while the checkpoint is written
+      const int l_cells = m_sizeX * m_sizeY;
+      m_buffer.assign(3 * l_cells, 0.f);
+
+      for (size_t l_block = 0; l_block < m_blocks.size(); l_block++) {
+        SWE_Block &l_swe = *m_blocks[l_block].block;
+        const Float2D &l_h = l_swe.getWaterHeight();
+        const Float2D &l_hu = l_swe.getDischarge_hu();
+        const Float2D &l_hv = l_swe.getDischarge_hv();
+
+        const int l_xStart = std::max(m_offsetX, m_blocks[l_block].cellX);
+        const int l_xEnd = std::min(m_offsetX + m_sizeX, m_blocks[l_block].cellX + l_swe.getNx());
+        const int l_yStart = std::max(m_offsetY, m_blocks[l_block].cellY);
+        const int l_yEnd = std::min(m_offsetY + m_sizeY, m_blocks[l_block].cellY + l_swe.getNy());
+
+        for (int x = l_xStart; x < l_xEnd; x++)
+          for (int y = l_yStart; y < l_yEnd; y++) {
+            const int l_index = (x - m_offsetX) * m_sizeY + (y - m_offsetY);
+            const int i = x - m_blocks[l_block].cellX + 1, j = y - m_blocks[l_block].cellY + 1;
+
+            m_buffer[l_index] = l_h[i][j];
+            m_buffer[l_cells + l_index] = l_hu[i][j];
+            m_buffer[2*l_cells + l_index] = l_hv[i][j];
+          }
+      }
+
+      int l_rank;
+      MPI_Comm_rank(m_communicator, &l_rank);
+
+      // a left-over temporary file of an interrupted checkpoint might be larger
+      m_fileName = i_fileName;
+      const std::string l_partName = m_fileName + ".part";
+      if (l_rank == 0)
+        std::remove(l_partName.c_str());
+      MPI_Barrier(m_communicator);
+      MPI_File_open( m_communicator, const_cast<char*>(l_partName.c_str()),
+                     MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &m_file );
+
+      if (l_rank == 0) {
+        std::vector<int> l_header(HEADER_SIZE);
+        l_header[0] = MAGIC;
+        l_header[1] = m_nX;
+        l_header[2] = m_nY;
+        l_header[3] = i_iteration;
+        std::memcpy(&l_header[4], &i_time, sizeof(float));
+        l_header[5] = i_decomposition.getBlocksX();
+        l_header[6] = i_decomposition.getBlocksY();
+        l_header.insert(l_header.end(), i_decomposition.getCutsX().begin(), i_decomposition.getCutsX().end());
+        l_header.insert(l_header.end(), i_decomposition.getCutsY().begin(), i_decomposition.getCutsY().end());
+
+        MPI_File_write_at(m_file, 0, &l_header[0], l_header.size(), MPI_INT, MPI_STATUS_IGNORE);
+      }
+
+      MPI_Datatype l_fileType = createFileType(m_offsetX, m_offsetY, m_sizeX, m_sizeY);
+      MPI_File_set_view( m_file, headerBytes(i_decomposition.getBlocksX(), i_decomposition.getBlocksY()),
+                         MPI_FLOAT, l_fileType, const_cast<char*>("native"), MPI_INFO_NULL );
+      MPI_Type_free(&l_fileType);
+
+#if MPI_VERSION > 3 || (MPI_VERSION == 3 && MPI_SUBVERSION >= 1)
+      MPI_File_iwrite_all(m_file, &m_buffer[0], m_buffer.size(), MPI_FLOAT, &m_request);
+#else
+      MPI_File_write_all_begin(m_file, &m_buffer[0], m_buffer.size(), MPI_FLOAT);
+#endif
+    }
+
+    /**
+     * Completes a running checkpoint (collective) and renames the file.
+     */
+    void wait() {
+      if (m_file == MPI_FILE_NULL)
+        return;
+
+#if MPI_VERSION > 3 || (MPI_VERSION == 3 && MPI_SUBVERSION >= 1)
+      MPI_Wait(&m_request, MPI_STATUS_IGNORE);
+#else
+      MPI_File_write_all_end(m_file, &m_buffer[0], MPI_STATUS_IGNORE);
+#endif
+      MPI_File_close(&m_file);
+
+      // all processes have written their cells, the checkpoint replaces the previous one
+      MPI_Barrier(m_communicator);
+      int l_rank;
+      MPI_Comm_rank(m_communicator, &l_rank);
+      if (l_rank == 0)
+        std::rename((m_fileName + ".part").c_str(), m_fileName.c_str());
+
+      std::vector<float>().swap(m_buffer);
+    }
+
+    /**
+     * Reads the header of a checkpoint (collective).
+     *
+     * @param i_fileName name of the checkpoint file.
+     * @param i_nX expected number of cells in x-direction.
+     * @param i_nY expected number of cells in y-direction.
+     * @param o_time simulated time of the checkpoint.
+     * @param o_iteration number of time steps done before the checkpoint.
+     * @param o_cutsX cuts of the decomposition of the writing run in x-direction.
+     * @param o_cutsY cuts of the decomposition of the writing run in y-direction.
+     * @param i_communicator communicator of all processes.
+     * @return false if the file could not be read or does not match the grid.
+     */
+    static bool readHeader( const std::string &i_fileName,
+                            int i_nX, int i_nY,
+                            float &o_time, int &o_iteration,
+                            std::vector<int> &o_cutsX, std::vector<int> &o_cutsY,
+                            MPI_Comm i_communicator = MPI_COMM_WORLD ) {
+      int l_rank;
+      MPI_Comm_rank(i_communicator, &l_rank);
+
+      // the first process reads the header, the others get it by a broadcast
+      std::vector<int> l_header(HEADER_SIZE, 0);
+      if (l_rank == 0) {
+        FILE* l_file = std::fopen(i_fileName.c_str(), "rb");
+        if (l_file != 0) {
+          if (std::fread(&l_header[0], sizeof(int), HEADER_SIZE, l_file) == (size_t) HEADER_SIZE
+              && l_header[0] == MAGIC && l_header[5] > 0 && l_header[6] > 0) {
+            l_header.resize(HEADER_SIZE + l_header[5]+1 + l_header[6]+1);
+            if (std::fread(&l_header[HEADER_SIZE], sizeof(int), l_header.size() - HEADER_SIZE, l_file)
+                != l_header.size() - HEADER_SIZE)
+              l_header[0] = 0;
+          } else
+            l_header[0] = 0;
+          std::fclose(l_file);
+        }
+      }
+
+      int l_size = l_header.size();
+      MPI_Bcast(&l_size, 1, MPI_INT, 0, i_communicator);
+      l_header.resize(l_size);
+      MPI_Bcast(&l_header[0], l_size, MPI_INT, 0, i_communicator);
+
+      if (l_header[0] != MAGIC || l_header[1] != i_nX || l_header[2] != i_nY)
+        return false;
+
+      o_iteration = l_header[3];
+      std::memcpy(&o_time, &l_header[4], sizeof(float));
+      o_cutsX.assign(l_header.begin() + HEADER_SIZE, l_header.begin() + HEADER_SIZE + l_header[5]+1);
+      o_cutsY.assign(l_header.begin() + HEADER_SIZE + l_header[5]+1, l_header.end());
+      return true;
+    }
+
+    /**
+     * Reads the cells of all blocks from a checkpoint (collective).
+     * Each process reads the bounding box of its blocks only.
+     *
+     * @param i_fileName name of the checkpoint file.
+     * @param i_blocksX number of block columns of the writing run (see readHeader()).
+     * @param i_blocksY number of block rows of the writing run (see readHeader()).
+     */
+    void read(const std::string &i_fileName, int i_blocksX, int i_blocksY) {
+      int l_xStart = m_nX, l_xEnd = 0, l_yStart = m_nY, l_yEnd = 0;
+      for (size_t l_block = 0; l_block < m_blocks.size(); l_block++) {
+        l_xStart = std::min(l_xStart, m_blocks[l_block].cellX);
+        l_xEnd = std::max(l_xEnd, m_blocks[l_block].cellX + m_blocks[l_block].block->getNx());
+        l_yStart = std::min(l_yStart, m_blocks[l_block].cellY);
+        l_yEnd = std::max(l_yEnd, m_blocks[l_block].cellY + m_blocks[l_block].block->getNy());
+      }
+      if (m_blocks.empty())
+        l_xStart = l_xEnd = l_yStart = l_yEnd = 0;
+
+      const int l_sizeY = l_yEnd - l_yStart;
+      const int l_cells = (l_xEnd - l_xStart) * l_sizeY;
+      std::vector<float> l_buffer(3 * l_cells);
+
+      MPI_File l_file;
+      MPI_File_open( m_communicator, const_cast<char*>(i_fileName.c_str()),
+                     MPI_MODE_RDONLY, MPI_INFO_NULL, &l_file );
+
+      MPI_Datatype l_fileType = createFileType(l_xStart, l_yStart, l_xEnd - l_xStart, l_sizeY);
+      MPI_File_set_view( l_file, headerBytes(i_blocksX, i_blocksY),
+                         MPI_FLOAT, l_fileType, const_cast<char*>("native"), MPI_INFO_NULL );
+      MPI_Type_free(&l_fileType);
+
+      MPI_File_read_all(l_file, l_buffer.empty() ? 0 : &l_buffer[0], l_buffer.size(), MPI_FLOAT, MPI_STATUS_IGNORE);
+      MPI_File_close(&l_file);
+
+      for (size_t l_block = 0; l_block < m_blocks.size(); l_block++) {
+        SWE_Block &l_swe = *m_blocks[l_block].block;
+        for (int i = 0; i < l_swe.getNx(); i++)
+          for (int j = 0; j < l_swe.getNy(); j++) {
+            const int l_index = (m_blocks[l_block].cellX + i - l_xStart) * l_sizeY
+                              + (m_blocks[l_block].cellY + j - l_yStart);
+            l_swe.setUnknowns( i, j, l_buffer[l_index],
+                               l_buffer[l_cells + l_index], l_buffer[2*l_cells + l_index] );
+          }
+      }
+    }
+};
+
+#endif // CHECKPOINT_HH_
@@ -0,0 +1,425 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Weighted rectilinear decomposition of the grid into blocks.
+ */
+
+#ifndef DECOMPOSITION_HH_
+#define DECOMPOSITION_HH_
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "scenarios/SWE_Scenario.hh"
+
+namespace tools {
+  class Decomposition;
+}
+
+/**
+ * Rectilinear decomposition of a nX x nY grid into blocksX x blocksY blocks.
+ *
+ * All blocks of a block column share the same cells in x-direction and all
+ * blocks of a block row the same cells in y-direction, so each block has at
+ * most one neighbor at each edge and the ghost layers of two neighbors match.
+ * The blocks can have different sizes: the cuts are placed such that each
+ * block column (row) gets the same share of the estimated cost of the cell
+ * columns (rows).
+ *
+ * The cost can be estimated from the scenario (wet cells are more expensive
+ * than dry cells, see estimateCosts()) and corrected with the measured compute
+ * times of the blocks (see rebalance()).
+ */
+class tools::Decomposition {
+  private:
+    //! first cell of each block column, followed by the number of cells in x-direction
+    std::vector<int> m_cutsX;
+
+    //! first cell of each block row, followed by the number of cells in y-direction
+    std::vector<int> m_cutsY;
+
+    /**
+     * Scales the costs of each part, such that the sum of a part is its load.
+     */
+    static void scaleCosts( std::vector<double> &io_costs,
+                            const std::vector<int> &i_cuts,
+                            const std::vector<double> &i_loads ) {
+      for (size_t l_part = 0; l_part+1 < i_cuts.size(); l_part++) {
+        double l_sum = 0.;
+        for (int i = i_cuts[l_part]; i < i_cuts[l_part+1]; i++)
+          l_sum += io_costs[i];
+
+        const int l_size = i_cuts[l_part+1] - i_cuts[l_part];
+        for (int i = i_cuts[l_part]; i < i_cuts[l_part+1]; i++)
+          io_costs[i] = (l_sum > 0.) ? io_costs[i] * i_loads[l_part] / l_sum : i_loads[l_part] / l_size;
+      }
+    }
+
+  public:
+    /**
+     * Creates a uniform decomposition, the last block column (row) gets the remaining cells.
+     *
+     * @param i_nX number of cells in x-direction.
+     * @param i_nY number of cells in y-direction.
+     * @param i_blocksX number of blocks in x-direction.
+     * @param i_blocksY number of blocks in y-direction.
+     */
+    Decomposition( int i_nX, int i_nY, int i_blocksX, int i_blocksY ):
+      m_cutsX( uniformCuts(i_nX, i_blocksX) ),
+      m_cutsY( uniformCuts(i_nY, i_blocksY) ) {
+    }
+
+    /**
+     * @return cuts of n cells into parts of n/parts cells, the last part gets the remainder.
+     */
+    static std::vector<int> uniformCuts( int i_n, int i_parts ) {
+      std::vector<int> l_cuts(i_parts+1);
+      for (int l_part = 0; l_part < i_parts; l_part++)
+        l_cuts[l_part] = l_part * (i_n/i_parts);
+      l_cuts[i_parts] = i_n;
+
+      return l_cuts;
+    }
+
+    /**
+     * Cuts the blocks of a decomposition into tiles (see SWE_SparseBlockGrid).
+     * Each block is tiled separately, starting at its lower left corner.
+     *
+     * @param i_blockCuts first cell of each block, followed by the number of cells.
+     * @param i_tileSize number of cells of a tile (<= 0: one tile per block).
+     * @return first cell of each tile, followed by the number of cells.
+     */
+    static std::vector<int> tileCuts(const std::vector<int> &i_blockCuts, int i_tileSize) {
+      std::vector<int> l_cuts;
+      for (size_t l_block = 0; l_block+1 < i_blockCuts.size(); l_block++) {
+        l_cuts.push_back(i_blockCuts[l_block]);
+
+        if (i_tileSize > 0)
+          for (int l_cut = i_blockCuts[l_block] + i_tileSize; l_cut < i_blockCuts[l_block+1]; l_cut += i_tileSize)
+            l_cuts.push_back(l_cut);
+      }
+      l_cuts.push_back(i_blockCuts.back());
+
+      return l_cuts;
+    }
+
+    /**
+     * Cuts a sequence of cell columns (or rows) into parts of about the same cost.
+     *
+     * Each cut is placed at the cell boundary closest to the ideal position in the
+     * prefix sum of the costs.
+     *
+     * @param i_costs cost of each column.
+     * @param i_parts number of parts.
+     * @param i_minSize minimum number of cells of a part.
+     * @return first cell of each part, followed by the number of cells.
+     */
+    static std::vector<int> balancedCuts( const std::vector<double> &i_costs, int i_parts, int i_minSize = 1 ) {
+      const int l_n = i_costs.size();
+      assert(i_minSize >= 1 && i_parts*i_minSize <= l_n);
+
+      std::vector<double> l_prefixSums(l_n+1, 0.);
+      for (int i = 0; i < l_n; i++)
+        l_prefixSums[i+1] = l_prefixSums[i] + i_costs[i];
+
+      if (l_prefixSums[l_n] <= 0.)
+        return uniformCuts(l_n, i_parts);
+
+      std::vector<int> l_cuts(i_parts+1);
+      l_cuts[0] = 0;
+      l_cuts[i_parts] = l_n;
+
+      for (int l_part = 1; l_part < i_parts; l_part++) {
+        const double l_target = l_prefixSums[l_n] * l_part / i_parts;
+
+        int l_cut = std::lower_bound(l_prefixSums.begin(), l_prefixSums.end(), l_target) - l_prefixSums.begin();
+        if (l_cut > 0 && l_target - l_prefixSums[l_cut-1] < l_prefixSums[l_cut] - l_target)
+          l_cut--;
+
+        // leave enough cells for this and the remaining parts
+        l_cut = std::max(l_cut, l_cuts[l_part-1] + i_minSize);
+        l_cut = std::min(l_cut, l_n - (i_parts-l_part) * i_minSize);
+        l_cuts[l_part] = l_cut;
+      }
+
+      return l_cuts;
+    }
+
+    /**
+     * Chooses the process grid with the shortest total length of the edges between
+     * the blocks, i.e. the fewest cells exchanged per time step, for the aspect ratio of the grid.
+     *
+     * @param i_numberOfProcesses number of processes (blocks).
+     * @param i_nX number of cells in x-direction.
+     * @param i_nY number of cells in y-direction.
+     * @return number of block rows, a divisor of the number of processes.
+     */
+    static int processGridRows( int i_numberOfProcesses, int i_nX, int i_nY ) {
+      int l_bestRows = 1;
+      long l_bestLength = -1;
+
+      for (int l_rows = 1; l_rows <= i_numberOfProcesses; l_rows++) {
+        if (i_numberOfProcesses % l_rows != 0)
+          continue;
+
+        // each cut in x-direction is nY cells long, each cut in y-direction nX cells
+        const long l_length = (long) (i_numberOfProcesses/l_rows - 1) * i_nY + (long) (l_rows - 1) * i_nX;
+        if (l_bestLength < 0 || l_length < l_bestLength) {
+          l_bestRows = l_rows;
+          l_bestLength = l_length;
+        }
+      }
+
+      return l_bestRows;
+    }
+
+    /**
+     * Places the processes of a node on a rectangular patch of neighboring blocks, so most
+     * ghost layers are exchanged within the node. The patch has the shortest perimeter
+     * among the patches which tile the process grid.
+     *
+     * @param i_blocksX number of blocks in x-direction.
+     * @param i_blocksY number of blocks in y-direction.
+     * @param i_nX number of cells in x-direction.
+     * @param i_nY number of cells in y-direction.
+     * @param i_processesPerNode number of processes of each node.
+     * @param i_node index of the node.
+     * @param i_nodeRank rank of the process within the node.
+     * @return position of the block of the process (x*blocksY + y),
+     *         -1 if the process grid cannot be tiled by patches of the node size.
+     */
+    static int nodeBlockPosition( int i_blocksX, int i_blocksY, int i_nX, int i_nY,
+                                  int i_processesPerNode, int i_node, int i_nodeRank ) {
+      int l_patchX = 0, l_patchY = 0;
+      double l_bestPerimeter = -1.;
+
+      for (int l_x = 1; l_x <= i_processesPerNode; l_x++) {
+        const int l_y = i_processesPerNode / l_x;
+        if (l_x * l_y != i_processesPerNode || i_blocksX % l_x != 0 || i_blocksY % l_y != 0)
+          continue;
+
+        const double l_perimeter = (double) l_x * i_nX / i_blocksX + (double) l_y * i_nY / i_blocksY;
+        if (l_bestPerimeter < 0. || l_perimeter < l_bestPerimeter) {
+          l_patchX = l_x;
+          l_patchY = l_y;
+          l_bestPerimeter = l_perimeter;
+        }
+      }
+
+      if (l_patchX == 0)
+        return -1;
+
+      // patches are numbered like the blocks (column-major), as are the processes of a patch
+      const int l_patchesY = i_blocksY / l_patchY;
+      const int l_x = (i_node / l_patchesY) * l_patchX + i_nodeRank / l_patchY;
+      const int l_y = (i_node % l_patchesY) * l_patchY + i_nodeRank % l_patchY;
+
+      return l_x * i_blocksY + l_y;
+    }
+
+    /**
+     * Estimates the cost of each cell column and row from the initial water height:
+     * a wet cell costs 1, a dry cell i_dryCost.
+     *
+     * Only every i_numberOfParts-th cell row (starting at i_part) is evaluated,
+     * so the work can be shared by all processes; the sum of all parts is the
+     * cost of the whole grid.
+     *
+     * @param i_scenario the scenario.
+     * @param i_originX x-coordinate of the lower left corner of the grid.
+     * @param i_originY y-coordinate of the lower left corner of the grid.
+     * @param i_dX cell size in x-direction.
+     * @param i_dY cell size in y-direction.
+     * @param i_dryCost cost of a dry cell relative to a wet cell.
+     * @param i_part evaluated part (e.g. MPI rank).
+     * @param i_numberOfParts number of parts (e.g. number of MPI processes).
+     * @param io_columnCosts cost of each cell column, requires nX entries.
+     * @param io_rowCosts cost of each cell row, requires nY entries.
+     */
+    static void estimateCosts( SWE_Scenario &i_scenario,
+                               float i_originX, float i_originY,
+                               float i_dX, float i_dY,
+                               double i_dryCost,
+                               int i_part, int i_numberOfParts,
+                               std::vector<double> &io_columnCosts,
+                               std::vector<double> &io_rowCosts ) {
+      std::fill(io_columnCosts.begin(), io_columnCosts.end(), 0.);
+      std::fill(io_rowCosts.begin(), io_rowCosts.end(), 0.);
+
+      for (size_t j = i_part; j < io_rowCosts.size(); j += i_numberOfParts) {
+        const float l_y = i_originY + (j+.5f)*i_dY;
+
+        for (size_t i = 0; i < io_columnCosts.size(); i++) {
+          const float l_x = i_originX + (i+.5f)*i_dX;
+          const double l_cost = (i_scenario.getWaterHeight(l_x, l_y) > 0.f) ? 1. : i_dryCost;
+
+          io_columnCosts[i] += l_cost;
+          io_rowCosts[j] += l_cost;
+        }
+      }
+    }
+
+    /**
+     * Places the cuts according to the costs of the cell columns and rows.
+     *
+     * @param i_columnCosts cost of each cell column.
+     * @param i_rowCosts cost of each cell row.
+     * @param i_minSize minimum number of cells of a block in each direction.
+     */
+    void balance( const std::vector<double> &i_columnCosts,
+                  const std::vector<double> &i_rowCosts,
+                  int i_minSize = 1 ) {
+      assert((int) i_columnCosts.size() == getNX() && (int) i_rowCosts.size() == getNY());
+
+      m_cutsX = balancedCuts(i_columnCosts, getBlocksX(), i_minSize);
+      m_cutsY = balancedCuts(i_rowCosts, getBlocksY(), i_minSize);
+    }
+
+    /**
+     * Places the cuts according to the measured compute times of the blocks.
+     *
+     * The costs of the cell columns (rows) of each block column (row) are scaled,
+     * such that their sum is the compute time of the block column (row); the costs
+     * within a block column (row) keep their relative weights.
+     *
+     * @param i_columnCosts estimated cost of each cell column.
+     * @param i_rowCosts estimated cost of each cell row.
+     * @param i_blockTimes compute time of each block, block (i,j) at i*blocksY + j (MPI rank).
+     * @param i_minSize minimum number of cells of a block in each direction.
+     */
+    void rebalance( const std::vector<double> &i_columnCosts,
+                    const std::vector<double> &i_rowCosts,
+                    const std::vector<double> &i_blockTimes,
+                    int i_minSize = 1 ) {
+      assert((int) i_blockTimes.size() == getBlocksX()*getBlocksY());
+
+      std::vector<double> l_columnTimes(getBlocksX(), 0.), l_rowTimes(getBlocksY(), 0.);
+      for (int i = 0; i < getBlocksX(); i++)
+        for (int j = 0; j < getBlocksY(); j++) {
+          l_columnTimes[i] += i_blockTimes[i*getBlocksY() + j];
+          l_rowTimes[j] += i_blockTimes[i*getBlocksY() + j];
+        }
+
+      std::vector<double> l_columnCosts(i_columnCosts), l_rowCosts(i_rowCosts);
+      scaleCosts(l_columnCosts, m_cutsX, l_columnTimes);
+      scaleCosts(l_rowCosts, m_cutsY, l_rowTimes);
+
+      balance(l_columnCosts, l_rowCosts, i_minSize);
+    }
+
+    /**
+     * @return ratio of the maximum and the mean load (1: perfectly balanced).
+     */
+    static double imbalance( const std::vector<double> &i_loads ) {
+      double l_sum = 0., l_max = 0.;
+      for (size_t l_part = 0; l_part < i_loads.size(); l_part++) {
+        l_sum += i_loads[l_part];
+        l_max = std::max(l_max, i_loads[l_part]);
+      }
+
+      return (l_sum > 0.) ? l_max * i_loads.size() / l_sum : 1.;
+    }
+
+    /**
+     * Reads the cuts from a file written by write().
+     * The number of blocks and cells has to match this decomposition.
+     *
+     * @return false if the file could not be read or does not match.
+     */
+    bool read( const std::string &i_fileName ) {
+      std::ifstream l_file(i_fileName.c_str());
+
+      int l_blocksX = 0, l_blocksY = 0;
+      l_file >> l_blocksX >> l_blocksY;
+      if (!l_file.good() || l_blocksX != getBlocksX() || l_blocksY != getBlocksY())
+        return false;
+
+      std::vector<int> l_cutsX(l_blocksX+1), l_cutsY(l_blocksY+1);
+      for (int i = 0; i <= l_blocksX; i++)
+        l_file >> l_cutsX[i];
+      for (int j = 0; j <= l_blocksY; j++)
+        l_file >> l_cutsY[j];
+
+      return !l_file.fail() && setCuts(l_cutsX, l_cutsY);
+    }
+
+    /**
+     * Replaces the cuts, e.g. by the decomposition stored in a checkpoint.
+     * The number of blocks and cells has to match this decomposition.
+     *
+     * @return false if the cuts do not match or are invalid.
+     */
+    bool setCuts( const std::vector<int> &i_cutsX, const std::vector<int> &i_cutsY ) {
+      if (i_cutsX.size() != m_cutsX.size() || i_cutsY.size() != m_cutsY.size()
+          || i_cutsX.front() != 0 || i_cutsX.back() != getNX()
+          || i_cutsY.front() != 0 || i_cutsY.back() != getNY())
+        return false;
+
+      for (int i = 0; i < getBlocksX(); i++)
+        if (i_cutsX[i+1] <= i_cutsX[i])
+          return false;
+      for (int j = 0; j < getBlocksY(); j++)
+        if (i_cutsY[j+1] <= i_cutsY[j])
+          return false;
+
+      m_cutsX = i_cutsX;
+      m_cutsY = i_cutsY;
+      return true;
+    }
+
+    /**
+     * Writes the number of blocks and the cuts in x- and y-direction to a text file.
+     */
+    void write( const std::string &i_fileName ) const {
+      std::ofstream l_file(i_fileName.c_str());
+
+      l_file << getBlocksX() << ' ' << getBlocksY() << '\n';
+      for (size_t i = 0; i < m_cutsX.size(); i++)
+        l_file << m_cutsX[i] << (i+1 < m_cutsX.size() ? ' ' : '\n');
+      for (size_t j = 0; j < m_cutsY.size(); j++)
+        l_file << m_cutsY[j] << (j+1 < m_cutsY.size() ? ' ' : '\n');
+    }
+
+    int getBlocksX() const { return m_cutsX.size()-1; }
+    int getBlocksY() const { return m_cutsY.size()-1; }
+
+    int getNX() const { return m_cutsX.back(); }
+    int getNY() const { return m_cutsY.back(); }
+
+    //! @return first cell of block column i
+    int getOffsetX(int i) const { return m_cutsX[i]; }
+    //! @return first cell of block row j
+    int getOffsetY(int j) const { return m_cutsY[j]; }
+
+    //! @return number of cells of block column i
+    int getSizeX(int i) const { return m_cutsX[i+1] - m_cutsX[i]; }
+    //! @return number of cells of block row j
+    int getSizeY(int j) const { return m_cutsY[j+1] - m_cutsY[j]; }
+
+    const std::vector<int>& getCutsX() const { return m_cutsX; }
+    const std::vector<int>& getCutsY() const { return m_cutsY; }
+};
+
+#endif // DECOMPOSITION_HH_
@@ -0,0 +1,395 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Exchange of the ghost layers of a block with its MPI neighbors.
+ */
+
+#ifndef HALOEXCHANGE_HH_
+#define HALOEXCHANGE_HH_
+
+#include <vector>
+
+#include <mpi.h>
+
+#include "blocks/SWE_Block.hh"
+
+namespace tools {
+  class HaloExchange;
+  class SharedHaloWindow;
+}
+
+/**
+ * Non-blocking exchange of the ghost layers with persistent requests.
+ *
+ * h, hu and hv of a layer are packed into one contiguous buffer, so there is
+ * a single message per neighbor and direction. The requests are created once
+ * (MPI_Send_init/MPI_Recv_init) and restarted in every exchange.
+ *
+ * With a depth of 1, all four edges are exchanged at the same time and the
+ * corner cells are skipped, they are not used by the flux computation.
+ *
+ * A depth k > 1 (deep halo) exchanges the k outermost layers of the block.
+ * Each neighbor sends the k layers next to its own overlap, i.e. the blocks
+ * have to overlap by k-1 cells (plus the ghost layer) at each connected edge.
+ * The corners are required in this case: the left and right layers are
+ * exchanged first, then the bottom and top layers are sent with their full
+ * length, which forwards the corners of the diagonal neighbors.
+ *
+ * Neighbors on the same node can exchange the layers through a shared memory
+ * window instead (see SharedHaloWindow): the copy layers are packed directly
+ * into the window, where the neighbor unpacks them. The messages of these
+ * edges are empty and only signal that the layers are ready.
+ *
+ * Usage:
+ * <pre>
+ *   exchange.start();
+ *   ... work that does not access the ghost or copy layers ...
+ *   exchange.wait();
+ * </pre>
+ */
+class tools::HaloExchange {
+  private:
+    //! number of exchanged variables (h, hu, hv)
+    static const int NUMBER_OF_VARIABLES = 3;
+
+    //! number of exchanged layers at each edge
+    const int m_depth;
+
+    //! position of the block among the blocks of the process in x- and y-direction (see tag())
+    int m_position[2];
+
+    //! ghost layers, written by the neighbors (indexed by BoundaryEdge, ordered from the boundary inwards)
+    std::vector<SWE_Block1D*> m_ghostLayers[4];
+
+    //! copy layers, read by the neighbors (same order as the ghost layers of the neighbor)
+    std::vector<SWE_Block1D*> m_copyLayers[4];
+
+    //! first exchanged cell of each layer
+    int m_first[4];
+
+    //! number of exchanged cells of each layer, 0 if there is no neighbor
+    int m_sizes[4];
+
+    //! packed copy layers
+    std::vector<float> m_sendBuffers[4];
+
+    //! packed ghost layers
+    std::vector<float> m_receiveBuffers[4];
+
+    //! MPI ranks of the neighbors
+    int m_neighborRanks[4];
+
+    //! communicator of the neighbor ranks
+    MPI_Comm m_communicator;
+
+    //! persistent requests of the left/right (0) and bottom/top (1) edges, receives first
+    MPI_Request m_requests[2][4];
+
+    //! number of requests in use
+    int m_numberOfRequests[2];
+
+    //! shared memory window of the on-node edges, MPI_WIN_NULL if there is none
+    MPI_Win m_window;
+
+    //! packed copy layers in the shared window (two alternating buffers), 0 if the edge uses messages
+    float* m_sharedSendBuffers[4];
+
+    //! packed copy layers of the neighbor in the shared window (two alternating buffers)
+    const float* m_sharedReceiveBuffers[4];
+
+    //! buffer of the shared window used in the current exchange
+    int m_parity;
+
+    // the requests refer to the buffers, so no copies
+    HaloExchange(const HaloExchange&);
+    HaloExchange& operator=(const HaloExchange&);
+
+    friend class SharedHaloWindow;
+
+    /**
+     * @return the edge of the neighbor which touches the given edge
+     */
+    static int opposite(int i_edge) {
+      return i_edge ^ 1; // BND_LEFT <-> BND_RIGHT, BND_BOTTOM <-> BND_TOP
+    }
+
+    /**
+     * @return 0 for the left and right edge, 1 for the bottom and top edge
+     */
+    static int phase(int i_edge) {
+      return i_edge / 2;
+    }
+
+    /**
+     * @return tag of a message sent across the edge
+     */
+    int tag(int i_edge) const {
+      // the position along the edge distinguishes the blocks of the same two processes
+      return i_edge + 4 * m_position[1 - phase(i_edge)];
+    }
+
+    /**
+     * Packs the copy layers of an edge into the send buffer.
+     */
+    void pack(int i_edge) {
+      const int l_first = m_first[i_edge];
+      const int l_size = m_sizes[i_edge];
+
+      float* l_sendBuffer = (m_sharedSendBuffers[i_edge] != 0)
+                          ? m_sharedSendBuffers[i_edge] + m_parity * getBufferSize(i_edge)
+                          : &m_sendBuffers[i_edge][0];
+
+      for (size_t l_layer = 0; l_layer < m_copyLayers[i_edge].size(); l_layer++) {
+        SWE_Block1D &l_copyLayer = *m_copyLayers[i_edge][l_layer];
+        float* l_buffer = l_sendBuffer + NUMBER_OF_VARIABLES * l_layer * l_size;
+
+#ifdef VECTORIZE
+        #pragma ivdep
+#endif
+        for (int i = 0; i < l_size; i++) {
+          l_buffer[i]            = l_copyLayer.h[l_first + i];
+          l_buffer[l_size + i]   = l_copyLayer.hu[l_first + i];
+          l_buffer[2*l_size + i] = l_copyLayer.hv[l_first + i];
+        }
+      }
+    }
+
+    /**
+     * Unpacks the receive buffer of an edge into the ghost layers.
+     */
+    void unpack(int i_edge) {
+      const int l_first = m_first[i_edge];
+      const int l_size = m_sizes[i_edge];
+
+      const float* l_receiveBuffer = (m_sharedReceiveBuffers[i_edge] != 0)
+                                   ? m_sharedReceiveBuffers[i_edge] + m_parity * getBufferSize(i_edge)
+                                   : &m_receiveBuffers[i_edge][0];
+
+      for (size_t l_layer = 0; l_layer < m_ghostLayers[i_edge].size(); l_layer++) {
+        SWE_Block1D &l_ghostLayer = *m_ghostLayers[i_edge][l_layer];
+        const float* l_buffer = l_receiveBuffer + NUMBER_OF_VARIABLES * l_layer * l_size;
+
+#ifdef VECTORIZE
+        #pragma ivdep
+#endif
+        for (int i = 0; i < l_size; i++) {
+          l_ghostLayer.h[l_first + i]  = l_buffer[i];
+          l_ghostLayer.hu[l_first + i] = l_buffer[l_size + i];
+          l_ghostLayer.hv[l_first + i] = l_buffer[2*l_size + i];
+        }
+      }
+    }
+
+    /**
+     * @return number of floats in the buffer of an edge
+     */
+    int getBufferSize(int i_edge) const {
+      return NUMBER_OF_VARIABLES * m_depth * m_sizes[i_edge];
+    }
+
+    /**
+     * Creates the persistent requests, empty messages for the edges in the shared window.
+     */
+    void createRequests() {
+      m_numberOfRequests[0] = m_numberOfRequests[1] = 0;
+
+      for (int l_edge = 0; l_edge < 4; l_edge++)
+        if (m_sizes[l_edge] > 0)
+          MPI_Recv_init( &m_receiveBuffers[l_edge][0], (m_sharedReceiveBuffers[l_edge] != 0) ? 0 : getBufferSize(l_edge), MPI_FLOAT,
+                         m_neighborRanks[l_edge], tag(opposite(l_edge)), m_communicator,
+                         &m_requests[phase(l_edge)][m_numberOfRequests[phase(l_edge)]++] );
+
+      for (int l_edge = 0; l_edge < 4; l_edge++)
+        if (m_sizes[l_edge] > 0)
+          MPI_Send_init( &m_sendBuffers[l_edge][0], (m_sharedSendBuffers[l_edge] != 0) ? 0 : getBufferSize(l_edge), MPI_FLOAT,
+                         m_neighborRanks[l_edge], tag(l_edge), m_communicator,
+                         &m_requests[phase(l_edge)][m_numberOfRequests[phase(l_edge)]++] );
+    }
+
+    /**
+     * Frees the persistent requests.
+     */
+    void freeRequests() {
+      for (int l_phase = 0; l_phase < 2; l_phase++)
+        for (int l_request = 0; l_request < m_numberOfRequests[l_phase]; l_request++)
+          MPI_Request_free(&m_requests[l_phase][l_request]);
+    }
+
+    /**
+     * Makes the packed layers visible to the neighbors (before the messages are sent)
+     * and the layers of the neighbors visible to this process (after the messages arrived).
+     */
+    void synchronizeWindow() {
+      if (m_window != MPI_WIN_NULL)
+        MPI_Win_sync(m_window);
+    }
+
+  public:
+    /**
+     * Creates the persistent requests.
+     *
+     * A message sent across an edge is tagged with this edge. If a process
+     * has multiple blocks (tiles), the tag includes the position of the block
+     * along the edge; the blocks at the shared edge of two processes have to
+     * be at the same positions.
+     * The ghost layers of the connected edges have to be grabbed
+     * (SWE_Block::grabGhostLayer) by the caller.
+     *
+     * @param i_block the block.
+     * @param i_neighborRanks MPI ranks of the neighbors (MPI_PROC_NULL at the domain boundary).
+     * @param i_depth number of exchanged layers.
+     * @param i_positionX position of the block among the blocks of the process in x-direction.
+     * @param i_positionY position of the block among the blocks of the process in y-direction.
+     * @param i_communicator communicator of the neighbor ranks.
+     */
+    HaloExchange( SWE_Block &i_block,
+                  const int i_neighborRanks[4],
+                  int i_depth = 1,
+                  int i_positionX = 0, int i_positionY = 0,
+                  MPI_Comm i_communicator = MPI_COMM_WORLD ):
+      m_depth(i_depth),
+      m_communicator(i_communicator),
+      m_window(MPI_WIN_NULL),
+      m_parity(0) {
+      m_position[0] = i_positionX;
+      m_position[1] = i_positionY;
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        m_neighborRanks[l_edge] = i_neighborRanks[l_edge];
+        m_sharedSendBuffers[l_edge] = 0;
+        m_sharedReceiveBuffers[l_edge] = 0;
+      }
+
+      for (int l_edge = 0; l_edge < 4; l_edge++) {
+        // a layer includes the ghost cells at both ends
+        const int l_length = (phase(l_edge) == 0) ? i_block.getNy()+2 : i_block.getNx()+2;
+
+        if (i_neighborRanks[l_edge] == MPI_PROC_NULL) {
+          m_first[l_edge] = 0;
+          m_sizes[l_edge] = 0;
+        } else if (m_depth == 1 || phase(l_edge) == 0) {
+          m_first[l_edge] = 1;
+          m_sizes[l_edge] = l_length - 2;
+        } else {
+          m_first[l_edge] = 0;
+          m_sizes[l_edge] = l_length;
+        }
+
+        for (int l_layer = 0; l_layer < m_depth && m_sizes[l_edge] > 0; l_layer++) {
+          m_ghostLayers[l_edge].push_back( i_block.getLayer(BoundaryEdge(l_edge), l_layer) );
+          m_copyLayers[l_edge].push_back( i_block.getLayer(BoundaryEdge(l_edge), 2*m_depth-1 - l_layer) );
+        }
+
+        m_sendBuffers[l_edge].resize(NUMBER_OF_VARIABLES * m_depth * m_sizes[l_edge]);
+        m_receiveBuffers[l_edge].resize(NUMBER_OF_VARIABLES * m_depth * m_sizes[l_edge]);
+      }
+
+      createRequests();
+    }
+
+    /**
+     * Frees the requests (unless MPI is already finalized).
+     */
+    ~HaloExchange() {
+      for (int l_edge = 0; l_edge < 4; l_edge++)
+        for (size_t l_layer = 0; l_layer < m_ghostLayers[l_edge].size(); l_layer++) {
+          delete m_ghostLayers[l_edge][l_layer];
+          delete m_copyLayers[l_edge][l_layer];
+        }
+
+      int l_finalized;
+      MPI_Finalized(&l_finalized);
+      if (!l_finalized)
+        freeRequests();
+    }
+
+    /**
+     * @return number of exchanged layers
+     */
+    int getDepth() const {
+      return m_depth;
+    }
+
+    /**
+     * Packs the copy layers and starts the exchange.
+     * A deep halo starts with the left and right edges only.
+     */
+    void start() {
+      for (int l_edge = 0; l_edge < 4; l_edge++)
+        if (m_depth == 1 || phase(l_edge) == 0)
+          pack(l_edge);
+
+      synchronizeWindow();
+
+      MPI_Startall(m_numberOfRequests[0], m_requests[0]);
+      if (m_depth == 1)
+        MPI_Startall(m_numberOfRequests[1], m_requests[1]);
+    }
+
+    /**
+     * Progresses the exchange without blocking, e.g. from a communication thread.
+     *
+     * @return true if all messages of the first phase arrived (with a depth of 1,
+     *  wait() does not block afterwards).
+     */
+    bool test() {
+      int l_flag;
+      MPI_Testall(m_numberOfRequests[0], m_requests[0], &l_flag, MPI_STATUSES_IGNORE);
+      if (l_flag && m_depth == 1)
+        MPI_Testall(m_numberOfRequests[1], m_requests[1], &l_flag, MPI_STATUSES_IGNORE);
+
+      return l_flag;
+    }
+
+    /**
+     * Waits for the exchange and unpacks the ghost layers.
+     * A deep halo exchanges the bottom and top edges in this call.
+     */
+    void wait() {
+      MPI_Waitall(m_numberOfRequests[0], m_requests[0], MPI_STATUSES_IGNORE);
+
+      if (m_depth > 1) {
+        synchronizeWindow();
+        unpack(BND_LEFT);
+        unpack(BND_RIGHT);
+
+        // the bottom and top layers include the corners received from the left and right neighbors
+        pack(BND_BOTTOM);
+        pack(BND_TOP);
+        synchronizeWindow();
+        MPI_Startall(m_numberOfRequests[1], m_requests[1]);
+      }
+
+      MPI_Waitall(m_numberOfRequests[1], m_requests[1], MPI_STATUSES_IGNORE);
+      synchronizeWindow();
+
+      for (int l_edge = 0; l_edge < 4; l_edge++)
+        if (m_depth == 1 || phase(l_edge) == 1)
+          unpack(l_edge);
+
+      // the neighbors write the other buffer in the next exchange: they cannot start it before
+      // this process started its next exchange, i.e. after the buffer of this exchange is unpacked
+      m_parity = 1 - m_parity;
+    }
+};
+
+#endif // HALOEXCHANGE_HH_
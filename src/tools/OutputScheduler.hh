@@ -0,0 +1,326 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Decides at which time steps the drivers write an output frame.
+ */
+
+#ifndef OUTPUTSCHEDULER_HH_
+#define OUTPUTSCHEDULER_HH_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <sys/time.h>
+
+#include "tools/help.hh"
+
+namespace tools {
+  class OutputScheduler;
+}
+
+/**
+ * Output scheduler shared by all drivers.
+ *
+ * An output frame is written if
+ * - the next multiple of the output interval (in simulated time) is reached,
+ *   clipTimestep() shortens the preceding time step such that this time is
+ *   hit exactly (an interval <= 0 writes a frame after every time step),
+ * - or the maximum change of the water surface (h+b) since the last frame
+ *   exceeds the event threshold (disabled if the threshold is <= 0).
+ *
+ * Both triggers are subject to a wall clock budget: if writing output already
+ * took more than the given fraction of the elapsed wall clock time, the frame
+ * is skipped. The frame at the end of the simulation is always written.
+ *
+ * Usage:
+ * <pre>
+ *   dt = scheduler.clipTimestep(t, dt);
+ *   ... advance the block by dt ...
+ *   if (scheduler.isOutputDue(t, change)) {
+ *     scheduler.beginOutput();
+ *     ... write ...
+ *     scheduler.endOutput(h, b);
+ *   }
+ * </pre>
+ */
+class tools::OutputScheduler {
+  private:
+    //! distance of two regular outputs in simulated time (<= 0: every step)
+    const float m_interval;
+
+    //! end of the simulation
+    const float m_endTime;
+
+    //! maximum fraction of the wall clock time spent on output
+    const float m_maxOutputFraction;
+
+    //! maximum surface change which does not trigger an output (<= 0: disabled)
+    const float m_eventThreshold;
+
+    //! simulation time of the next regular output
+    float m_nextOutputTime;
+
+    //! wall clock time when the scheduler was created
+    const double m_startWallTime;
+
+    //! wall clock time when the current output started
+    double m_outputStartWallTime;
+
+    //! accumulated wall clock time spent on output
+    double m_outputWallTime;
+
+    //! water surface (h+b) of each block at the last output, only allocated for event triggers
+    std::vector<Float2D*> m_lastSurfaces;
+
+    // no copies, the scheduler owns #m_lastSurfaces
+    OutputScheduler(const OutputScheduler&);
+    OutputScheduler& operator=(const OutputScheduler&);
+
+    /**
+     * @return tolerance for comparing simulation times close to i_time.
+     */
+    static float timeTolerance(const float i_time) {
+      return 1e-5f * std::max(1.f, std::abs(i_time));
+    }
+
+    /**
+     * Moves #m_nextOutputTime to the first multiple of the interval after i_time.
+     */
+    void advanceNextOutputTime(const float i_time) {
+      if (m_interval <= 0) {
+        m_nextOutputTime = m_endTime;
+        return;
+      }
+
+      // small tolerance: times within rounding errors of an output time count as reached
+      const float l_next = std::floor(i_time / m_interval + 1e-4f) + 1.f;
+      m_nextOutputTime = std::min(l_next * m_interval, m_endTime);
+    }
+
+  public:
+    /**
+     * @param i_startTime simulation time at which the simulation (re-)starts.
+     * @param i_endTime simulation time at which the simulation ends.
+     * @param i_interval regular outputs are written at multiples of i_interval (<= 0: after every time step).
+     * @param i_maxOutputFraction maximum fraction of the wall clock time spent on output (>= 1: unlimited).
+     * @param i_eventThreshold an additional output is written if the water surface changed by more than this value (<= 0: disabled).
+     */
+    OutputScheduler( const float i_startTime,
+                     const float i_endTime,
+                     const float i_interval = 0.f,
+                     const float i_maxOutputFraction = 1.f,
+                     const float i_eventThreshold = 0.f ):
+      m_interval(i_interval),
+      m_endTime(i_endTime),
+      m_maxOutputFraction(i_maxOutputFraction),
+      m_eventThreshold(i_eventThreshold),
+      m_startWallTime(wallTime()),
+      m_outputStartWallTime(0.),
+      m_outputWallTime(0.) {
+      advanceNextOutputTime(i_startTime);
+    }
+
+    ~OutputScheduler() {
+      for (size_t l_block = 0; l_block < m_lastSurfaces.size(); l_block++)
+        delete m_lastSurfaces[l_block];
+    }
+
+    /**
+     * Clips a time step such that the next output time (or the end of the simulation)
+     * is hit exactly.
+     *
+     * @param i_time current simulation time.
+     * @param i_dt time step proposed by the block (CFL condition).
+     * @return time step to use.
+     */
+    float clipTimestep(const float i_time, const float i_dt) const {
+      const float l_target = (m_interval > 0) ? m_nextOutputTime : m_endTime;
+      return std::min(i_dt, std::max(l_target - i_time, 0.f));
+    }
+
+    /**
+     * @return true if the end of the simulation is reached.
+     */
+    bool isFinished(const float i_time) const {
+      return i_time >= m_endTime - timeTolerance(m_endTime);
+    }
+
+    /**
+     * @return true if the scheduler requires the surface change, see computeSurfaceChange()
+     */
+    bool hasEventTrigger() const {
+      return m_eventThreshold > 0;
+    }
+
+    /**
+     * @return true if all processes will make the same decision in isOutputDue(),
+     *  i.e. the decision depends on the simulation time only.
+     */
+    bool isDeterministic() const {
+      return !hasEventTrigger() && m_maxOutputFraction >= 1;
+    }
+
+    /**
+     * Computes the maximum change of the water surface h+b since the last output.
+     * Only the inner cells are compared, the ghost layers are ignored.
+     *
+     * @param i_h water height (incl. ghost layers).
+     * @param i_b bathymetry (incl. ghost layers).
+     * @param i_block number of the block, if the driver has multiple blocks.
+     * @return max |(h+b) - (h+b)_last|, 0 if no event trigger is set.
+     */
+    float computeSurfaceChange(const Float2D &i_h, const Float2D &i_b, const size_t i_block = 0) const {
+      if (!hasEventTrigger() || i_block >= m_lastSurfaces.size() || m_lastSurfaces[i_block] == 0)
+        return 0.f;
+
+      const Float2D &l_lastSurface = *m_lastSurfaces[i_block];
+      const int l_cols = i_h.getCols();
+      const int l_rows = i_h.getRows();
+      float l_maxChange = 0.f;
+
+      #pragma omp parallel for reduction(max:l_maxChange)
+      for (int i = 1; i < l_cols-1; i++) {
+        const float* l_h = i_h[i];
+        const float* l_b = i_b[i];
+        const float* l_last = l_lastSurface[i];
+        for (int j = 1; j < l_rows-1; j++)
+          l_maxChange = std::max(l_maxChange, std::abs(l_h[j] + l_b[j] - l_last[j]));
+      }
+
+      return l_maxChange;
+    }
+
+    /**
+     * Decides whether an output frame is written at the current time step.
+     * Has to be called exactly once after every time step.
+     *
+     * @param i_time simulation time after the time step.
+     * @param i_surfaceChange result of computeSurfaceChange() (only required for event triggers).
+     * @return true if a frame should be written.
+     */
+    bool isOutputDue(const float i_time, const float i_surfaceChange = 0.f) {
+      // the last frame is always written
+      if (isFinished(i_time))
+        return true;
+
+      bool l_due = false;
+
+      if (m_interval <= 0 || i_time >= m_nextOutputTime - timeTolerance(m_nextOutputTime)) {
+        l_due = true;
+        advanceNextOutputTime(i_time);
+      }
+
+      if (hasEventTrigger() && i_surfaceChange > m_eventThreshold)
+        l_due = true;
+
+      // skip the frame if we already exceeded our budget
+      if (l_due && m_maxOutputFraction < 1) {
+        const double l_elapsed = wallTime() - m_startWallTime;
+        if (m_outputWallTime > m_maxOutputFraction * l_elapsed)
+          l_due = false;
+      }
+
+      return l_due;
+    }
+
+    /**
+     * Starts the wall clock measurement of an output.
+     */
+    void beginOutput() {
+      m_outputStartWallTime = wallTime();
+    }
+
+    /**
+     * Stores the surface of a block for the event trigger.
+     * Drivers with multiple blocks call this for each block before endOutput().
+     *
+     * @param i_h water height written in this frame.
+     * @param i_b bathymetry written in this frame.
+     * @param i_block number of the block.
+     */
+    void storeSurface(const Float2D &i_h, const Float2D &i_b, const size_t i_block = 0) {
+      if (!hasEventTrigger())
+        return;
+
+      if (i_block >= m_lastSurfaces.size())
+        m_lastSurfaces.resize(i_block+1, 0);
+      if (m_lastSurfaces[i_block] == 0)
+        m_lastSurfaces[i_block] = new Float2D(i_h.getCols(), i_h.getRows());
+
+      Float2D &l_lastSurface = *m_lastSurfaces[i_block];
+      const int l_cols = i_h.getCols();
+      const int l_rows = i_h.getRows();
+
+      // inner cells only, see computeSurfaceChange()
+      #pragma omp parallel for
+      for (int i = 1; i < l_cols-1; i++)
+        for (int j = 1; j < l_rows-1; j++)
+          l_lastSurface[i][j] = i_h[i][j] + i_b[i][j];
+    }
+
+    /**
+     * Finishes an output: Updates the output budget.
+     * The surfaces have to be stored with storeSurface().
+     */
+    void endOutput() {
+      m_outputWallTime += wallTime() - m_outputStartWallTime;
+    }
+
+    /**
+     * Finishes an output: Updates the output budget and stores the
+     * surface for the event trigger.
+     *
+     * @param i_h water height written in this frame.
+     * @param i_b bathymetry written in this frame.
+     */
+    void endOutput(const Float2D &i_h, const Float2D &i_b) {
+      storeSurface(i_h, i_b);
+      endOutput();
+    }
+
+    /**
+     * @return simulation time of the next regular output.
+     */
+    float getNextOutputTime() const {
+      return m_nextOutputTime;
+    }
+
+    /**
+     * @return wall clock time spent on output so far.
+     */
+    double getOutputWallTime() const {
+      return m_outputWallTime;
+    }
+
+    /**
+     * @return current wall clock time in seconds.
+     */
+    static double wallTime() {
+      struct timeval l_time;
+      gettimeofday(&l_time, 0);
+      return l_time.tv_sec + l_time.tv_usec * 1e-6;
+    }
+};
+
+#endif /* OUTPUTSCHEDULER_HH_ */
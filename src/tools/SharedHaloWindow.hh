@@ -0,0 +1,184 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Shared memory window for the halo exchange with neighbors on the same node.
+ */
+
+#ifndef SHAREDHALOWINDOW_HH_
+#define SHAREDHALOWINDOW_HH_
+
+#include <vector>
+
+#include <mpi.h>
+
+#include "tools/HaloExchange.hh"
+
+namespace tools {
+  class SharedHaloWindow;
+}
+
+/**
+ * Moves the halo exchange with the neighbors on the same node into an
+ * MPI-3 shared memory window.
+ *
+ * The processes of a node are determined with
+ * MPI_Comm_split_type(MPI_COMM_TYPE_SHARED). Each process allocates the send
+ * buffers of all its on-node edges (twice, the exchanges alternate between
+ * the two buffers) in one window. The neighbor reads the packed layers
+ * directly from this window, the messages of these edges are empty and only
+ * signal that the layers are ready. Edges to other nodes keep using messages.
+ *
+ * The constructor and the destructor are collective over the communicator:
+ * all processes have to take part, also if they have no on-node neighbors.
+ * The window has to be freed after the halo exchanges are deleted.
+ */
+class tools::SharedHaloWindow {
+  private:
+    //! processes on the same node
+    MPI_Comm m_nodeCommunicator;
+
+    //! the window with the send buffers of this process
+    MPI_Win m_window;
+
+    //! number of edges exchanged through the window
+    int m_numberOfSharedEdges;
+
+    // no copies, the window is freed collectively
+    SharedHaloWindow(const SharedHaloWindow&);
+    SharedHaloWindow& operator=(const SharedHaloWindow&);
+
+  public:
+    /**
+     * Allocates the window and switches the on-node edges of the halo exchanges to it.
+     * Must not be called during an exchange.
+     *
+     * @param io_exchanges the halo exchanges of this process.
+     * @param i_communicator communicator of the neighbor ranks.
+     */
+    SharedHaloWindow( std::vector<HaloExchange*> &io_exchanges,
+                      MPI_Comm i_communicator = MPI_COMM_WORLD ):
+      m_numberOfSharedEdges(0) {
+      MPI_Comm_split_type(i_communicator, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &m_nodeCommunicator);
+
+      MPI_Group l_group, l_nodeGroup;
+      MPI_Comm_group(i_communicator, &l_group);
+      MPI_Comm_group(m_nodeCommunicator, &l_nodeGroup);
+
+      // find the neighbors on the same node, these get two send buffers in the window
+      std::vector<int> l_nodeRanks(4 * io_exchanges.size(), MPI_UNDEFINED);
+      std::vector<MPI_Aint> l_offsets(4 * io_exchanges.size(), 0);
+      MPI_Aint l_windowSize = 0;
+
+      for (size_t l_exchange = 0; l_exchange < io_exchanges.size(); l_exchange++)
+        for (int l_edge = 0; l_edge < 4; l_edge++) {
+          const HaloExchange &l_haloExchange = *io_exchanges[l_exchange];
+          if (l_haloExchange.m_sizes[l_edge] == 0)
+            continue;
+
+          MPI_Group_translate_ranks( l_group, 1, &l_haloExchange.m_neighborRanks[l_edge],
+                                     l_nodeGroup, &l_nodeRanks[4*l_exchange + l_edge] );
+          if (l_nodeRanks[4*l_exchange + l_edge] == MPI_UNDEFINED)
+            continue;
+
+          l_offsets[4*l_exchange + l_edge] = l_windowSize;
+          l_windowSize += 2 * l_haloExchange.getBufferSize(l_edge);
+          m_numberOfSharedEdges++;
+        }
+
+      MPI_Group_free(&l_group);
+      MPI_Group_free(&l_nodeGroup);
+
+      float* l_base;
+      MPI_Win_allocate_shared( l_windowSize * sizeof(float), sizeof(float), MPI_INFO_NULL,
+                               m_nodeCommunicator, &l_base, &m_window );
+
+      // a passive target epoch for the whole run, required by MPI_Win_sync
+      MPI_Win_lock_all(MPI_MODE_NOCHECK, m_window);
+
+      // tell the neighbors where the layers of the shared edge start in the window of this process
+      std::vector<MPI_Aint> l_neighborOffsets(l_offsets.size(), 0);
+      std::vector<MPI_Request> l_requests;
+
+      for (size_t l_exchange = 0; l_exchange < io_exchanges.size(); l_exchange++)
+        for (int l_edge = 0; l_edge < 4; l_edge++) {
+          const int l_index = 4*l_exchange + l_edge;
+          if (l_nodeRanks[l_index] == MPI_UNDEFINED)
+            continue;
+
+          const HaloExchange &l_haloExchange = *io_exchanges[l_exchange];
+          l_requests.push_back(MPI_REQUEST_NULL);
+          MPI_Irecv( &l_neighborOffsets[l_index], 1, MPI_AINT, l_haloExchange.m_neighborRanks[l_edge],
+                     l_haloExchange.tag(HaloExchange::opposite(l_edge)), i_communicator, &l_requests.back() );
+          l_requests.push_back(MPI_REQUEST_NULL);
+          MPI_Isend( &l_offsets[l_index], 1, MPI_AINT, l_haloExchange.m_neighborRanks[l_edge],
+                     l_haloExchange.tag(l_edge), i_communicator, &l_requests.back() );
+        }
+
+      if (!l_requests.empty())
+        MPI_Waitall(l_requests.size(), &l_requests[0], MPI_STATUSES_IGNORE);
+
+      for (size_t l_exchange = 0; l_exchange < io_exchanges.size(); l_exchange++) {
+        HaloExchange &l_haloExchange = *io_exchanges[l_exchange];
+        bool l_shared = false;
+
+        for (int l_edge = 0; l_edge < 4; l_edge++) {
+          const int l_index = 4*l_exchange + l_edge;
+          if (l_nodeRanks[l_index] == MPI_UNDEFINED)
+            continue;
+
+          MPI_Aint l_neighborSize;
+          int l_displacementUnit;
+          float* l_neighborBase;
+          MPI_Win_shared_query(m_window, l_nodeRanks[l_index], &l_neighborSize, &l_displacementUnit, &l_neighborBase);
+
+          l_haloExchange.m_sharedSendBuffers[l_edge] = l_base + l_offsets[l_index];
+          l_haloExchange.m_sharedReceiveBuffers[l_edge] = l_neighborBase + l_neighborOffsets[l_index];
+          l_shared = true;
+        }
+
+        if (l_shared) {
+          // replace the messages of the shared edges by empty ones
+          l_haloExchange.freeRequests();
+          l_haloExchange.createRequests();
+          l_haloExchange.m_window = m_window;
+        }
+      }
+    }
+
+    /**
+     * Frees the window (collective).
+     */
+    ~SharedHaloWindow() {
+      MPI_Win_unlock_all(m_window);
+      MPI_Win_free(&m_window);
+      MPI_Comm_free(&m_nodeCommunicator);
+    }
+
+    /**
+     * @return number of edges of this process which are exchanged through the window
+     */
+    int getNumberOfSharedEdges() const {
+      return m_numberOfSharedEdges;
+    }
+};
+
+#endif // SHAREDHALOWINDOW_HH_
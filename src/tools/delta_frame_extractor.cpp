@@ -0,0 +1,79 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Lists the frames of a delta file (written by io::DeltaWriter) or
+ * extracts one frame as CSV.
+ *
+ * Built by scons as build/delta_frame_extractor, or (in src/):
+ *   g++ -I. tools/delta_frame_extractor.cpp writer/DeltaReader.cpp -o delta_frame_extractor
+ *
+ * Usage:
+ *   delta_frame_extractor <file.delta>          lists all frames
+ *   delta_frame_extractor <file.delta> <frame>  prints x,y,h,hu,hv,b of all cells
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include "writer/DeltaReader.hh"
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " <file.delta> [frame]" << std::endl;
+		return 1;
+	}
+
+	io::DeltaReader reader(argv[1]);
+	if (!reader.isValid())
+		return 1;
+
+	const io::DeltaFileHeader &header = reader.getHeader();
+
+	if (argc < 3) {
+		std::cout << "cells: " << header.nX << " x " << header.nY
+				<< ", tile size: " << header.tileSize
+				<< ", tolerance: " << header.tolerance << std::endl;
+		for (size_t f = 0; f < reader.getNumberOfFrames(); f++)
+			std::cout << f << '\t' << reader.getTime(f)
+					<< (reader.isKeyframe(f) ? "\tkeyframe" : "") << '\n';
+		return 0;
+	}
+
+	const size_t frame = std::atol(argv[2]);
+	if (frame >= reader.getNumberOfFrames()) {
+		std::cerr << "Frame " << frame << " does not exist" << std::endl;
+		return 1;
+	}
+
+	Float2D h(header.nX, header.nY), hu(header.nX, header.nY),
+		hv(header.nX, header.nY), b(header.nX, header.nY);
+	reader.readFrame(frame, h, hu, hv, b);
+
+	std::cout << "x,y,h,hu,hv,b\n";
+	for (unsigned int j = 0; j < header.nY; j++)
+		for (unsigned int i = 0; i < header.nX; i++)
+			std::cout << header.originX + (i+.5f)*header.dX << ','
+					<< header.originY + (j+.5f)*header.dY << ','
+					<< h[i][j] << ',' << hu[i][j] << ',' << hv[i][j] << ',' << b[i][j] << '\n';
+
+	return 0;
+}
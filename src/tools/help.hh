@@ -30,6 +30,7 @@
 #define __HELP_HH
 
 #include <math.h>
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <fstream>
@@ -212,48 +213,155 @@ class Float2D {
 		return Float1D(elem + j, cols, rows);
 	};
 
-	static Float2D compress(const Float2D &input, int compress, int cutColsLeft, int cutColsRight, int cutRowsBot, int cutRowsTop) {
-	
-		// Create temporary matrix to store compressed data to
-//		std::cout << "writing with compression " << compress << std::endl;
-		Float2D tmp((int) ceil((input.getCols() - cutColsLeft - cutColsRight) / (float) compress), (int) ceil((input.getRows() - cutRowsBot - cutRowsTop) / (float) compress));
-//		std::cout << "matrix cols: " << input.getCols() << ", matrix rows: " << input.getRows() << ", compressed cols: " << tmp.getCols() << ", compressed rows: " << tmp.getRows() << std::endl;
-		// Define variables for building average over one block average
-		float currentValue;
-		int div;
-		// Fill each cell of the compressed matrix
-		for(int _x = 0; _x < tmp.getCols(); _x++) {
-			for(int _y = 0; _y < tmp.getRows(); _y++) {
-//				std::cout << "writing at cell [" << _x << ", " << _y << "]: ";
-				// Initialize average variables
-				currentValue = 0;
-				div = 0;
-				// Iterate over the initial matrix' compression blocks
-				for(int _orig_x = _x * compress;
-					// compression boundary
-					_orig_x < (_x + 1) * compress &&
-					// for the last block make sure to not iterate out of the original matrix
-					_orig_x < input.getCols() - cutColsLeft - cutColsRight;
-					_orig_x++) {
-					for(int _orig_y = _y * compress;
-						// compression boundary
-						_orig_y < (_y + 1) * compress &&
-						// original boundary
-						_orig_y < input.getRows() - cutRowsBot - cutRowsTop;
-						_orig_y++) {
-						// Add the original value to the currentValue buffer and increase the amount of values in this block by one
-						currentValue += input[_orig_x + cutColsLeft][_orig_y + cutRowsBot];
-						div++;
-//						std::cout << "[" << _orig_x + cutColsLeft << ", " <<
-//							_orig_y + cutRowsBot << "]: " <<
-//							input[_orig_x + cutColsLeft][_orig_y + cutRowsBot] << ", ";
+	/**
+	 * Reductions which can be used by compress() to combine the cells of one block
+	 */
+	enum CompressReducer {
+		COMPRESS_MEAN,    //!< average of all cells
+		COMPRESS_MIN,     //!< minimum of all cells
+		COMPRESS_MAX,     //!< maximum of all cells (e.g. for hazard maps)
+		COMPRESS_WET_MEAN //!< average of all wet cells (h > 0), 0 if all cells are dry
+	};
+
+	/**
+	 * @return size of a compressed dimension
+	 */
+	static int compressedSize(int size, int compress) {
+		return (size + compress - 1) / compress;
+	}
+
+	/**
+	 * Downsamples an array by combining blocks of compress x compress cells into one cell.
+	 * The blocks at the right and the top border may be smaller.
+	 *
+	 * The result is written to a buffer provided by the caller, thus the buffer can be reused
+	 * for all time steps. The loop over the compressed columns is parallelized with OpenMP,
+	 * the inner loops access consecutive memory and can be vectorized.
+	 *
+	 * @param input array to compress.
+	 * @param output compressed array, requires at least compressedSize() columns and rows.
+	 * @param compress number of cells combined in each direction.
+	 * @param cutColsLeft number of columns at the left side which are ignored (e.g. ghost cells).
+	 * @param cutColsRight number of columns at the right side which are ignored.
+	 * @param cutRowsBot number of rows at the bottom which are ignored.
+	 * @param cutRowsTop number of rows at the top which are ignored.
+	 * @param reducer reduction used to combine the cells of a block.
+	 * @param waterHeight water height used to identify wet cells for COMPRESS_WET_MEAN,
+	 *  if 0, the input is the water height.
+	 */
+	static void compress(const Float2D &input, Float2D &output, int compress,
+			int cutColsLeft, int cutColsRight, int cutRowsBot, int cutRowsTop,
+			CompressReducer reducer = COMPRESS_MEAN, const Float2D *waterHeight = 0) {
+
+		const int inCols = input.getCols() - cutColsLeft - cutColsRight;
+		const int inRows = input.getRows() - cutRowsBot - cutRowsTop;
+		const int outCols = compressedSize(inCols, compress);
+		const int outRows = compressedSize(inRows, compress);
+		assert(output.getCols() >= outCols && output.getRows() >= outRows);
+
+		const Float2D &wet = (waterHeight != 0) ? *waterHeight : input;
+
+		#pragma omp parallel
+		{
+			// values (and number of wet cells) of all rows, reduced over the columns of a block
+			float* colValue = new float[inRows];
+			float* colCount = new float[inRows];
+
+			#pragma omp for
+			for(int x = 0; x < outCols; x++) {
+				const int firstCol = x * compress + cutColsLeft;
+				const int numCols = std::min(compress, inCols - x * compress);
+
+				// Reduce the columns of the block
+				const float* in = input[firstCol] + cutRowsBot;
+				const float* h = wet[firstCol] + cutRowsBot;
+				for(int r = 0; r < inRows; r++) {
+					colValue[r] = (reducer == COMPRESS_WET_MEAN) ? ((h[r] > 0) ? in[r] : 0) : in[r];
+					colCount[r] = (h[r] > 0) ? 1 : 0;
+				}
+
+				for(int c = 1; c < numCols; c++) {
+					in = input[firstCol+c] + cutRowsBot;
+					h = wet[firstCol+c] + cutRowsBot;
+
+					switch(reducer) {
+					case COMPRESS_MEAN:
+#ifdef VECTORIZE
+						#pragma ivdep
+#endif
+						for(int r = 0; r < inRows; r++)
+							colValue[r] += in[r];
+						break;
+					case COMPRESS_MIN:
+#ifdef VECTORIZE
+						#pragma ivdep
+#endif
+						for(int r = 0; r < inRows; r++)
+							colValue[r] = std::min(colValue[r], in[r]);
+						break;
+					case COMPRESS_MAX:
+#ifdef VECTORIZE
+						#pragma ivdep
+#endif
+						for(int r = 0; r < inRows; r++)
+							colValue[r] = std::max(colValue[r], in[r]);
+						break;
+					case COMPRESS_WET_MEAN:
+#ifdef VECTORIZE
+						#pragma ivdep
+#endif
+						for(int r = 0; r < inRows; r++) {
+							colValue[r] += (h[r] > 0) ? in[r] : 0;
+							colCount[r] += (h[r] > 0) ? 1 : 0;
+						}
+						break;
 					}
 				}
-//				std::cout << "=> " << currentValue << "/" << div << "=" << (currentValue / div) << std::endl;
-				// write calculated average to compressed matrix
-				tmp[_x][_y] = currentValue / div;
+
+				// Reduce the rows of each block
+				float* out = output[x];
+				for(int y = 0; y < outRows; y++) {
+					const int firstRow = y * compress;
+					const int lastRow = std::min(firstRow + compress, inRows);
+
+					float value = colValue[firstRow], count = colCount[firstRow];
+					for(int r = firstRow+1; r < lastRow; r++) {
+						switch(reducer) {
+						case COMPRESS_MIN:
+							value = std::min(value, colValue[r]);
+							break;
+						case COMPRESS_MAX:
+							value = std::max(value, colValue[r]);
+							break;
+						default:
+							value += colValue[r];
+							count += colCount[r];
+						}
+					}
+
+					if (reducer == COMPRESS_MEAN)
+						value /= numCols * (lastRow - firstRow);
+					else if (reducer == COMPRESS_WET_MEAN)
+						value = (count > 0) ? value / count : 0;
+
+					out[y] = value;
+				}
 			}
+
+			delete [] colValue;
+			delete [] colCount;
 		}
+	}
+
+	/**
+	 * Averages blocks of compress x compress cells.
+	 *
+	 * @deprecated Allocates a new array for every call, use the version with an output buffer.
+	 */
+	static Float2D compress(const Float2D &input, int compress, int cutColsLeft, int cutColsRight, int cutRowsBot, int cutRowsTop) {
+		Float2D tmp(compressedSize(input.getCols() - cutColsLeft - cutColsRight, compress),
+				compressedSize(input.getRows() - cutRowsBot - cutRowsTop, compress));
+		Float2D::compress(input, tmp, compress, cutColsLeft, cutColsRight, cutRowsBot, cutRowsTop);
 		return tmp;
 	}
 
@@ -331,14 +439,15 @@ inline std::string generateFileName(std::string baseName, int timeStep, int bloc
  * @param i_blockPositionX position of the SWE_Block in x-direction.
  * @param i_blockPositionY position of the SWE_Block in y-direction.
  *
- * @return the output filename <b>without</b> timestep information and file extension
+ * @return the output filename <b>without</b> timestep information and file extension,
+ *   e.g. base_1_11 (separated positions, unique for any number of blocks)
  */
 inline
 std::string generateBaseFileName(std::string &i_baseName, int i_blockPositionX , int i_blockPositionY)
 {
 	  std::ostringstream l_fileName;
 
-	  l_fileName << i_baseName << "_" << i_blockPositionX << i_blockPositionY;
+	  l_fileName << i_baseName << "_" << i_blockPositionX << "_" << i_blockPositionY;
 	  return l_fileName.str();
 }
 
@@ -346,10 +455,10 @@ std::string generateBaseFileName(std::string &i_baseName, int i_blockPositionX ,
  * generate output filename for the ParaView-Container-File
  * (to visualize multiple SWE_Blocks per checkpoint)
  */
-inline std::string generateContainerFileName(std::string baseName, int timeStep) {
+inline std::string generateContainerFileName(std::string baseName, int timeStep, std::string i_fileExtension=".pvts") {
 
 	std::ostringstream FileName;
-	FileName << baseName<<"_"<<timeStep<<".pvts";
+	FileName << baseName<<"_"<<timeStep<<i_fileExtension;
 	return FileName.str();
 };
 /**
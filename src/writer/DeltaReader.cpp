@@ -0,0 +1,153 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Reader for files written by io::DeltaWriter.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include "DeltaReader.hh"
+
+/**
+ * Opens a delta file and builds the frame index.
+ * Incomplete frames at the end of the file (e.g. from an aborted run) are ignored.
+ *
+ * @param i_fileName name of the file (incl. extension).
+ */
+io::DeltaReader::DeltaReader(const std::string &i_fileName)
+	: file(i_fileName.c_str(), std::ios::binary),
+	  tilesX(0), tilesY(0)
+{
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file.good() || std::memcmp(header.magic, "SWEDELTA", sizeof(header.magic)) != 0
+			|| header.version != 1) {
+		std::cerr << "Not a valid delta file: " << i_fileName << std::endl;
+		return;
+	}
+
+	tilesX = (header.nX + header.tileSize - 1) / header.tileSize;
+	tilesY = (header.nY + header.tileSize - 1) / header.tileSize;
+	bitmap.resize((tilesX*tilesY + 7) / 8);
+
+	// size of the file, required to detect incomplete frames
+	const std::streampos l_start = file.tellg();
+	file.seekg(0, std::ios::end);
+	const std::streampos l_end = file.tellg();
+	file.seekg(l_start);
+
+	while (true) {
+		DeltaFrameHeader l_frameHeader;
+		file.read(reinterpret_cast<char*>(&l_frameHeader), sizeof(l_frameHeader));
+		if (!file.good())
+			break;
+
+		const std::streampos l_position = file.tellg();
+		for (unsigned int v = 0; v < DELTA_NUM_VARIABLES && file.good(); v++)
+			readVariable(l_frameHeader.type, 0);
+
+		if (!file.good() || file.tellg() > l_end)
+			break;
+
+		framePositions.push_back(l_position);
+		frameHeaders.push_back(l_frameHeader);
+	}
+
+	file.clear();
+}
+
+/**
+ * Reads one variable of a frame at the current file position.
+ *
+ * @param i_type type of the frame.
+ * @param o_values values of the variable (column by column), updated with the
+ *  stored cells; if 0, the variable is skipped.
+ */
+void io::DeltaReader::readVariable(unsigned int i_type, float* o_values)
+{
+	const unsigned int l_nX = header.nX, l_nY = header.nY;
+
+	if (i_type == DELTA_KEYFRAME) {
+		if (o_values)
+			file.read(reinterpret_cast<char*>(o_values), l_nX*l_nY*sizeof(float));
+		else
+			file.seekg(l_nX*l_nY*sizeof(float), std::ios::cur);
+		return;
+	}
+
+	file.read(reinterpret_cast<char*>(&bitmap[0]), bitmap.size());
+
+	for (unsigned int l_tileX = 0; l_tileX < tilesX; l_tileX++) {
+		const unsigned int l_startX = l_tileX*header.tileSize;
+		const unsigned int l_endX = std::min(l_startX+header.tileSize, l_nX);
+
+		for (unsigned int l_tileY = 0; l_tileY < tilesY; l_tileY++) {
+			if (!isTileChanged(l_tileX*tilesY + l_tileY))
+				continue;
+
+			const unsigned int l_startY = l_tileY*header.tileSize;
+			const unsigned int l_endY = std::min(l_startY+header.tileSize, l_nY);
+
+			if (o_values)
+				for (unsigned int i = l_startX; i < l_endX; i++)
+					file.read(reinterpret_cast<char*>(&o_values[i*l_nY + l_startY]),
+							(l_endY-l_startY)*sizeof(float));
+			else
+				file.seekg((l_endX-l_startX)*(l_endY-l_startY)*sizeof(float), std::ios::cur);
+		}
+	}
+}
+
+/**
+ * Reconstructs a frame from the preceding keyframe and the delta frames in between.
+ *
+ * @param i_frame number of the frame.
+ * @param o_h water height, requires nX columns and nY rows.
+ * @param o_hu momentum in x-direction.
+ * @param o_hv momentum in y-direction.
+ * @param o_b bathymetry.
+ */
+void io::DeltaReader::readFrame( size_t i_frame,
+		Float2D &o_h, Float2D &o_hu, Float2D &o_hv, Float2D &o_b )
+{
+	assert(i_frame < getNumberOfFrames());
+
+	Float2D* l_variables[DELTA_NUM_VARIABLES] = { &o_h, &o_hu, &o_hv, &o_b };
+	for (unsigned int v = 0; v < DELTA_NUM_VARIABLES; v++)
+		assert(l_variables[v]->getCols() == (int) header.nX
+				&& l_variables[v]->getRows() == (int) header.nY);
+
+	size_t l_keyframe = i_frame;
+	while (!isKeyframe(l_keyframe)) {
+		assert(l_keyframe > 0);
+		l_keyframe--;
+	}
+
+	for (size_t f = l_keyframe; f <= i_frame; f++) {
+		file.seekg(framePositions[f]);
+		for (unsigned int v = 0; v < DELTA_NUM_VARIABLES; v++)
+			readVariable(frameHeaders[f].type, l_variables[v]->elemVector());
+	}
+
+	assert(file.good());
+}
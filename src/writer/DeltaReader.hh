@@ -0,0 +1,107 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Reader for files written by io::DeltaWriter.
+ */
+
+#ifndef DELTAREADER_HH_
+#define DELTAREADER_HH_
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "writer/DeltaWriter.hh"
+
+namespace io {
+	class DeltaReader;
+}
+
+/**
+ * Reconstructs arbitrary frames of a delta file.
+ *
+ * The constructor builds an index of all frames. A frame is reconstructed
+ * from the preceding keyframe and all delta frames in between.
+ */
+class io::DeltaReader
+{
+private:
+	std::ifstream file;
+
+	DeltaFileHeader header;
+
+	//! number of tiles in each direction
+	unsigned int tilesX, tilesY;
+
+	//! file position of each frame (after the frame header)
+	std::vector<std::streampos> framePositions;
+
+	//! frame headers
+	std::vector<DeltaFrameHeader> frameHeaders;
+
+	//! bitmap of changed tiles
+	std::vector<unsigned char> bitmap;
+
+	bool isTileChanged(unsigned int i_tile) const
+	{
+		return bitmap[i_tile / 8] & (1 << (i_tile % 8));
+	}
+
+	// reads (or skips) one variable of a frame
+	void readVariable(unsigned int i_type, float* o_values);
+
+public:
+	DeltaReader(const std::string &i_fileName);
+
+	/**
+	 * @return false if the file could not be read
+	 */
+	bool isValid() const
+	{
+		return framePositions.size() > 0;
+	}
+
+	const DeltaFileHeader& getHeader() const
+	{
+		return header;
+	}
+
+	size_t getNumberOfFrames() const
+	{
+		return framePositions.size();
+	}
+
+	float getTime(size_t i_frame) const
+	{
+		return frameHeaders[i_frame].time;
+	}
+
+	bool isKeyframe(size_t i_frame) const
+	{
+		return frameHeaders[i_frame].type == DELTA_KEYFRAME;
+	}
+
+	// reconstructs a frame
+	void readFrame( size_t i_frame,
+			Float2D &o_h, Float2D &o_hu, Float2D &o_hv, Float2D &o_b );
+};
+
+#endif // DELTAREADER_HH_
@@ -0,0 +1,222 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Writer for delta-encoded output.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include "DeltaWriter.hh"
+
+/**
+ * Creates a delta file.
+ * Any existing file will be replaced.
+ *
+ * @param i_baseName base name of the file, the extension ".delta" is added.
+ * @param i_nX number of cells in the horizontal direction.
+ * @param i_nY number of cells in the vertical direction.
+ * @param i_dX cell size in x-direction.
+ * @param i_dY cell size in y-direction.
+ * @param i_originX
+ * @param i_originY
+ * @param i_keyframeInterval every i_keyframeInterval-th frame contains all cells.
+ * @param i_tolerance tiles are only written if a cell changed by more than i_tolerance.
+ * @param i_tileSize number of cells of a tile in each direction.
+ */
+io::DeltaWriter::DeltaWriter( const std::string &i_baseName,
+		const Float2D &i_b,
+		const BoundarySize &i_boundarySize,
+		int i_nX, int i_nY,
+		float i_dX, float i_dY,
+		float i_originX, float i_originY,
+		unsigned int i_keyframeInterval,
+		float i_tolerance,
+		unsigned int i_tileSize ) :
+	io::Writer(i_baseName + ".delta", i_b, i_boundarySize, i_nX, i_nY),
+	keyframeInterval(std::max(i_keyframeInterval, 1u)),
+	tolerance(i_tolerance),
+	tileSize(std::max(i_tileSize, 1u))
+{
+	tilesX = (nX + tileSize - 1) / tileSize;
+	tilesY = (nY + tileSize - 1) / tileSize;
+
+	for (unsigned int v = 0; v < DELTA_NUM_VARIABLES; v++)
+		reference[v].resize(nX*nY);
+	changedTiles.resize(tilesX*tilesY);
+	bitmap.resize((tilesX*tilesY + 7) / 8);
+
+	file.open(fileName.c_str(), std::ios::binary | std::ios::trunc);
+	assert(file.good());
+
+	DeltaFileHeader l_header;
+	std::memcpy(l_header.magic, "SWEDELTA", sizeof(l_header.magic));
+	l_header.version = 1;
+	l_header.nX = nX;
+	l_header.nY = nY;
+	l_header.tileSize = tileSize;
+	l_header.keyframeInterval = keyframeInterval;
+	l_header.tolerance = tolerance;
+	l_header.dX = i_dX;
+	l_header.dY = i_dY;
+	l_header.originX = i_originX;
+	l_header.originY = i_originY;
+
+	file.write(reinterpret_cast<const char*>(&l_header), sizeof(l_header));
+}
+
+/**
+ * Writes one variable of a frame and updates the reference values.
+ *
+ * @param i_variable variable (incl. boundary).
+ * @param io_reference reference values of the variable.
+ * @param i_keyframe write all cells?
+ */
+void io::DeltaWriter::writeVariable( const Float2D &i_variable,
+		std::vector<float> &io_reference,
+		bool i_keyframe )
+{
+	if (i_keyframe) {
+		for (unsigned int i = 0; i < nX; i++)
+			std::copy(i_variable[i+boundarySize[0]] + boundarySize[2],
+					i_variable[i+boundarySize[0]] + boundarySize[2] + nY,
+					&io_reference[i*nY]);
+
+		file.write(reinterpret_cast<const char*>(&io_reference[0]), nX*nY*sizeof(float));
+		return;
+	}
+
+	// Find the changed tiles and update the reference, tiles are independent
+	#pragma omp parallel for
+	for (int l_tileX = 0; l_tileX < (int) tilesX; l_tileX++) {
+		const unsigned int l_endX = std::min((l_tileX+1)*tileSize, nX);
+
+		for (unsigned int l_tileY = 0; l_tileY < tilesY; l_tileY++) {
+			const unsigned int l_startY = l_tileY*tileSize;
+			const unsigned int l_endY = std::min(l_startY+tileSize, nY);
+
+			float l_maxChange = 0;
+			for (unsigned int i = l_tileX*tileSize; i < l_endX; i++) {
+				const float* l_values = i_variable[i+boundarySize[0]] + boundarySize[2];
+				const float* l_reference = &io_reference[i*nY];
+				for (unsigned int j = l_startY; j < l_endY; j++)
+					l_maxChange = std::max(l_maxChange, std::abs(l_values[j] - l_reference[j]));
+			}
+
+			const bool l_changed = l_maxChange > tolerance;
+			changedTiles[l_tileX*tilesY + l_tileY] = l_changed;
+
+			if (l_changed)
+				for (unsigned int i = l_tileX*tileSize; i < l_endX; i++)
+					std::copy(i_variable[i+boundarySize[0]] + boundarySize[2] + l_startY,
+							i_variable[i+boundarySize[0]] + boundarySize[2] + l_endY,
+							&io_reference[i*nY + l_startY]);
+		}
+	}
+
+	// Bitmap
+	std::fill(bitmap.begin(), bitmap.end(), 0);
+	for (unsigned int t = 0; t < changedTiles.size(); t++)
+		if (changedTiles[t])
+			bitmap[t / 8] |= 1 << (t % 8);
+	file.write(reinterpret_cast<const char*>(&bitmap[0]), bitmap.size());
+
+	// Changed tiles, column by column
+	for (unsigned int l_tileX = 0; l_tileX < tilesX; l_tileX++) {
+		const unsigned int l_endX = std::min((l_tileX+1)*tileSize, nX);
+
+		for (unsigned int l_tileY = 0; l_tileY < tilesY; l_tileY++) {
+			if (!changedTiles[l_tileX*tilesY + l_tileY])
+				continue;
+
+			const unsigned int l_startY = l_tileY*tileSize;
+			const unsigned int l_endY = std::min(l_startY+tileSize, nY);
+
+			for (unsigned int i = l_tileX*tileSize; i < l_endX; i++)
+				file.write(reinterpret_cast<const char*>(&io_reference[i*nY + l_startY]),
+						(l_endY-l_startY)*sizeof(float));
+		}
+	}
+}
+
+/**
+ * Writes one frame.
+ *
+ * @param i_variables h, hu, hv and b.
+ * @param i_time simulation time of the frame.
+ */
+void io::DeltaWriter::writeFrame( const Float2D* i_variables[DELTA_NUM_VARIABLES],
+		float i_time )
+{
+	DeltaFrameHeader l_header;
+	l_header.time = i_time;
+	l_header.type = (timeStep % keyframeInterval == 0) ? DELTA_KEYFRAME : DELTA_FRAME;
+	file.write(reinterpret_cast<const char*>(&l_header), sizeof(l_header));
+
+	for (unsigned int v = 0; v < DELTA_NUM_VARIABLES; v++)
+		writeVariable(*i_variables[v], reference[v], l_header.type == DELTA_KEYFRAME);
+
+	file.flush();
+	assert(file.good());
+
+	// Increment timeStep for next call
+	timeStep++;
+}
+
+/**
+ * Writes the unknowns at a given time step.
+ *
+ * @param i_h water heights at a given time step.
+ * @param i_hu momentums in x-direction at a given time step.
+ * @param i_hv momentums in y-direction at a given time step.
+ * @param i_time simulation time of the time step.
+ */
+void io::DeltaWriter::writeTimeStep( const Float2D &i_h,
+		const Float2D &i_hu,
+		const Float2D &i_hv,
+		float i_time,
+		bool i_writeBathymetry )
+{
+	// the bathymetry is part of every keyframe, unchanged tiles cost one bit
+	const Float2D* l_variables[DELTA_NUM_VARIABLES] = { &i_h, &i_hu, &i_hv, &b };
+	writeFrame(l_variables, i_time);
+}
+
+/**
+ * Writes the unknowns and the bathymetry at a given time step.
+ *
+ * @param i_h water heights at a given time step.
+ * @param i_hu momentums in x-direction at a given time step.
+ * @param i_hv momentums in y-direction at a given time step.
+ * @param i_b bathymetry at a given time step.
+ * @param i_time simulation time of the time step.
+ */
+void io::DeltaWriter::writeTimeStep( const Float2D &i_h,
+		const Float2D &i_hu,
+		const Float2D &i_hv,
+		const Float2D &i_b,
+		float i_time )
+{
+	const Float2D* l_variables[DELTA_NUM_VARIABLES] = { &i_h, &i_hu, &i_hv, &i_b };
+	writeFrame(l_variables, i_time);
+}
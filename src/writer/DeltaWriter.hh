@@ -0,0 +1,154 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Writer for delta-encoded output: keyframes contain all cells, the frames
+ * in between only contain the tiles which changed.
+ */
+
+#ifndef DELTAWRITER_HH_
+#define DELTAWRITER_HH_
+
+#include <fstream>
+#include <vector>
+#include "writer/Writer.hh"
+
+namespace io {
+	struct DeltaFileHeader;
+	struct DeltaFrameHeader;
+	class DeltaWriter;
+
+	//! number of variables in each frame (h, hu, hv, b)
+	const unsigned int DELTA_NUM_VARIABLES = 4;
+
+	//! frame types
+	enum DeltaFrameType { DELTA_KEYFRAME = 0, DELTA_FRAME = 1 };
+}
+
+/**
+ * Header at the beginning of a delta file
+ */
+struct io::DeltaFileHeader
+{
+	//! "SWEDELTA"
+	char magic[8];
+	unsigned int version;
+
+	//! number of cells in x- and y-direction
+	unsigned int nX, nY;
+
+	//! number of cells of a tile in each direction
+	unsigned int tileSize;
+
+	//! every keyframeInterval-th frame is a keyframe
+	unsigned int keyframeInterval;
+
+	//! maximum error of cells which are not stored in a frame
+	float tolerance;
+
+	float dX, dY;
+	float originX, originY;
+};
+
+/**
+ * Header of each frame
+ *
+ * Keyframes are followed by all inner cells of h, hu, hv and b (column by column).
+ * Other frames contain for each variable a bitmap of the changed tiles
+ * (column by column, one bit per tile) followed by the cells of these tiles.
+ */
+struct io::DeltaFrameHeader
+{
+	float time;
+	unsigned int type;
+};
+
+/**
+ * Writes delta-encoded frames.
+ *
+ * A tile is written if any of its cells differs by more than the tolerance
+ * from the value a reader reconstructs from the previous frames. Thus the
+ * error of a reconstructed frame is bounded by the tolerance and does not
+ * accumulate over time.
+ *
+ * Use io::DeltaReader to reconstruct the frames.
+ */
+class io::DeltaWriter : public io::Writer
+{
+private:
+	//! the output file
+	std::ofstream file;
+
+	//! every keyframeInterval-th frame is a keyframe
+	const unsigned int keyframeInterval;
+
+	//! maximum error of cells which are not stored in a frame
+	const float tolerance;
+
+	//! number of cells of a tile in each direction
+	const unsigned int tileSize;
+
+	//! number of tiles in each direction
+	unsigned int tilesX, tilesY;
+
+	//! values a reader reconstructs from the frames written so far (inner cells, column by column)
+	std::vector<float> reference[DELTA_NUM_VARIABLES];
+
+	//! tiles which changed in the current frame (one entry per tile)
+	std::vector<unsigned char> changedTiles;
+
+	//! packed bitmap of the changed tiles
+	std::vector<unsigned char> bitmap;
+
+	void writeFrame( const Float2D* i_variables[DELTA_NUM_VARIABLES],
+			float i_time );
+
+	void writeVariable( const Float2D &i_variable,
+			std::vector<float> &io_reference,
+			bool i_keyframe );
+
+public:
+	DeltaWriter( const std::string &i_fileName,
+			const Float2D &i_b,
+			const BoundarySize &i_boundarySize,
+			int i_nX, int i_nY,
+			float i_dX, float i_dY,
+			float i_originX = 0., float i_originY = 0.,
+			unsigned int i_keyframeInterval = 10,
+			float i_tolerance = 1e-3f,
+			unsigned int i_tileSize = 16 );
+
+	// writes the unknowns at a given time step
+	void writeTimeStep( const Float2D &i_h,
+			const Float2D &i_hu,
+			const Float2D &i_hv,
+			float i_time,
+			bool i_writeBathymetry = true );
+
+	// writes the unknowns and a time dependent bathymetry at a given time step
+	void writeTimeStep( const Float2D &i_h,
+			const Float2D &i_hu,
+			const Float2D &i_hv,
+			const Float2D &i_b,
+			float i_time );
+};
+
+#endif // DELTAWRITER_HH_
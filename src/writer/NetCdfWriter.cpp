@@ -57,7 +57,10 @@ inline void adjust(unsigned int &nx, unsigned int &ny, float &dx, float &dy, int
  * @param i_originX
  * @param i_originY
  * @param i_flush If > 0, flush data to disk every i_flush write operation
- * @param i_dynamicBathymetry
+ * @param contTimestep If > 0, append to an existing file starting at this time step
+ * @param compression Write a [nX/compression]x[nY/compression] grid
+ * @param i_variables Variables which are written (see NetCdfVariables)
+ * @param i_reducer Combines the cells of h, hu and hv if compressed (e.g. COMPRESS_MAX for hazard maps)
  */
 io::NetCdfWriter::NetCdfWriter( const std::string &i_baseName,
 		const Float2D &i_b,
@@ -67,11 +70,16 @@ io::NetCdfWriter::NetCdfWriter( const std::string &i_baseName,
 		float i_originX, float i_originY,
 		unsigned int i_flush,
 		size_t contTimestep,
-		unsigned int compression) :
+		unsigned int compression,
+		unsigned int i_variables,
+		Float2D::CompressReducer i_reducer) :
 		//const bool  &i_dynamicBathymetry) : //!TODO
   io::Writer(i_baseName + ".nc", i_b, i_boundarySize, i_nX, i_nY, contTimestep),
-  flush(i_flush), compress(compression) {
+  hVar(-1), huVar(-1), hvVar(-1), bVar(-1),
+  flush(i_flush), compress(compression), variables(i_variables), reducer(i_reducer),
+  offsetX(0), offsetY(0), parallel(false) {
 	int status;
+	adjust(nX, nY, i_dX, i_dY, compress);
 	if(contTimestep)
 	{
 		status = nc_open(fileName.c_str(), NC_WRITE, &dataFile);
@@ -85,10 +93,14 @@ io::NetCdfWriter::NetCdfWriter( const std::string &i_baseName,
 
 		size_t l_length;
 		if(status = nc_inq_varid(dataFile, "time", &timeVar)) ERR(status);
-		if(status = nc_inq_varid(dataFile, "h", &hVar)) ERR(status);
-		if(status = nc_inq_varid(dataFile, "hu", &huVar)) ERR(status);
-		if(status = nc_inq_varid(dataFile, "hv", &hvVar)) ERR(status);
-		if(status = nc_inq_varid(dataFile, "b", &bVar)) ERR(status);
+		if(variables & VAR_H)
+			if(status = nc_inq_varid(dataFile, "h", &hVar)) ERR(status);
+		if(variables & VAR_HU)
+			if(status = nc_inq_varid(dataFile, "hu", &huVar)) ERR(status);
+		if(variables & VAR_HV)
+			if(status = nc_inq_varid(dataFile, "hv", &hvVar)) ERR(status);
+		if(variables & VAR_B)
+			if(status = nc_inq_varid(dataFile, "b", &bVar)) ERR(status);
 		//if(status = nc_inq_dimlen(dataFile, timeVar, &timeStep)) ERR(status);
 	}
 	else {
@@ -101,67 +113,148 @@ io::NetCdfWriter::NetCdfWriter( const std::string &i_baseName,
 			return;
 		}
 
-//		std::cout << "i_nX, i_nY, i_dX, i_dY: " << nX << ", " << nY << ", " << i_dX << ", " << i_dY << std::endl;
-		adjust(nX, nY, i_dX, i_dY, compress);
-//		std::cout << "i_nX, i_nY, i_dX, i_dY: " << nX << ", " << nY << ", " << i_dX << ", " << i_dY << std::endl;
+		defineFile(nX, nY, i_dX, i_dY, i_originX, i_originY);
+	}
+}
 
+#ifdef USEMPI
+/**
+ * Create a netCdf-file shared by all processes of a communicator (collective).
+ * Each process writes its block into the global grid of the file with collective
+ * hyperslab writes (netCDF-4 parallel I/O, see nc_create_par).
+ * Any existing file will be replaced.
+ *
+ * @param i_baseName base name of the netCDF-file to which the data will be written to.
+ * @param i_nX number of cells of the block in the horizontal direction.
+ * @param i_nY number of cells of the block in the vertical direction.
+ * @param i_dX cell size in x-direction.
+ * @param i_dY cell size in y-direction.
+ * @param i_offsetX first cell of the block in x-direction.
+ * @param i_offsetY first cell of the block in y-direction.
+ * @param i_globalNX number of cells of the global grid in x-direction.
+ * @param i_globalNY number of cells of the global grid in y-direction.
+ * @param i_globalOriginX origin of the global grid.
+ * @param i_globalOriginY
+ * @param i_communicator processes sharing the file, each process writes one block.
+ * @param i_flush If > 0, flush data to disk every i_flush write operation
+ */
+io::NetCdfWriter::NetCdfWriter( const std::string &i_baseName,
+		const Float2D &i_b,
+		const BoundarySize &i_boundarySize,
+		int i_nX, int i_nY,
+		float i_dX, float i_dY,
+		int i_offsetX, int i_offsetY,
+		int i_globalNX, int i_globalNY,
+		float i_globalOriginX, float i_globalOriginY,
+		MPI_Comm i_communicator,
+		unsigned int i_flush) :
+  io::Writer(i_baseName + ".nc", i_b, i_boundarySize, i_nX, i_nY),
+  hVar(-1), huVar(-1), hvVar(-1), bVar(-1),
+  flush(i_flush), compress(1), variables(VAR_ALL), reducer(Float2D::COMPRESS_MEAN),
+  offsetX(i_offsetX), offsetY(i_offsetY), parallel(true) {
+	//create a netCDF-file, an existing file will be replaced
+	int status = nc_create_par(fileName.c_str(), NC_NETCDF4 | NC_MPIIO, i_communicator, MPI_INFO_NULL, &dataFile);
+
+	//check if the netCDF-file creation constructor succeeded.
+	if (status != NC_NOERR) {
+		assert(false);
+		return;
+	}
+
+	// the coordinates are written by the first process only
+	int l_rank;
+	MPI_Comm_rank(i_communicator, &l_rank);
+	defineFile(i_globalNX, i_globalNY, i_dX, i_dY, i_globalOriginX, i_globalOriginY, l_rank == 0);
+
+	// the time dimension is unlimited, its variables have to be extended collectively
+	if(status = nc_var_par_access(dataFile, timeVar, NC_COLLECTIVE)) ERR(status);
+	if(status = nc_var_par_access(dataFile, hVar, NC_COLLECTIVE)) ERR(status);
+	if(status = nc_var_par_access(dataFile, huVar, NC_COLLECTIVE)) ERR(status);
+	if(status = nc_var_par_access(dataFile, hvVar, NC_COLLECTIVE)) ERR(status);
+	if(status = nc_var_par_access(dataFile, bVar, NC_COLLECTIVE)) ERR(status);
+}
+#endif
+
+/**
+ * Defines the dimensions, the variables and the attributes of a new file
+ * and writes the coordinates of the cell centers.
+ *
+ * @param i_nX number of cells of the file in the horizontal direction.
+ * @param i_nY number of cells of the file in the vertical direction.
+ * @param i_dX cell size in x-direction.
+ * @param i_dY cell size in y-direction.
+ * @param i_originX
+ * @param i_originY
+ * @param i_writeCoordinates write the coordinates (false: another process writes them)
+ */
+void io::NetCdfWriter::defineFile( unsigned int i_nX, unsigned int i_nY,
+		float i_dX, float i_dY,
+		float i_originX, float i_originY,
+		bool i_writeCoordinates ) {
 #ifdef PRINT_NETCDFWRITER_INFORMATION
-		std::cout << "   *** io::NetCdfWriter::createNetCdfFile" << std::endl;
-		std::cout << "     created/replaced: " << fileName << std::endl;
-		std::cout << "     dimensions(nx, ny): " << nX << ", " << nY << std::endl;
-		std::cout << "     cell width(dx,dy): " << i_dX << ", " << i_dY << std::endl;
-		std::cout << "     origin(x,y): " << i_originX << ", " << i_originY << std::endl;
+	std::cout << "   *** io::NetCdfWriter::createNetCdfFile" << std::endl;
+	std::cout << "     created/replaced: " << fileName << std::endl;
+	std::cout << "     dimensions(nx, ny): " << i_nX << ", " << i_nY << std::endl;
+	std::cout << "     cell width(dx,dy): " << i_dX << ", " << i_dY << std::endl;
+	std::cout << "     origin(x,y): " << i_originX << ", " << i_originY << std::endl;
 #endif
 
-		//dimensions
-		int l_timeDim, l_xDim, l_yDim;
-		nc_def_dim(dataFile, "time", NC_UNLIMITED, &l_timeDim);
-		nc_def_dim(dataFile, "x", nX, &l_xDim);
-		nc_def_dim(dataFile, "y", nY, &l_yDim);
-	
-		//variables (TODO: add rest of CF-1.5)
-		int l_xVar, l_yVar;
-	
-		nc_def_var(dataFile, "time", NC_FLOAT, 1, &l_timeDim, &timeVar);
-		ncPutAttText(timeVar, "long_name", "Time");
-		ncPutAttText(timeVar, "units", "seconds since simulation start"); // the word "since" is important for the paraview reader
-	
-		nc_def_var(dataFile, "x", NC_FLOAT, 1, &l_xDim, &l_xVar);
-		nc_def_var(dataFile, "y", NC_FLOAT, 1, &l_yDim, &l_yVar);
-	
-		//variables, fastest changing index is on the right (C syntax), will be mirrored by the library
-		int dims[] = {l_timeDim, l_yDim, l_xDim};
+	//dimensions
+	int l_timeDim, l_xDim, l_yDim;
+	nc_def_dim(dataFile, "time", NC_UNLIMITED, &l_timeDim);
+	nc_def_dim(dataFile, "x", i_nX, &l_xDim);
+	nc_def_dim(dataFile, "y", i_nY, &l_yDim);
+
+	//variables (TODO: add rest of CF-1.5)
+	int l_xVar, l_yVar;
+
+	nc_def_var(dataFile, "time", NC_FLOAT, 1, &l_timeDim, &timeVar);
+	ncPutAttText(timeVar, "long_name", "Time");
+	ncPutAttText(timeVar, "units", "seconds since simulation start"); // the word "since" is important for the paraview reader
+
+	nc_def_var(dataFile, "x", NC_FLOAT, 1, &l_xDim, &l_xVar);
+	nc_def_var(dataFile, "y", NC_FLOAT, 1, &l_yDim, &l_yVar);
+
+	//variables, fastest changing index is on the right (C syntax), will be mirrored by the library
+	int dims[] = {l_timeDim, l_yDim, l_xDim};
+	if(variables & VAR_H)
 		nc_def_var(dataFile, "h",  NC_FLOAT, 3, dims, &hVar);
+	if(variables & VAR_HU)
 		nc_def_var(dataFile, "hu", NC_FLOAT, 3, dims, &huVar);
+	if(variables & VAR_HV)
 		nc_def_var(dataFile, "hv", NC_FLOAT, 3, dims, &hvVar);
+	if(variables & VAR_B)
 		nc_def_var(dataFile, "b",  NC_FLOAT, 3, dims, &bVar);
-	
-		//set attributes to match CF-1.5 convention
-		ncPutAttText(NC_GLOBAL, "Conventions", "CF-1.5");
-		ncPutAttText(NC_GLOBAL, "title", "Computed tsunami solution");
-		ncPutAttText(NC_GLOBAL, "history", "SWE");
-		ncPutAttText(NC_GLOBAL, "institution", "Technische Universitaet Muenchen, Department of Informatics, Chair of Scientific Computing");
-		ncPutAttText(NC_GLOBAL, "source", "Bathymetry and displacement data.");
-		ncPutAttText(NC_GLOBAL, "references", "http://www5.in.tum.de/SWE");
-		ncPutAttText(NC_GLOBAL, "comment", "SWE is free software and licensed under the GNU General Public License. Remark: In general this does not hold for the used input data.");
-	
-		//setup grid size
-		
+
+	//set attributes to match CF-1.5 convention
+	ncPutAttText(NC_GLOBAL, "Conventions", "CF-1.5");
+	ncPutAttText(NC_GLOBAL, "title", "Computed tsunami solution");
+	ncPutAttText(NC_GLOBAL, "history", "SWE");
+	ncPutAttText(NC_GLOBAL, "institution", "Technische Universitaet Muenchen, Department of Informatics, Chair of Scientific Computing");
+	ncPutAttText(NC_GLOBAL, "source", "Bathymetry and displacement data.");
+	ncPutAttText(NC_GLOBAL, "references", "http://www5.in.tum.de/SWE");
+	ncPutAttText(NC_GLOBAL, "comment", "SWE is free software and licensed under the GNU General Public License. Remark: In general this does not hold for the used input data.");
+
+	// leave the define mode explicitly, it is collective for a shared file
+	nc_enddef(dataFile);
+
+	//setup grid size
+	if (i_writeCoordinates) {
 		float gridPosition = i_originX + (float).5 * i_dX;
-		for(size_t i = 0; i < nX; i++) {
+		for(size_t i = 0; i < i_nX; i++) {
 			nc_put_var1_float(dataFile, l_xVar, &i, &gridPosition);
 
 			gridPosition += i_dX;
 		}
-	
+
 		gridPosition = i_originY + (float).5 * i_dY;
-		for(size_t j = 0; j < nY; j++) {
+		for(size_t j = 0; j < i_nY; j++) {
 			nc_put_var1_float(dataFile, l_yVar, &j, &gridPosition);
-	
-	    		gridPosition += i_dY;
+
+			gridPosition += i_dY;
 		}
-		nc_sync(dataFile);
 	}
+	nc_sync(dataFile);
 }
 
 #ifdef EXCLUDE_SCENARIO
@@ -183,7 +276,7 @@ io::NetCdfWriter::NetCdfWriter( const std::string &i_baseName,
 		float i_dX, float i_dY,
 		float i_originX, float i_originY) : 
 	io::Writer(i_baseName + ".nc", i_b,{{1, 1, 1, 1}}, i_nX, i_nY),
-	flush(0) {
+	flush(0), offsetX(0), offsetY(0), parallel(false) {
 		int status;
 		status = nc_create(fileName.c_str(), NC_NETCDF4, &dataFile);
 	
@@ -273,8 +366,10 @@ io::NetCdfWriter::NetCdfWriter( const std::string &i_baseName,
 		bool useCheckpoints,
 		unsigned int compression) :
 	io::Writer(i_baseName + ".nc", i_b, i_boundarySize, i_nX, i_nY),
-	flush(i_flush), compress(compression) {
+	flush(i_flush), compress(compression), variables(VAR_ALL), reducer(Float2D::COMPRESS_MEAN),
+	offsetX(0), offsetY(0), parallel(false) {
 	int retVal;
+	adjust(nX, nY, i_dX, i_dY, compress);
 
 	if(useCheckpoints)
 	{
@@ -305,10 +400,6 @@ io::NetCdfWriter::NetCdfWriter( const std::string &i_baseName,
 			return;
 		}
 
-//		std::cout << "i_nX, i_nY, i_dX, i_dY: " << nX << ", " << nY << ", " << i_dX << ", " << i_dY << std::endl;
-		adjust(nX, nY, i_dX, i_dY, compress);
-//		std::cout << "i_nX, i_nY, i_dX, i_dY: " << nX << ", " << nY << ", " << i_dX << ", " << i_dY << std::endl;
-
 	    //create a netCDF-file, an existing file will be replaced
 	    /*int status = nc_create(fileName.c_str(), NC_NETCDF4, &dataFile);
 	
@@ -407,6 +498,36 @@ io::NetCdfWriter::~NetCdfWriter() {
 	nc_close(dataFile);
 }
 #endif
+
+/**
+ * Removes the boundary of a variable and compresses it, if required.
+ *
+ * @param i_matrix array which contains the variable.
+ * @param o_colStride distance of two columns in the returned array.
+ * @param i_reducer combines the cells of a compressed cell.
+ * @param i_waterHeight water height of the wet cells for COMPRESS_WET_MEAN, 0 if i_matrix is the water height.
+ * @return inner cells of the variable, stored column wise.
+ */
+const float* io::NetCdfWriter::prepareVariable( const Float2D &i_matrix,
+                                                int &o_colStride,
+                                                Float2D::CompressReducer i_reducer,
+                                                const Float2D *i_waterHeight ) {
+	if (compress <= 1) {
+		// nothing to do, write the inner cells directly
+		o_colStride = i_matrix.getRows();
+		return i_matrix[boundarySize[0]] + boundarySize[2];
+	}
+
+	compressBuffer.resize(nX*nY);
+	Float2D l_compressed(nX, nY, &compressBuffer[0]);
+	Float2D::compress(i_matrix, l_compressed, compress,
+			boundarySize[0], boundarySize[1], boundarySize[2], boundarySize[3],
+			i_reducer, i_waterHeight);
+
+	o_colStride = nY;
+	return &compressBuffer[0];
+}
+
 /**
  * Writes time dependent data to a netCDF-file (-> constructor) with respect to the boundary sizes.
  *
@@ -418,10 +539,18 @@ io::NetCdfWriter::~NetCdfWriter() {
  * @param i_matrix array which contains time dependent data.
  * @param i_boundarySize size of the boundaries.
  * @param i_ncVariable time dependent netCDF-variable to which the output is written to.
+ * @param i_waterHeight water height for the reducer COMPRESS_WET_MEAN, 0 if i_matrix is the water height.
  */
 void io::NetCdfWriter::writeVarTimeDependent( const Float2D &i_matrix,
-                                              int i_ncVariable ) {
-	Float2D tmp = Float2D::compress(i_matrix, compress, boundarySize[0], boundarySize[1], boundarySize[2], boundarySize[3]);
+                                              int i_ncVariable,
+                                              const Float2D *i_waterHeight ) {
+	if (parallel) {
+		writeVarParallel(i_matrix, i_ncVariable, timeStep);
+		return;
+	}
+
+	int l_colStride;
+	const float* l_data = prepareVariable(i_matrix, l_colStride, reducer, i_waterHeight);
 	//write col wise, necessary to get rid of the boundary
 	//storage in Float2D is col wise
 	//read carefully, the dimensions are confusing
@@ -430,7 +559,7 @@ void io::NetCdfWriter::writeVarTimeDependent( const Float2D &i_matrix,
 	for(int col = 0; col < nX; col++) {
 		start[2] = col; //select col (dim "x")
 		nc_put_vara_float(dataFile, i_ncVariable, start, count,
-				&tmp[col][0]); //write col
+				l_data + col*l_colStride); //write col
 	}
 }
 
@@ -448,7 +577,14 @@ void io::NetCdfWriter::writeVarTimeDependent( const Float2D &i_matrix,
  */
 void io::NetCdfWriter::writeVarTimeIndependent( const Float2D &i_matrix,
                                                 int i_ncVariable ) {
-	Float2D tmp = Float2D::compress(i_matrix, compress, boundarySize[0], boundarySize[1], boundarySize[2], boundarySize[3]);
+	if (parallel) {
+		// the bathymetry is stored in the first time step
+		writeVarParallel(i_matrix, i_ncVariable, 0);
+		return;
+	}
+
+	int l_colStride;
+	const float* l_data = prepareVariable(i_matrix, l_colStride);
 	//write col wise, necessary to get rid of the boundary2
 	//storage in Float2D is col wise
 	//read carefully, the dimensions are confusing
@@ -457,10 +593,35 @@ void io::NetCdfWriter::writeVarTimeIndependent( const Float2D &i_matrix,
 	for(int col = 0; col < nX; col++) {
 		start[1] = col; //select col (dim "x")
 		nc_put_vara_float(dataFile, i_ncVariable, start, count,
-				&tmp[col][0]); //write col
+				l_data + col*l_colStride); //write col
 	}
 }
 
+/**
+ * Writes the inner cells of the block into the global grid of a shared file.
+ *
+ * The block is written with a single collective call, the number of calls must
+ * not depend on the size of the block. The columns are transposed, the x-dimension
+ * is the fastest changing index in the file.
+ *
+ * @param i_matrix array which contains the data.
+ * @param i_ncVariable netCDF-variable (dimensions time, y and x) to which the output is written to.
+ * @param i_timeStep time step of the output.
+ */
+void io::NetCdfWriter::writeVarParallel( const Float2D &i_matrix,
+                                         int i_ncVariable,
+                                         size_t i_timeStep ) {
+	compressBuffer.resize(nX*nY);
+	for(unsigned int col = 0; col < nX; col++)
+		for(unsigned int row = 0; row < nY; row++)
+			compressBuffer[row*nX + col] = i_matrix[boundarySize[0] + col][boundarySize[2] + row];
+
+	size_t start[] = {i_timeStep, offsetY, offsetX};
+	size_t count[] = {1, nY, nX};
+	int status;
+	if(status = nc_put_vara_float(dataFile, i_ncVariable, start, count, &compressBuffer[0])) ERR(status);
+}
+
 /**
  * Writes the unknwons to a netCDF-file (-> constructor) with respect to the boundary sizes.
  *
@@ -489,7 +650,7 @@ void io::NetCdfWriter::writeTimeStep( const Float2D &i_h,
 			}
 	*/
 
-	if (timeStep == 0 && i_writeBathymetry)
+	if (timeStep == 0 && i_writeBathymetry && (variables & VAR_B))
 		// Write bathymetry
 		writeVarTimeIndependent(b, bVar);
 
@@ -497,13 +658,16 @@ void io::NetCdfWriter::writeTimeStep( const Float2D &i_h,
 	nc_put_var1_float(dataFile, timeVar, &timeStep, &i_time);
 
 	//write water height
-	writeVarTimeDependent(i_h, hVar);
+	if (variables & VAR_H)
+		writeVarTimeDependent(i_h, hVar);
 
 	//write momentum in x-direction
-	writeVarTimeDependent(i_hu, huVar);
+	if (variables & VAR_HU)
+		writeVarTimeDependent(i_hu, huVar, &i_h);
 
 	//write momentum in y-direction
-	writeVarTimeDependent(i_hv, hvVar);
+	if (variables & VAR_HV)
+		writeVarTimeDependent(i_hv, hvVar, &i_h);
 
 	// Increment timeStep for next call
 	timeStep++;
@@ -530,16 +694,20 @@ void io::NetCdfWriter::writeTimeStep( const Float2D &i_h,
 	nc_put_var1_float(dataFile, timeVar, &timeStep, &i_time);
 
 	//write water height
-	writeVarTimeDependent(i_h, hVar);
+	if (variables & VAR_H)
+		writeVarTimeDependent(i_h, hVar);
 
 	//write momentum in x-direction
-	writeVarTimeDependent(i_hu, huVar);
+	if (variables & VAR_HU)
+		writeVarTimeDependent(i_hu, huVar, &i_h);
 
 	//write momentum in y-direction
-	writeVarTimeDependent(i_hv, hvVar);
+	if (variables & VAR_HV)
+		writeVarTimeDependent(i_hv, hvVar, &i_h);
 
 	//write bathymetry
-	writeVarTimeDependent(i_b, bVar);
+	if (variables & VAR_B)
+		writeVarTimeDependent(i_b, bVar);
 
 	// Increment timeStep for next call
 	timeStep++;
@@ -40,6 +40,9 @@
 #endif
 #endif
 #include <netcdf.h>
+#ifdef USEMPI
+#include <netcdf_par.h>
+#endif
 #ifdef MPI_INCLUDED_NETCDF
 #undef MPI_INCLUDED
 #undef MPI_INCLUDED_NETCDF
@@ -52,6 +55,12 @@
 
 namespace io {
   class NetCdfWriter;
+
+  //! variables written by the NetCdfWriter (bit mask)
+  enum NetCdfVariables {
+    VAR_H = 1, VAR_HU = 2, VAR_HV = 4, VAR_B = 8,
+    VAR_ALL = VAR_H | VAR_HU | VAR_HV | VAR_B
+  };
 }
 
 class io::NetCdfWriter : public io::Writer {
@@ -68,14 +77,47 @@ private:
     /** Writer will make a [m/compress]x[n/compress] out of a [m]x[n] domain */
     unsigned int compress;
 
+    /** Variables which are written (see NetCdfVariables) */
+    unsigned int variables;
+
+    /** Reduction which combines the cells of h, hu and hv (compress > 1), the bathymetry is averaged */
+    Float2D::CompressReducer reducer;
+
+    /** Buffer for the compressed variables, reused for all variables */
+    std::vector<float> compressBuffer;
+
+    /** Position of the block in the file (shared file of all processes) */
+    size_t offsetX, offsetY;
+
+    /** Are the variables written collectively to a file shared by all processes? */
+    bool parallel;
+
+    // defines the dimensions, variables and attributes of a new file
+    void defineFile( unsigned int i_nX, unsigned int i_nY,
+                     float i_dX, float i_dY,
+                     float i_originX, float i_originY,
+                     bool i_writeCoordinates = true );
+
+    // returns the (compressed) inner cells of a variable
+    const float* prepareVariable( const Float2D &i_matrix,
+                                  int &o_colStride,
+                                  Float2D::CompressReducer i_reducer = Float2D::COMPRESS_MEAN,
+                                  const Float2D *i_waterHeight = 0 );
+
     // writer time dependent variables.
     void writeVarTimeDependent( const Float2D &i_matrix,
-                                int i_ncVariable);
+                                int i_ncVariable,
+                                const Float2D *i_waterHeight = 0);
 
     // writes time independent variables.
     void writeVarTimeIndependent( const Float2D &i_matrix,
                                   int i_ncVariable);
 
+    // writes the block of this process into a shared file (collective)
+    void writeVarParallel( const Float2D &i_matrix,
+                           int i_ncVariable,
+                           size_t i_timeStep );
+
 
   public:
 	NetCdfWriter(const std::string &i_fileName,
@@ -86,7 +128,22 @@ private:
 					float i_originX = 0., float i_originY = 0.,
 					unsigned int i_flush = 0,
 					size_t contTimestep = 0,
-					unsigned int compression = 1);
+					unsigned int compression = 1,
+					unsigned int i_variables = VAR_ALL,
+					Float2D::CompressReducer i_reducer = Float2D::COMPRESS_MEAN);
+
+#ifdef USEMPI
+	NetCdfWriter(const std::string &i_fileName,
+					const Float2D &i_b,
+					const BoundarySize &i_boundarySize,
+					int i_nX, int i_nY,
+					float i_dX, float i_dY,
+					int i_offsetX, int i_offsetY,
+					int i_globalNX, int i_globalNY,
+					float i_globalOriginX, float i_globalOriginY,
+					MPI_Comm i_communicator,
+					unsigned int i_flush = 0);
+#endif
 
 #ifdef EXCLUDE_SCENARIO
  	NetCdfWriter( const std::string &i_baseName,
@@ -0,0 +1,198 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Output of multiple regions of interest.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include "RegionOutput.hh"
+
+/**
+ * Creates the output files of all windows which intersect the block.
+ *
+ * @param i_baseName base name of the output, the window name is appended.
+ * @param i_b bathymetry of the block.
+ * @param i_boundarySize size of the boundaries around the cells of the block.
+ * @param i_nX number of cells of the block in x-direction.
+ * @param i_nY number of cells of the block in y-direction.
+ * @param i_dX cell size in x-direction.
+ * @param i_dY cell size in y-direction.
+ * @param i_originX x-coordinate of the lower left corner of the block.
+ * @param i_originY y-coordinate of the lower left corner of the block.
+ * @param i_startTime start of the simulation.
+ * @param i_endTime end of the simulation.
+ * @param i_windows the output windows.
+ */
+io::RegionOutput::RegionOutput( const std::string &i_baseName,
+		const Float2D &i_b,
+		const BoundarySize &i_boundarySize,
+		int i_nX, int i_nY,
+		float i_dX, float i_dY,
+		float i_originX, float i_originY,
+		float i_startTime, float i_endTime,
+		const std::vector<OutputWindow> &i_windows )
+	: windows(i_windows),
+	  initialStateWritten(false)
+{
+	for (size_t w = 0; w < windows.size(); w++) {
+		const OutputWindow &l_window = windows[w];
+
+		schedulers.push_back(new tools::OutputScheduler(i_startTime, i_endTime, l_window.interval));
+
+		// cells of the block inside the bounding box
+		const int l_startX = std::max(0, (int) std::floor((l_window.xMin - i_originX) / i_dX));
+		const int l_endX = std::min(i_nX, (int) std::ceil((l_window.xMax - i_originX) / i_dX));
+		const int l_startY = std::max(0, (int) std::floor((l_window.yMin - i_originY) / i_dY));
+		const int l_endY = std::min(i_nY, (int) std::ceil((l_window.yMax - i_originY) / i_dY));
+
+		if (l_endX <= l_startX || l_endY <= l_startY) {
+			writers.push_back(0);
+			continue;
+		}
+
+		// cut everything outside the window (incl. the boundary)
+		io::BoundarySize l_boundarySize = {{ i_boundarySize[0] + l_startX, i_boundarySize[1] + i_nX - l_endX,
+				i_boundarySize[2] + l_startY, i_boundarySize[3] + i_nY - l_endY }};
+
+		writers.push_back(new NetCdfWriter( i_baseName + "_" + l_window.name,
+				i_b,
+				l_boundarySize,
+				l_endX - l_startX, l_endY - l_startY,
+				i_dX, i_dY,
+				i_originX + l_startX * i_dX, i_originY + l_startY * i_dY,
+				0, 0,
+				std::max(l_window.decimation, 1u),
+				l_window.variables ));
+	}
+}
+
+io::RegionOutput::~RegionOutput()
+{
+	for (size_t w = 0; w < windows.size(); w++) {
+		delete schedulers[w];
+		delete writers[w];
+	}
+}
+
+/**
+ * Reads the output windows from a text file.
+ *
+ * Each line describes one window:
+ * <pre>
+ *   name xMin xMax yMin yMax decimation interval variables
+ * </pre>
+ * where variables is a comma separated list of h, hu, hv and b.
+ * Empty lines and lines starting with # are ignored.
+ *
+ * @param i_fileName name of the file.
+ * @return the windows.
+ */
+std::vector<io::OutputWindow> io::RegionOutput::readWindows(const std::string &i_fileName)
+{
+	std::vector<OutputWindow> l_windows;
+
+	std::ifstream l_file(i_fileName.c_str());
+	if (!l_file.good()) {
+		tools::Logger::logger.printString("Could not open output window file " + i_fileName);
+		return l_windows;
+	}
+
+	std::string l_line;
+	while (std::getline(l_file, l_line)) {
+		if (l_line.empty() || l_line[0] == '#')
+			continue;
+
+		std::istringstream l_stream(l_line);
+		OutputWindow l_window;
+		std::string l_variables;
+		l_stream >> l_window.name
+			>> l_window.xMin >> l_window.xMax >> l_window.yMin >> l_window.yMax
+			>> l_window.decimation >> l_window.interval >> l_variables;
+		if (l_stream.fail()) {
+			tools::Logger::logger.printString("Ignoring invalid output window: " + l_line);
+			continue;
+		}
+
+		l_window.variables = 0;
+		std::istringstream l_variableStream(l_variables);
+		std::string l_variable;
+		while (std::getline(l_variableStream, l_variable, ',')) {
+			if (l_variable == "h")
+				l_window.variables |= VAR_H;
+			else if (l_variable == "hu")
+				l_window.variables |= VAR_HU;
+			else if (l_variable == "hv")
+				l_window.variables |= VAR_HV;
+			else if (l_variable == "b")
+				l_window.variables |= VAR_B;
+			else
+				tools::Logger::logger.printString("Ignoring unknown variable " + l_variable);
+		}
+
+		l_windows.push_back(l_window);
+	}
+
+	return l_windows;
+}
+
+/**
+ * Clips a time step such that the next output time of each window is hit exactly.
+ *
+ * @param i_time current simulation time.
+ * @param i_dt proposed time step.
+ * @return time step to use.
+ */
+float io::RegionOutput::clipTimestep(float i_time, float i_dt) const
+{
+	for (size_t w = 0; w < windows.size(); w++)
+		i_dt = schedulers[w]->clipTimestep(i_time, i_dt);
+
+	return i_dt;
+}
+
+/**
+ * Writes all windows which are due at this time.
+ * Has to be called once for the initial state and once after every time step.
+ *
+ * @param i_h water heights.
+ * @param i_hu momentums in x-direction.
+ * @param i_hv momentums in y-direction.
+ * @param i_time current simulation time.
+ */
+void io::RegionOutput::writeTimeStep( const Float2D &i_h,
+		const Float2D &i_hu,
+		const Float2D &i_hv,
+		float i_time )
+{
+	for (size_t w = 0; w < windows.size(); w++) {
+		// the initial state is always written
+		const bool l_due = initialStateWritten ? schedulers[w]->isOutputDue(i_time) : true;
+
+		if (l_due && writers[w] != 0)
+			writers[w]->writeTimeStep(i_h, i_hu, i_hv, i_time);
+	}
+
+	initialStateWritten = true;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file
+ * This file is part of SWE.
+ *
+ * @section LICENSE
+ *
+ * SWE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SWE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SWE.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * @section DESCRIPTION
+ *
+ * Output of multiple regions of interest, each with its own resolution,
+ * variables and output interval.
+ */
+
+#ifndef REGIONOUTPUT_HH_
+#define REGIONOUTPUT_HH_
+
+#include <string>
+#include <vector>
+#include "tools/OutputScheduler.hh"
+#include "writer/NetCdfWriter.hh"
+
+namespace io {
+	struct OutputWindow;
+	class RegionOutput;
+}
+
+/**
+ * Description of an output window
+ */
+struct io::OutputWindow
+{
+	//! name of the window, appended to the output file name
+	std::string name;
+
+	//! bounding box of the window
+	float xMin, xMax, yMin, yMax;
+
+	//! number of cells combined in each direction (1: full resolution)
+	unsigned int decimation;
+
+	//! simulated time between two outputs
+	float interval;
+
+	//! variables written (see NetCdfVariables)
+	unsigned int variables;
+};
+
+/**
+ * Writes a separate netCDF file for each output window.
+ *
+ * Each window uses a NetCdfWriter with boundary sizes that cut the block
+ * to the bounding box, and its own tools::OutputScheduler. A window that
+ * does not intersect the block (e.g. on other MPI ranks) is skipped, but
+ * it still takes part in the time step clipping, so all ranks agree on
+ * the time steps.
+ */
+class io::RegionOutput
+{
+private:
+	//! the windows
+	std::vector<OutputWindow> windows;
+
+	//! schedulers, one per window
+	std::vector<tools::OutputScheduler*> schedulers;
+
+	//! writers, one per window, 0 if the window does not intersect the block
+	std::vector<NetCdfWriter*> writers;
+
+	//! false until the first call of writeTimeStep()
+	bool initialStateWritten;
+
+	// no copies, the output owns the schedulers and writers
+	RegionOutput(const RegionOutput&);
+	RegionOutput& operator=(const RegionOutput&);
+
+public:
+	RegionOutput( const std::string &i_baseName,
+			const Float2D &i_b,
+			const BoundarySize &i_boundarySize,
+			int i_nX, int i_nY,
+			float i_dX, float i_dY,
+			float i_originX, float i_originY,
+			float i_startTime, float i_endTime,
+			const std::vector<OutputWindow> &i_windows );
+
+	~RegionOutput();
+
+	// reads the window descriptions from a file
+	static std::vector<OutputWindow> readWindows(const std::string &i_fileName);
+
+	// clips a time step to the next output time of all windows
+	float clipTimestep(float i_time, float i_dt) const;
+
+	// writes all windows which are due
+	void writeTimeStep( const Float2D &i_h,
+			const Float2D &i_hu,
+			const Float2D &i_hv,
+			float i_time );
+};
+
+#endif // REGIONOUTPUT_HH_
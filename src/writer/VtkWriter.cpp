@@ -23,9 +23,32 @@
  * @section DESCRIPTION
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <fstream>
+#include <sstream>
 #include "VtkWriter.hh"
+#include "tools/Logger.hh"
+
+#ifdef USEZLIB
+#include <zlib.h>
+#endif
+
+/** Type of the size headers in the appended section */
+typedef unsigned long long VtkHeaderType;
+
+/** Uncompressed size of one compressed block (same as the VTK default) */
+static const size_t VTK_COMPRESSION_BLOCK_SIZE = 32768;
+
+/**
+ * @return byte order of this machine as required by the VTK header
+ */
+static const char* vtkByteOrder()
+{
+	const unsigned int one = 1;
+	return (*reinterpret_cast<const char*>(&one) == 1) ? "LittleEndian" : "BigEndian";
+}
 
 /**
  * Creates a vtk file for each time step.
@@ -38,7 +61,8 @@
  * @param i_dY cell size in y-direction.
  * @param i_offsetX x-offset of the block
  * @param i_offsetY y-offset of the block
- * @param i_dynamicBathymetry
+ * @param i_compress compress the data with zlib (ignored if compiled without zlib)
+ * @param i_timeStep index of the first time step (used in the file names)
  *
  * @todo This version can only handle a boundary layer of size 1
  */
@@ -47,11 +71,128 @@ io::VtkWriter::VtkWriter( const std::string &i_baseName,
 		const BoundarySize &i_boundarySize,
 		int i_nX, int i_nY,
 		float i_dX, float i_dY,
-		int i_offsetX, int i_offsetY) :
-  io::Writer(i_baseName, i_b, i_boundarySize, i_nX, i_nY),
+		int i_offsetX, int i_offsetY,
+		bool i_compress,
+		size_t i_timeStep) :
+  io::Writer(i_baseName, i_b, i_boundarySize, i_nX, i_nY, i_timeStep),
   dX(i_dX), dY(i_dY),
-  offsetX(i_offsetX), offsetY(i_offsetY)
+  offsetX(i_offsetX), offsetY(i_offsetY),
+#ifdef USEZLIB
+  compress(i_compress),
+#else
+  compress(false),
+#endif
+  cutsX(2, 0), cutsY(2, 0)
+{
+	cutsX[1] = i_nX;
+	cutsY[1] = i_nY;
+}
+
+/**
+ * Writes a ParaView container file (.pvtr) for all blocks in every time step.
+ * Should be called by a single process only.
+ *
+ * The blocks must be named by generateBaseFileName() and form a rectilinear
+ * grid like in the MPI version (see tools::Decomposition): block (i,j) covers
+ * the cells [cutsX[i], cutsX[i+1]) x [cutsY[j], cutsY[j+1]). Blocks which
+ * are not written at all (e.g. land tiles of a sparse grid) can be excluded.
+ *
+ * @param i_baseName base name of the output (without block position).
+ * @param i_cutsX first cell of each block column, followed by the number of cells in x-direction.
+ * @param i_cutsY first cell of each block row, followed by the number of cells in y-direction.
+ * @param i_blocks block (i,j) is included if i_blocks[i*blocksY + j] is set (empty: all blocks).
+ */
+void io::VtkWriter::setContainer( const std::string &i_baseName,
+		const std::vector<int> &i_cutsX,
+		const std::vector<int> &i_cutsY,
+		const std::vector<bool> &i_blocks )
+{
+	containerBaseName = i_baseName;
+	cutsX = i_cutsX;
+	cutsY = i_cutsY;
+	containerBlocks = i_blocks;
+}
+
+/**
+ * Encodes a data array and appends it to the appended data section.
+ *
+ * Uncompressed arrays are stored as [#bytes][data],
+ * compressed arrays as [#blocks][block size][last block size][#compressed bytes]*[compressed blocks].
+ *
+ * @return offset of the array in the appended data section.
+ */
+size_t io::VtkWriter::appendArray(const float* i_data, size_t i_size)
+{
+	const size_t l_offset = appendedData.size();
+	const size_t l_bytes = i_size * sizeof(float);
+	const char* l_data = reinterpret_cast<const char*>(i_data);
+
+	if (!compress) {
+		const VtkHeaderType l_header = l_bytes;
+		appendedData.insert(appendedData.end(),
+				reinterpret_cast<const char*>(&l_header),
+				reinterpret_cast<const char*>(&l_header) + sizeof(l_header));
+		appendedData.insert(appendedData.end(), l_data, l_data + l_bytes);
+		return l_offset;
+	}
+
+#ifdef USEZLIB
+	const size_t l_numBlocks = (l_bytes + VTK_COMPRESSION_BLOCK_SIZE - 1) / VTK_COMPRESSION_BLOCK_SIZE;
+
+	std::vector<VtkHeaderType> l_header(3 + l_numBlocks);
+	l_header[0] = l_numBlocks;
+	l_header[1] = VTK_COMPRESSION_BLOCK_SIZE;
+	l_header[2] = l_bytes % VTK_COMPRESSION_BLOCK_SIZE;
+
+	// reserve space for the header, the block sizes are filled in later
+	const size_t l_headerBytes = l_header.size() * sizeof(VtkHeaderType);
+	appendedData.resize(l_offset + l_headerBytes);
+
+	compressBuffer.resize(compressBound(VTK_COMPRESSION_BLOCK_SIZE));
+	for (size_t i = 0; i < l_numBlocks; i++) {
+		const size_t l_blockBytes = std::min(VTK_COMPRESSION_BLOCK_SIZE, l_bytes - i*VTK_COMPRESSION_BLOCK_SIZE);
+
+		uLongf l_compressedBytes = compressBuffer.size();
+		int l_status = compress2(reinterpret_cast<Bytef*>(&compressBuffer[0]), &l_compressedBytes,
+				reinterpret_cast<const Bytef*>(l_data + i*VTK_COMPRESSION_BLOCK_SIZE), l_blockBytes,
+				Z_BEST_SPEED);
+		if (l_status != Z_OK) {
+			std::ostringstream l_message;
+			l_message << "Could not compress VTK output of " << fileName << " (zlib error " << l_status << ")! Exit..";
+			tools::Logger::logger.printString(l_message.str());
+			exit(1);
+		}
+
+		l_header[3+i] = l_compressedBytes;
+		appendedData.insert(appendedData.end(), compressBuffer.begin(), compressBuffer.begin() + l_compressedBytes);
+	}
+
+	std::copy(reinterpret_cast<const char*>(&l_header[0]),
+			reinterpret_cast<const char*>(&l_header[0]) + l_headerBytes,
+			appendedData.begin() + l_offset);
+#endif
+
+	return l_offset;
+}
+
+/**
+ * Appends the values of all inner cells (row by row, as required by VTK),
+ * i.e. without the boundary.
+ *
+ * @return offset of the array in the appended data section.
+ */
+size_t io::VtkWriter::appendCellArray(const Float2D &i_data)
 {
+	arrayBuffer.resize(nX*nY);
+
+	// Float2D is stored column by column
+	for (unsigned int i=0; i < nX; i++) {
+		const float* l_column = i_data[boundarySize[0] + i] + boundarySize[2];
+		for (unsigned int j=0; j < nY; j++)
+			arrayBuffer[j*nX + i] = l_column[j];
+	}
+
+	return appendArray(&arrayBuffer[0], arrayBuffer.size());
 }
 
 void io::VtkWriter::writeTimeStep(
@@ -60,63 +201,137 @@ void io::VtkWriter::writeTimeStep(
         const Float2D &i_hv,
         float i_time, bool i_writeBathymetry)
 {
-	std::ofstream vtkFile(generateFileName().c_str());
+	appendedData.clear();
+
+	// Grid coordinates
+	arrayBuffer.resize(nX+1);
+	for (unsigned int i=0; i < nX+1; i++)
+		arrayBuffer[i] = (offsetX+i)*dX;
+	const size_t l_offsetCoordX = appendArray(&arrayBuffer[0], nX+1);
+
+	arrayBuffer.resize(nY+1);
+	for (unsigned int j=0; j < nY+1; j++)
+		arrayBuffer[j] = (offsetY+j)*dY;
+	const size_t l_offsetCoordY = appendArray(&arrayBuffer[0], nY+1);
+
+	const float l_coordZ = 0;
+	const size_t l_offsetCoordZ = appendArray(&l_coordZ, 1);
+
+	// Cell data
+	const size_t l_offsetH = appendCellArray(i_h);
+	const size_t l_offsetHu = appendCellArray(i_hu);
+	const size_t l_offsetHv = appendCellArray(i_hv);
+	const size_t l_offsetB = appendCellArray(b);
+
+	std::ofstream vtkFile(generateFileName().c_str(), std::ios::binary);
 	assert(vtkFile.good());
 
 	// VTK header
-	vtkFile << "<?xml version=\"1.0\"?>" << std::endl
-			<< "<VTKFile type=\"StructuredGrid\">" << std::endl
-			<< "<StructuredGrid WholeExtent=\"" << offsetX << " " << offsetX+nX
-				<< " " << offsetY << " " << offsetY+nY << " 0 0\">" << std::endl
+	vtkFile << "<?xml version=\"1.0\"?>\n"
+			<< "<VTKFile type=\"RectilinearGrid\" version=\"1.0\" byte_order=\"" << vtkByteOrder()
+				<< "\" header_type=\"UInt64\"";
+	if (compress)
+		vtkFile << " compressor=\"vtkZLibDataCompressor\"";
+	vtkFile << ">\n"
+			<< "<RectilinearGrid WholeExtent=\"" << offsetX << " " << offsetX+nX
+				<< " " << offsetY << " " << offsetY+nY << " 0 0\">\n"
 	        << "<Piece Extent=\"" << offsetX << " " << offsetX+nX
-	        	<< " " << offsetY << " " << offsetY+nY << " 0 0\">" << std::endl;
-
-	vtkFile << "<Points>" << std::endl
-			<< "<DataArray NumberOfComponents=\"3\" type=\"Float32\" format=\"ascii\">" << std::endl;
-
-	//Grid points
-	for (int j=0; j < nY+1; j++)
-	      for (int i=0; i < nX+1; i++)
-	    	  vtkFile << (offsetX+i)*dX << " " << (offsetY+j)*dY <<" 0" << std::endl;
-
-	vtkFile << "</DataArray>" << std::endl
-			<< "</Points>" << std::endl;
-
-	vtkFile << "<CellData>" << std::endl;
-
-	// Water surface height h
-	vtkFile << "<DataArray Name=\"h\" type=\"Float32\" format=\"ascii\">" << std::endl;
-	for (int j=1; j < nY+1; j++)
-		for (int i=1; i < nX+1; i++)
-			vtkFile << i_h[i][j] << std::endl;
-	vtkFile << "</DataArray>" << std::endl;
-
-	// Momentums
-	vtkFile << "<DataArray Name=\"hu\" type=\"Float32\" format=\"ascii\">" << std::endl;
-	for (int j=1; j < nY+1; j++)
-		for (int i=1; i < nX+1; i++)
-			vtkFile << i_hu[i][j] << std::endl;
-	vtkFile << "</DataArray>" << std::endl;
-
-	vtkFile << "<DataArray Name=\"hv\" type=\"Float32\" format=\"ascii\">" << std::endl;
-	for (int j=1; j < nY+1; j++)
-		for (int i=1; i<nX+1; i++)
-			vtkFile << i_hv[i][j] << std::endl;
-	vtkFile << "</DataArray>" << std::endl;
-
-	// Bathymetry
-	vtkFile << "<DataArray Name=\"b\" type=\"Float32\" format=\"ascii\">" << std::endl;
-	for (int j=1; j<nY+1; j++)
-		for (int i=1; i<nX+1; i++)
-			vtkFile << b[i][j] << std::endl;
-	vtkFile << "</DataArray>" << std::endl;
-
-	vtkFile << "</CellData>" << std::endl
-			<< "</Piece>" << std::endl;
-
-	vtkFile << "</StructuredGrid>" << std::endl
-			<< "</VTKFile>" << std::endl;
+	        	<< " " << offsetY << " " << offsetY+nY << " 0 0\">\n";
+
+	vtkFile << "<Coordinates>\n"
+			<< "<DataArray Name=\"x\" type=\"Float32\" format=\"appended\" offset=\"" << l_offsetCoordX << "\"/>\n"
+			<< "<DataArray Name=\"y\" type=\"Float32\" format=\"appended\" offset=\"" << l_offsetCoordY << "\"/>\n"
+			<< "<DataArray Name=\"z\" type=\"Float32\" format=\"appended\" offset=\"" << l_offsetCoordZ << "\"/>\n"
+			<< "</Coordinates>\n";
+
+	vtkFile << "<CellData>\n"
+			<< "<DataArray Name=\"h\" type=\"Float32\" format=\"appended\" offset=\"" << l_offsetH << "\"/>\n"
+			<< "<DataArray Name=\"hu\" type=\"Float32\" format=\"appended\" offset=\"" << l_offsetHu << "\"/>\n"
+			<< "<DataArray Name=\"hv\" type=\"Float32\" format=\"appended\" offset=\"" << l_offsetHv << "\"/>\n"
+			<< "<DataArray Name=\"b\" type=\"Float32\" format=\"appended\" offset=\"" << l_offsetB << "\"/>\n"
+			<< "</CellData>\n"
+			<< "</Piece>\n"
+			<< "</RectilinearGrid>\n";
+
+	// Binary data
+	vtkFile << "<AppendedData encoding=\"raw\">\n_";
+	vtkFile.write(&appendedData[0], appendedData.size());
+	vtkFile << "\n</AppendedData>\n"
+			<< "</VTKFile>\n";
+
+	if (!containerBaseName.empty())
+		writeContainer();
 
 	// Increament time step
 	timeStep++;
 }
+
+/**
+ * Writes the container file for the current time step.
+ */
+void io::VtkWriter::writeContainer()
+{
+	std::ofstream vtkFile(("results/" + generateContainerFileName(containerBaseName, timeStep, ".pvtr")).c_str());
+	assert(vtkFile.good());
+
+	vtkFile << "<?xml version=\"1.0\"?>\n"
+			<< "<VTKFile type=\"PRectilinearGrid\" version=\"1.0\" byte_order=\"" << vtkByteOrder()
+				<< "\" header_type=\"UInt64\">\n"
+			<< "<PRectilinearGrid WholeExtent=\"0 " << cutsX.back() << " 0 " << cutsY.back() << " 0 0\" GhostLevel=\"0\">\n";
+
+	vtkFile << "<PCoordinates>\n"
+			<< "<PDataArray Name=\"x\" type=\"Float32\"/>\n"
+			<< "<PDataArray Name=\"y\" type=\"Float32\"/>\n"
+			<< "<PDataArray Name=\"z\" type=\"Float32\"/>\n"
+			<< "</PCoordinates>\n";
+
+	vtkFile << "<PCellData>\n"
+			<< "<PDataArray Name=\"h\" type=\"Float32\"/>\n"
+			<< "<PDataArray Name=\"hu\" type=\"Float32\"/>\n"
+			<< "<PDataArray Name=\"hv\" type=\"Float32\"/>\n"
+			<< "<PDataArray Name=\"b\" type=\"Float32\"/>\n"
+			<< "</PCellData>\n";
+
+	// Pieces, the piece files are in the same directory
+	for (size_t j = 0; j+1 < cutsY.size(); j++) {
+		for (size_t i = 0; i+1 < cutsX.size(); i++) {
+			if (!containerBlocks.empty() && !containerBlocks[i*(cutsY.size()-1) + j])
+				continue;
+
+			vtkFile << "<Piece Extent=\"" << cutsX[i] << " " << cutsX[i+1]
+					<< " " << cutsY[j] << " " << cutsY[j+1] << " 0 0\" Source=\""
+					<< generateBaseFileName(containerBaseName, i, j) << '.' << timeStep << ".vtr\"/>\n";
+		}
+	}
+
+	vtkFile << "</PRectilinearGrid>\n"
+			<< "</VTKFile>\n";
+}
+
+/**
+ * Writes a ParaView multi-block container file (.vtm) for one time step.
+ * In contrast to setContainer(), the blocks do not have to form a
+ * rectilinear grid, e.g. blocks of different refinement levels.
+ *
+ * @param i_baseName base name of the output.
+ * @param i_timeStep time step of the container.
+ * @param i_blockNames file names of the blocks (.vtr, in the same directory).
+ */
+void io::VtkWriter::writeMultiBlockContainer( const std::string &i_baseName,
+		size_t i_timeStep,
+		const std::vector<std::string> &i_blockNames )
+{
+	std::ofstream vtkFile(("results/" + generateContainerFileName(i_baseName, i_timeStep, ".vtm")).c_str());
+	assert(vtkFile.good());
+
+	vtkFile << "<?xml version=\"1.0\"?>\n"
+			<< "<VTKFile type=\"vtkMultiBlockDataSet\" version=\"1.0\" byte_order=\"" << vtkByteOrder()
+				<< "\" header_type=\"UInt64\">\n"
+			<< "<vtkMultiBlockDataSet>\n";
+
+	for (size_t i = 0; i < i_blockNames.size(); i++)
+		vtkFile << "<DataSet index=\"" << i << "\" file=\"" << i_blockNames[i] << "\"/>\n";
+
+	vtkFile << "</vtkMultiBlockDataSet>\n"
+			<< "</VTKFile>\n";
+}
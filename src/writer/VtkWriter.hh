@@ -27,12 +27,23 @@
 #define VTKWRITER_HH_
 
 #include <sstream>
+#include <vector>
 #include "writer/Writer.hh"
 
 namespace io {
 	class VtkWriter;
 }
 
+/**
+ * Writes VTK XML rectilinear grids (.vtr) with all data arrays in an
+ * appended raw-binary section, optionally compressed with zlib
+ * (requires USEZLIB).
+ *
+ * For parallel runs, one process can additionally write a ParaView
+ * container file (.pvtr) for all blocks, see setContainer(). Blocks of different
+ * cell sizes (adaptive refinement) are collected in a multi-block container
+ * (.vtm), see writeMultiBlockContainer().
+ */
 class io::VtkWriter : public io::Writer
 {
 private:
@@ -41,13 +52,49 @@ private:
 
 	float offsetX, offsetY;
 
+	//! compress the data arrays with zlib
+	bool compress;
+
+	//! base name of the container file, empty if no container is written
+	std::string containerBaseName;
+
+	//! first cell of each block column (row) in the container, followed by the number of cells of the domain
+	std::vector<int> cutsX, cutsY;
+
+	//! blocks in the container (column-major), empty if all blocks exist
+	std::vector<bool> containerBlocks;
+
+	//! buffer for the encoded data arrays of the appended section
+	std::vector<char> appendedData;
+
+	//! buffer for transposing a data array
+	std::vector<float> arrayBuffer;
+
+	//! buffer for compressing one block of a data array
+	std::vector<char> compressBuffer;
+
 public:
 	VtkWriter( const std::string &i_fileName,
 			   const Float2D &i_b,
 			   const BoundarySize &i_boundarySize,
 			   int i_nX, int i_nY,
 			   float i_dX, float i_dY,
-			   int i_offsetX = 0, int i_offsetY = 0);
+			   int i_offsetX = 0, int i_offsetY = 0,
+			   bool i_compress = true,
+			   size_t i_timeStep = 0);
+
+	// write the container file for all blocks in each time step
+	void setContainer( const std::string &i_baseName,
+			const std::vector<int> &i_cutsX,
+			const std::vector<int> &i_cutsY,
+			const std::vector<bool> &i_blocks = std::vector<bool>() );
+
+	// write a multi-block container for blocks of different cell sizes
+	static void writeMultiBlockContainer( const std::string &i_baseName,
+			size_t i_timeStep,
+			const std::vector<std::string> &i_blockNames );
+
+	using io::Writer::writeTimeStep;
 
     // writes the unknowns at a given time step to a vtk file
     void writeTimeStep( const Float2D &i_h,
@@ -56,11 +103,19 @@ public:
                         float i_time, bool i_writeBathymetry = true);
 
 private:
+    // appends a data array to the appended section and returns its offset
+    size_t appendArray(const float* i_data, size_t i_size);
+
+    // appends the cell values of a Float2D (without ghost cells) to the appended section
+    size_t appendCellArray(const Float2D &i_data);
+
+    void writeContainer();
+
     std::string generateFileName()
     {
     	std::ostringstream name;
 
-    	name << "results/" << fileName << '.' << timeStep << ".vts";
+    	name << "results/" << fileName << '.' << timeStep << ".vtr";
     	return name.str();
     }
 };
@@ -0,0 +1,197 @@
+#include <math.h>
+#include <iostream>
+#include <assert.h>
+#include <cstdlib>
+#include <cmath>
+
+#ifndef SOLVER_FWAVECACHED_H_
+#define SOLVER_FWAVECACHED_H_
+
+using namespace std;
+
+namespace solver { 
+/**
+*	F-wave solver (same as FWave) for callers which cache the invariants of the cells and edges,
+*	i.e. the bathymetry differences, the square roots and the inverses of the heights
+*/
+template <typename T> class FWaveCached
+{
+private:
+	T eigen_coeff1, eigen_coeff2,
+	update_r, update_l,
+	lambda_roe1, lambda_roe2, 
+	delta_f1, delta_f2,
+	h_l, hu_l, h_r, hu_r, gravity, lambda_inv,
+	delta_b, sqrt_h_l, sqrt_h_r, inv_h_l, inv_h_r;
+
+	// computes the flux-function --> results in delta_f(1/2)
+	void _delta_flux()
+	{
+	delta_f1 = hu_r - hu_l;
+	delta_f2 = (hu_r * hu_r * inv_h_r + h_r * h_r * gravity * 0.5) - (hu_l * hu_l * inv_h_r + h_l * h_l * gravity * 0.5);
+	}
+
+	// 
+	void _bathymetry()
+	{
+	delta_f2 += gravity * delta_b * (h_l + h_r) * 0.5; 
+	}
+
+	// computes the roe eigenvalues --> results in lamda_roe(1/2)
+	void _eigenval()
+	{
+	T u_roe, u_l, u_r, sqrt_hg;
+	u_l = hu_l * inv_h_l;
+	u_r = hu_r * inv_h_r;
+	sqrt_hg = sqrt(gravity * (h_l + h_r) * 0.5 );
+	u_roe = (u_l * sqrt_h_l + u_r * sqrt_h_r ) / (sqrt_h_l + sqrt_h_r);
+	lambda_roe1 = u_roe - sqrt_hg;
+	lambda_roe2 = u_roe + sqrt_hg;
+	}
+
+	// computes the roe eigencoeffizients --> results in eigen_coeff(1/2)
+	void _eigencoeff()
+	{
+	lambda_inv = 1.0 / (lambda_roe2 - lambda_roe1);
+	eigen_coeff1 = lambda_inv * (lambda_roe2 * delta_f1 - delta_f2);
+	eigen_coeff2 = lambda_inv * (delta_f2 - lambda_roe1 * delta_f1);
+	}
+
+public:
+	/**
+	*	The default constructor just setting gravity
+	*/
+	FWaveCached()
+	{
+	    gravity = 9.81f;
+	}
+
+
+	/**
+	*	Computes the next timesteps net updates with precomputed invariants of the cells and the edge,
+	*	e.g. cached by the caller for a whole grid
+	*
+	*	@param i_h_l the height on the left cell of the edge
+	*	@param i_h_r the height on the right cell of the edge
+	*	@param i_hu_l the momentum on the left cell of the edge
+	*	@param i_hu_r the momentum on the right cell of the edge
+	*	@param i_delta_b the bathymetry difference across the edge (right minus left)
+	*	@param i_sqrt_h_l the square root of the height on the left cell
+	*	@param i_sqrt_h_r the square root of the height on the right cell
+	*	@param i_inv_h_l the inverse height on the left cell (0 for a dry cell)
+	*	@param i_inv_h_r the inverse height on the right cell (0 for a dry cell)
+	*
+	*	@param o_h_l output: the height update for the left cell
+	*	@param o_h_r output: the height update for the right cell
+	*	@param o_hu_l output: the momentum update for the left cell
+	*	@param o_hu_r output: the momentum update for the right cell
+	*	@param o_max_wd output: the maximum wavespeed (which is the maximum of the left and right wave speed)
+	*/
+	void computeNetUpdates(T i_h_l, T i_h_r, T i_hu_l, T i_hu_r, T i_delta_b,
+			T i_sqrt_h_l, T i_sqrt_h_r, T i_inv_h_l, T i_inv_h_r,
+			T& o_h_l, T& o_h_r, T& o_hu_l, T& o_hu_r, T& o_max_ws)
+	{
+	if(i_h_l == 0 && i_h_r == 0){
+	    o_h_l = i_h_l;
+	    o_h_r = i_h_r;
+	    o_hu_l = i_hu_l;
+	    o_hu_r = i_hu_r;
+	    o_max_ws = 0;
+	    return;
+	}
+	assert(i_h_l > 0 || i_h_r > 0);
+
+	h_l = i_h_l;
+	h_r = i_h_r;
+	hu_l = i_hu_l;
+	hu_r = i_hu_r;
+	delta_b = i_delta_b;
+	sqrt_h_l = i_sqrt_h_l;
+	sqrt_h_r = i_sqrt_h_r;
+	inv_h_l = i_inv_h_l;
+	inv_h_r = i_inv_h_r;
+
+//	cout << "computeNetUpdates call with i_h_l: " << h_l << ", i_h_r: " << h_r << ", i_hu_l: " << hu_l << ", i_hu_r: " << hu_r << ", i_delta_b: " << delta_b << std::endl;
+	
+	// Boundary condidtions: if the left cell is the left boundary cell, give it negative momentum of the right one and the same bathymetry and height	
+	if(h_l == 0) 
+	{   
+			h_l = h_r;
+			hu_l = -hu_r;
+			delta_b = 0;
+			sqrt_h_l = sqrt_h_r;
+			inv_h_l = inv_h_r;
+	}else if(h_r == 0) 
+		// Else if the right cell is the right boundary cell, do the same the other way around
+	{
+			h_r = h_l;
+			hu_r = -hu_l;
+			delta_b = 0;
+			sqrt_h_r = sqrt_h_l;
+			inv_h_r = inv_h_l;
+	}
+	
+	// compute the FWave-solution 
+	_delta_flux();
+	_bathymetry();
+	_eigenval();
+	_eigencoeff();
+	
+	// set the output for both waves
+	if(lambda_roe1 <= 0 && lambda_roe2 >= 0)
+		{
+		o_hu_l = (lambda_roe1 * eigen_coeff1);
+		o_hu_r = (lambda_roe2 * eigen_coeff2);
+		o_h_l = (eigen_coeff1);
+		o_h_r = (eigen_coeff2);
+		}
+	else if(lambda_roe1 >= 0 && lambda_roe2 <= 0)
+		{
+		o_hu_r = lambda_roe1 * eigen_coeff1;
+		o_hu_l = lambda_roe2 * eigen_coeff2;
+		o_h_r = eigen_coeff1;
+		o_h_l = eigen_coeff2;
+		}
+	else if(lambda_roe1 >= 0 && lambda_roe2 >= 0)
+		{
+		o_hu_l = 0.0f;
+		o_hu_r = lambda_roe1 * eigen_coeff1 + lambda_roe2 * eigen_coeff2;
+		o_h_r = eigen_coeff1 + eigen_coeff2;
+		o_h_l = 0.0f;
+		}
+	else if(lambda_roe1 <= 0 && lambda_roe2 <= 0)
+		{
+		o_hu_r = 0.0f;
+		o_hu_l = lambda_roe1 * eigen_coeff1 + lambda_roe2 * eigen_coeff2;	
+		o_h_l = eigen_coeff1 + eigen_coeff2;
+		o_h_r = 0.0f;
+		}
+	else
+	{
+		assert(0);
+	}
+	
+	//dry states should stay dry
+	if(i_h_l == 0){
+	    o_hu_l = 0;
+	    o_h_l = 0;
+	}if(i_h_r == 0){
+	    o_hu_r = 0;
+	    o_h_r = 0;
+	}    
+    
+	// set the maximum wavespeed
+    if(lambda_roe1 < 0 && lambda_roe2 < 0)
+        o_max_ws = -lambda_roe1;
+    else if(lambda_roe1 > 0 && lambda_roe2 > 0)
+        o_max_ws = lambda_roe2;
+    else
+	    o_max_ws = max(abs(lambda_roe1), abs(lambda_roe2));
+	
+	assert(o_max_ws == o_max_ws);
+	
+	}
+};
+}
+
+#endif